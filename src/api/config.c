@@ -23,6 +23,7 @@
  * outside of the core library.
  */
 
+#include <ctype.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,6 +43,10 @@
 #define MUPEN64PLUS_CFG_NAME "mupen64plus.cfg"
 
 #define SECTION_MAGIC 0xDBDC0580
+#define VAR_MAGIC     0xDBDC0581
+
+/* initial size of the parameter hash table of a section */
+#define VAR_TABLE_MIN_SIZE 16
 
 struct external_config {
   char *file;
@@ -49,7 +54,9 @@ struct external_config {
 };
 
 typedef struct _config_var {
+  unsigned int          magic;
   char                 *name;
+  unsigned int          hash;
   m64p_type             type;
   union {
     int integer;
@@ -57,13 +64,20 @@ typedef struct _config_var {
     char *string;
   } val;
   char                 *comment;
-  struct _config_var   *next;
+  struct _config_var   *next;       /* in insertion order, for the config file */
+  struct _config_var   *hash_next;  /* in the same hash table bucket */
   } config_var;
 
 typedef struct _config_section {
   unsigned int            magic;
   char                   *name;
+  unsigned int            name_hash;
   struct _config_var     *first_var;
+  struct _config_var     *last_var;
+  /* parameters by name hash, NULL if it couldn't be allocated */
+  struct _config_var    **var_table;
+  unsigned int            var_table_size;
+  unsigned int            var_count;
   struct _config_section *next;
   } config_section;
 
@@ -91,6 +105,21 @@ static int is_numeric(const char *string)
     return (rval == 1);
 }
 
+/* Case-insensitive FNV-1a hash, consistent with osal_insensitive_strcmp() for
+ * the ASCII names allowed in the config file */
+static unsigned int config_name_hash(const char *name)
+{
+    unsigned int hash = 2166136261u;
+
+    while (*name != '\0')
+    {
+        hash ^= (unsigned char) tolower((unsigned char) *name++);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
 /* This function returns a pointer to the pointer of the requested section
  * (i.e. a pointer the next field of the previous element, or to the first node).
  *
@@ -102,9 +131,10 @@ static int is_numeric(const char *string)
 static config_section **find_section_link(config_list *list, const char *ParamName)
 {
     config_section **curr_sec_link;
+    unsigned int hash = config_name_hash(ParamName);
     for (curr_sec_link = list; *curr_sec_link != NULL; curr_sec_link = &(*curr_sec_link)->next)
     {
-        if (osal_insensitive_strcmp(ParamName, (*curr_sec_link)->name) == 0)
+        if ((*curr_sec_link)->name_hash == hash && osal_insensitive_strcmp(ParamName, (*curr_sec_link)->name) == 0)
             break;
     }
 
@@ -147,6 +177,8 @@ static config_var *config_var_create(const char *ParamName, const char *ParamHel
 
     memset(var, 0, sizeof(config_var));
 
+    var->magic = VAR_MAGIC;
+    var->hash = config_name_hash(ParamName);
     var->name = strdup(ParamName);
     if (var->name == NULL)
     {
@@ -171,16 +203,32 @@ static config_var *config_var_create(const char *ParamName, const char *ParamHel
         var->comment = NULL;
 
     var->next = NULL;
+    var->hash_next = NULL;
     return var;
 }
 
 static config_var *find_section_var(config_section *section, const char *ParamName)
 {
-    /* walk through the linked list of variables in the section */
+    unsigned int hash = config_name_hash(ParamName);
     config_var *curr_var;
+
+    if (section->var_table != NULL)
+    {
+        curr_var = section->var_table[hash & (section->var_table_size - 1)];
+        for (; curr_var != NULL; curr_var = curr_var->hash_next)
+        {
+            if (curr_var->hash == hash && osal_insensitive_strcmp(ParamName, curr_var->name) == 0)
+                return curr_var;
+        }
+
+        /* couldn't find this configuration parameter */
+        return NULL;
+    }
+
+    /* no hash table, walk through the linked list of variables in the section */
     for (curr_var = section->first_var; curr_var != NULL; curr_var = curr_var->next)
     {
-        if (osal_insensitive_strcmp(ParamName, curr_var->name) == 0)
+        if (curr_var->hash == hash && osal_insensitive_strcmp(ParamName, curr_var->name) == 0)
             return curr_var;
     }
 
@@ -188,24 +236,56 @@ static config_var *find_section_var(config_section *section, const char *ParamNa
     return NULL;
 }
 
-static void append_var_to_section(config_section *section, config_var *var)
+/* Rebuild the hash table of a section with twice as many buckets */
+static void rehash_section_vars(config_section *section)
 {
-    config_var *last_var;
+    unsigned int size = (section->var_table_size == 0) ? VAR_TABLE_MIN_SIZE : section->var_table_size * 2;
+    config_var **table;
+    config_var *curr_var;
 
-    if (section == NULL || var == NULL || section->magic != SECTION_MAGIC)
+    free(section->var_table);
+    section->var_table = NULL;
+    section->var_table_size = 0;
+
+    /* on failure, lookups fall back to the linked list */
+    table = (config_var **) calloc(size, sizeof(config_var *));
+    if (table == NULL)
         return;
 
-    if (section->first_var == NULL)
+    for (curr_var = section->first_var; curr_var != NULL; curr_var = curr_var->next)
     {
-        section->first_var = var;
-        return;
+        config_var **bucket = &table[curr_var->hash & (size - 1)];
+        curr_var->hash_next = *bucket;
+        *bucket = curr_var;
     }
 
-    last_var = section->first_var;
-    while (last_var->next != NULL)
-        last_var = last_var->next;
+    section->var_table = table;
+    section->var_table_size = size;
+}
 
-    last_var->next = var;
+static void append_var_to_section(config_section *section, config_var *var)
+{
+    if (section == NULL || var == NULL || section->magic != SECTION_MAGIC)
+        return;
+
+    if (section->last_var == NULL)
+        section->first_var = var;
+    else
+        section->last_var->next = var;
+    section->last_var = var;
+    section->var_count++;
+
+    /* keep at most one parameter per bucket on average */
+    if (section->var_count > section->var_table_size)
+    {
+        rehash_section_vars(section);
+    }
+    else
+    {
+        config_var **bucket = &section->var_table[var->hash & (section->var_table_size - 1)];
+        var->hash_next = *bucket;
+        *bucket = var;
+    }
 }
 
 static void delete_var(config_var *var)
@@ -214,6 +294,7 @@ static void delete_var(config_var *var)
         free(var->val.string);
     free(var->name);
     free(var->comment);
+    var->magic = 0;
     free(var);
 }
 
@@ -232,7 +313,9 @@ static void delete_section(config_section *pSection)
         curr_var = next_var;
     }
 
+    free(pSection->var_table);
     free(pSection->name);
+    pSection->magic = 0;
     free(pSection);
 }
 
@@ -269,7 +352,12 @@ static config_section *config_section_create(const char *ParamName)
         free(sec);
         return NULL;
     }
+    sec->name_hash = config_name_hash(ParamName);
     sec->first_var = NULL;
+    sec->last_var = NULL;
+    sec->var_table = NULL;
+    sec->var_table_size = 0;
+    sec->var_count = 0;
     sec->next = NULL;
     return sec;
 }
@@ -277,7 +365,7 @@ static config_section *config_section_create(const char *ParamName)
 static config_section * section_deepcopy(config_section *orig_section)
 {
     config_section *new_section;
-    config_var *orig_var, *last_new_var;
+    config_var *orig_var;
 
     /* Input validation */
     if (orig_section == NULL)
@@ -290,7 +378,6 @@ static config_section * section_deepcopy(config_section *orig_section)
 
     /* create and copy all section variables */
     orig_var = orig_section->first_var;
-    last_new_var = NULL;
     while (orig_var != NULL)
     {
         config_var *new_var = config_var_create(orig_var->name, orig_var->comment);
@@ -330,11 +417,7 @@ static config_section * section_deepcopy(config_section *orig_section)
         }
 
         /* add the new variable to the new section */
-        if (last_new_var == NULL)
-            new_section->first_var = new_var;
-        else
-            last_new_var->next = new_var;
-        last_new_var = new_var;
+        append_var_to_section(new_section, new_var);
         /* advance variable pointer in original section variable list */
         orig_var = orig_var->next;
     }
@@ -423,6 +506,108 @@ static m64p_error write_configlist_file(void)
     return M64ERR_SUCCESS;
 }
 
+static int get_var_int(const config_var *var)
+{
+    /* translate the actual variable type to an int */
+    switch(var->type)
+    {
+        case M64TYPE_INT:
+            return var->val.integer;
+        case M64TYPE_FLOAT:
+            return (int) var->val.number;
+        case M64TYPE_BOOL:
+            return (var->val.integer != 0);
+        case M64TYPE_STRING:
+            return atoi(var->val.string);
+        default:
+            DebugMessage(M64MSG_ERROR, "ConfigGetParamInt(): invalid internal parameter type for '%s'", var->name);
+            return 0;
+    }
+}
+
+static float get_var_float(const config_var *var)
+{
+    /* translate the actual variable type to a float */
+    switch(var->type)
+    {
+        case M64TYPE_INT:
+            return (float) var->val.integer;
+        case M64TYPE_FLOAT:
+            return var->val.number;
+        case M64TYPE_BOOL:
+            return (var->val.integer != 0) ? 1.0f : 0.0f;
+        case M64TYPE_STRING:
+            return (float) atof(var->val.string);
+        default:
+            DebugMessage(M64MSG_ERROR, "ConfigGetParamFloat(): invalid internal parameter type for '%s'", var->name);
+            return 0.0;
+    }
+}
+
+static int get_var_bool(const config_var *var)
+{
+    /* translate the actual variable type to an int (0 or 1) */
+    switch(var->type)
+    {
+        case M64TYPE_INT:
+            return (var->val.integer != 0);
+        case M64TYPE_FLOAT:
+            return (var->val.number != 0.0);
+        case M64TYPE_BOOL:
+            return var->val.integer;
+        case M64TYPE_STRING:
+            return (osal_insensitive_strcmp(var->val.string, "true") == 0);
+        default:
+            DebugMessage(M64MSG_ERROR, "ConfigGetParamBool(): invalid internal parameter type for '%s'", var->name);
+            return 0;
+    }
+}
+
+static const char *get_var_string(const config_var *var)
+{
+    static char outstr[64];  /* warning: not thread safe */
+
+    /* translate the actual variable type to a string */
+    switch(var->type)
+    {
+        case M64TYPE_INT:
+            snprintf(outstr, 63, "%i", var->val.integer);
+            outstr[63] = 0;
+            return outstr;
+        case M64TYPE_FLOAT:
+            snprintf(outstr, 63, "%f", var->val.number);
+            outstr[63] = 0;
+            return outstr;
+        case M64TYPE_BOOL:
+            return (var->val.integer ? "True" : "False");
+        case M64TYPE_STRING:
+            return var->val.string;
+        default:
+            DebugMessage(M64MSG_ERROR, "ConfigGetParamString(): invalid internal parameter type for '%s'", var->name);
+            return "";
+    }
+}
+
+/* returns NULL (after reporting the error) if the parameter handle is invalid */
+static const config_var *get_param_handle_var(m64p_handle ParamHandle, const char *caller)
+{
+    const config_var *var = (const config_var *) ParamHandle;
+
+    if (!l_ConfigInit || var == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "%s(): Input assertion!", caller);
+        return NULL;
+    }
+
+    if (var->magic != VAR_MAGIC)
+    {
+        DebugMessage(M64MSG_ERROR, "%s(): ParamHandle invalid!", caller);
+        return NULL;
+    }
+
+    return var;
+}
+
 /* ----------------------------------------------------------- */
 /* these functions are only to be used within the Core library */
 /* ----------------------------------------------------------- */
@@ -756,10 +941,10 @@ EXPORT m64p_error CALL ConfigOpenSection(const char *SectionName, m64p_handle *C
         return M64ERR_INPUT_ASSERT;
 
     /* walk through the section list, looking for a case-insensitive name match */
-    curr_section = find_alpha_section_link(&l_ConfigListActive, SectionName);
-    if (*curr_section != NULL && osal_insensitive_strcmp(SectionName, (*curr_section)->name) == 0)
+    new_section = find_section(l_ConfigListActive, SectionName);
+    if (new_section != NULL)
     {
-        *ConfigSectionHandle = *curr_section;
+        *ConfigSectionHandle = new_section;
         return M64ERR_SUCCESS;
     }
 
@@ -769,6 +954,7 @@ EXPORT m64p_error CALL ConfigOpenSection(const char *SectionName, m64p_handle *C
         return M64ERR_NO_MEMORY;
 
     /* add section to list in alphabetical order */
+    curr_section = find_alpha_section_link(&l_ConfigListActive, SectionName);
     new_section->next = *curr_section;
     *curr_section = new_section;
 
@@ -1400,21 +1586,7 @@ EXPORT int CALL ConfigGetParamInt(m64p_handle ConfigSectionHandle, const char *P
         return 0;
     }
 
-    /* translate the actual variable type to an int */
-    switch(var->type)
-    {
-        case M64TYPE_INT:
-            return var->val.integer;
-        case M64TYPE_FLOAT:
-            return (int) var->val.number;
-        case M64TYPE_BOOL:
-            return (var->val.integer != 0);
-        case M64TYPE_STRING:
-            return atoi(var->val.string);
-        default:
-            DebugMessage(M64MSG_ERROR, "ConfigGetParamInt(): invalid internal parameter type for '%s'", ParamName);
-            return 0;
-    }
+    return get_var_int(var);
 }
 
 EXPORT float CALL ConfigGetParamFloat(m64p_handle ConfigSectionHandle, const char *ParamName)
@@ -1444,21 +1616,7 @@ EXPORT float CALL ConfigGetParamFloat(m64p_handle ConfigSectionHandle, const cha
         return 0.0;
     }
 
-    /* translate the actual variable type to a float */
-    switch(var->type)
-    {
-        case M64TYPE_INT:
-            return (float) var->val.integer;
-        case M64TYPE_FLOAT:
-            return var->val.number;
-        case M64TYPE_BOOL:
-            return (var->val.integer != 0) ? 1.0f : 0.0f;
-        case M64TYPE_STRING:
-            return (float) atof(var->val.string);
-        default:
-            DebugMessage(M64MSG_ERROR, "ConfigGetParamFloat(): invalid internal parameter type for '%s'", ParamName);
-            return 0.0;
-    }
+    return get_var_float(var);
 }
 
 EXPORT int CALL ConfigGetParamBool(m64p_handle ConfigSectionHandle, const char *ParamName)
@@ -1488,26 +1646,11 @@ EXPORT int CALL ConfigGetParamBool(m64p_handle ConfigSectionHandle, const char *
         return 0;
     }
 
-    /* translate the actual variable type to an int (0 or 1) */
-    switch(var->type)
-    {
-        case M64TYPE_INT:
-            return (var->val.integer != 0);
-        case M64TYPE_FLOAT:
-            return (var->val.number != 0.0);
-        case M64TYPE_BOOL:
-            return var->val.integer;
-        case M64TYPE_STRING:
-            return (osal_insensitive_strcmp(var->val.string, "true") == 0);
-        default:
-            DebugMessage(M64MSG_ERROR, "ConfigGetParamBool(): invalid internal parameter type for '%s'", ParamName);
-            return 0;
-    }
+    return get_var_bool(var);
 }
 
 EXPORT const char * CALL ConfigGetParamString(m64p_handle ConfigSectionHandle, const char *ParamName)
 {
-    static char outstr[64];  /* warning: not thread safe */
     config_section *section;
     config_var *var;
 
@@ -1533,25 +1676,54 @@ EXPORT const char * CALL ConfigGetParamString(m64p_handle ConfigSectionHandle, c
         return "";
     }
 
-    /* translate the actual variable type to a string */
-    switch(var->type)
-    {
-        case M64TYPE_INT:
-            snprintf(outstr, 63, "%i", var->val.integer);
-            outstr[63] = 0;
-            return outstr;
-        case M64TYPE_FLOAT:
-            snprintf(outstr, 63, "%f", var->val.number);
-            outstr[63] = 0;
-            return outstr;
-        case M64TYPE_BOOL:
-            return (var->val.integer ? "True" : "False");
-        case M64TYPE_STRING:
-            return var->val.string;
-        default:
-            DebugMessage(M64MSG_ERROR, "ConfigGetParamString(): invalid internal parameter type for '%s'", ParamName);
-            return "";
-    }
+    return get_var_string(var);
+}
+
+EXPORT m64p_error CALL ConfigGetParamHandle(m64p_handle ConfigSectionHandle, const char *ParamName, m64p_handle *ParamHandle)
+{
+    config_section *section;
+    config_var *var;
+
+    /* check input conditions */
+    if (!l_ConfigInit)
+        return M64ERR_NOT_INIT;
+    if (ConfigSectionHandle == NULL || ParamName == NULL || ParamHandle == NULL)
+        return M64ERR_INPUT_ASSERT;
+
+    section = (config_section *) ConfigSectionHandle;
+    if (section->magic != SECTION_MAGIC)
+        return M64ERR_INPUT_INVALID;
+
+    var = find_section_var(section, ParamName);
+    if (var == NULL)
+        return M64ERR_INPUT_NOT_FOUND;
+
+    *ParamHandle = var;
+    return M64ERR_SUCCESS;
+}
+
+EXPORT int CALL ConfigGetParamIntByHandle(m64p_handle ParamHandle)
+{
+    const config_var *var = get_param_handle_var(ParamHandle, "ConfigGetParamIntByHandle");
+    return (var != NULL) ? get_var_int(var) : 0;
+}
+
+EXPORT float CALL ConfigGetParamFloatByHandle(m64p_handle ParamHandle)
+{
+    const config_var *var = get_param_handle_var(ParamHandle, "ConfigGetParamFloatByHandle");
+    return (var != NULL) ? get_var_float(var) : 0.0f;
+}
+
+EXPORT int CALL ConfigGetParamBoolByHandle(m64p_handle ParamHandle)
+{
+    const config_var *var = get_param_handle_var(ParamHandle, "ConfigGetParamBoolByHandle");
+    return (var != NULL) ? get_var_bool(var) : 0;
+}
+
+EXPORT const char * CALL ConfigGetParamStringByHandle(m64p_handle ParamHandle)
+{
+    const config_var *var = get_param_handle_var(ParamHandle, "ConfigGetParamStringByHandle");
+    return (var != NULL) ? get_var_string(var) : "";
 }
 
 /* ------------------------------------------------------ */
@@ -36,9 +36,15 @@
 #include "m64p_config.h"
 #include "m64p_frontend.h"
 #include "m64p_types.h"
+#include "main/batch.h"
 #include "main/cheat.h"
 #include "main/eventloop.h"
+#include "main/fork_server.h"
+#include "main/frame_dump.h"
+#include "main/frame_export.h"
+#include "main/frame_hash.h"
 #include "main/main.h"
+#include "main/movie.h"
 #include "main/rom.h"
 #include "main/savestates.h"
 #include "main/util.h"
@@ -77,6 +83,9 @@ EXPORT m64p_error CALL CoreStartup(int APIVersion, const char *ConfigPath, const
         return M64ERR_INCOMPATIBLE;
     }
 
+    /* pick the byte swap kernels for this CPU */
+    swap_init();
+
     /* set up the default (dummy) plugins */
     plugin_connect(M64PLUGIN_GFX, NULL);
     plugin_connect(M64PLUGIN_AUDIO, NULL);
@@ -121,6 +130,9 @@ EXPORT m64p_error CALL CoreShutdown(void)
     ConfigShutdown();
     workqueue_shutdown();
     savestates_deinit();
+    frame_export_release();
+    frame_hash_setup(NULL);
+    frame_dump_setup(NULL);
 
     /* if the calling code is using SDL, don't shut it down */
     if (!l_CallerUsingSDL)
@@ -189,6 +201,19 @@ EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void *P
                 cheat_init(&g_cheat_ctx);
             }
             return rval;
+        case M64CMD_ROM_OPEN_FILE:
+            if (g_EmulatorRunning || l_ROMOpen)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            rval = open_rom_file((const char *) ParamPtr);
+            if (rval == M64ERR_SUCCESS)
+            {
+                l_ROMOpen = 1;
+                ScreenshotRomOpen();
+                cheat_init(&g_cheat_ctx);
+            }
+            return rval;
         case M64CMD_ROM_CLOSE:
             if (g_EmulatorRunning || !l_ROMOpen)
                 return M64ERR_INVALID_STATE;
@@ -266,6 +291,98 @@ EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void *P
                 return M64ERR_INPUT_INVALID;
             main_state_save(ParamInt, (char *) ParamPtr);
             return M64ERR_SUCCESS;
+        case M64CMD_STATE_REWIND:
+            if (!g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            return main_state_rewind(ParamInt);
+        case M64CMD_PACING_GET_STATS:
+            if (!g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            {
+                m64p_pacing_stats stats;
+                main_get_pacing_stats(&stats);
+                if ((int)sizeof(m64p_pacing_stats) < ParamInt)
+                    ParamInt = sizeof(m64p_pacing_stats);
+                if (ParamInt < 0)
+                    return M64ERR_INPUT_INVALID;
+                memcpy(ParamPtr, &stats, ParamInt);
+            }
+            return M64ERR_SUCCESS;
+        case M64CMD_BATCH_SET:
+            /* ParamPtr is a m64p_batch_params, or NULL to leave batch mode */
+            if (g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            batch_set_params((const m64p_batch_params*)ParamPtr);
+            return M64ERR_SUCCESS;
+        case M64CMD_BATCH_GET_STATS:
+            if (!batch_enabled())
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            {
+                m64p_batch_stats stats;
+                batch_get_stats(&stats);
+                if ((int)sizeof(m64p_batch_stats) < ParamInt)
+                    ParamInt = sizeof(m64p_batch_stats);
+                if (ParamInt < 0)
+                    return M64ERR_INPUT_INVALID;
+                memcpy(ParamPtr, &stats, ParamInt);
+            }
+            return M64ERR_SUCCESS;
+        case M64CMD_MOVIE_RECORD:
+            /* ParamPtr is the movie file path, ParamInt a m64p_movie_anchor */
+            if (!l_ROMOpen)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            return movie_record((const char *) ParamPtr, (m64p_movie_anchor) ParamInt);
+        case M64CMD_MOVIE_PLAY:
+            if (!l_ROMOpen)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            return movie_play((const char *) ParamPtr);
+        case M64CMD_MOVIE_STOP:
+            return movie_stop();
+        case M64CMD_FORK_SERVER:
+            /* ParamPtr is the socket path, ParamInt the number of VIs to run before serving */
+            if (!l_ROMOpen)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            if (ParamInt < 0)
+                return M64ERR_INPUT_INVALID;
+            return fork_server_start((const char *) ParamPtr, (unsigned int) ParamInt);
+        case M64CMD_FRAME_EXPORT:
+            /* ParamPtr is a m64p_frame_export_params, or NULL to stop exporting */
+            if (g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            return frame_export_setup((const m64p_frame_export_params*) ParamPtr);
+        case M64CMD_FRAME_HASH:
+            /* ParamPtr is a m64p_frame_hash_params, or NULL to stop hashing */
+            if (g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            return frame_hash_setup((const m64p_frame_hash_params*) ParamPtr);
+        case M64CMD_FRAME_DUMP:
+            /* ParamPtr is a m64p_frame_dump_params, or NULL to stop dumping */
+            if (g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            return frame_dump_setup((const m64p_frame_dump_params*) ParamPtr);
+        case M64CMD_FRAME_HASH_GET_RESULT:
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            {
+                m64p_frame_hash_result result;
+                frame_hash_get_result(&result);
+                if ((int)sizeof(m64p_frame_hash_result) < ParamInt)
+                    ParamInt = sizeof(m64p_frame_hash_result);
+                if (ParamInt < 0)
+                    return M64ERR_INPUT_INVALID;
+                memcpy(ParamPtr, &result, ParamInt);
+            }
+            return M64ERR_SUCCESS;
         case M64CMD_STATE_SET_SLOT:
             if (ParamInt < 0 || ParamInt > 9)
                 return M64ERR_INPUT_INVALID;
@@ -292,6 +409,24 @@ EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void *P
                 return M64ERR_INVALID_STATE;
             main_take_next_screenshot();
             return M64ERR_SUCCESS;
+        case M64CMD_SCREENSHOT_BURST:
+            /* ParamPtr is a m64p_screenshot_burst, or NULL to stop the burst */
+            if (!l_ROMOpen)
+                return M64ERR_INVALID_STATE;
+            return ScreenshotBurst((const m64p_screenshot_burst*) ParamPtr);
+        case M64CMD_SCREENSHOT_GET_STATS:
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            {
+                m64p_screenshot_stats stats;
+                ScreenshotGetStats(&stats);
+                if ((int)sizeof(m64p_screenshot_stats) < ParamInt)
+                    ParamInt = sizeof(m64p_screenshot_stats);
+                if (ParamInt < 0)
+                    return M64ERR_INPUT_INVALID;
+                memcpy(ParamPtr, &stats, ParamInt);
+            }
+            return M64ERR_SUCCESS;
         case M64CMD_READ_SCREEN:
             if (!g_EmulatorRunning)
                 return M64ERR_INVALID_STATE;
@@ -198,6 +198,35 @@ EXPORT int          CALL ConfigGetParamBool(m64p_handle, const char *);
 EXPORT const char * CALL ConfigGetParamString(m64p_handle, const char *);
 #endif
 
+/* ConfigGetParamHandle()
+ *
+ * This function looks up a parameter in the given section once, and returns
+ * a handle to it. The value of the parameter can then be read with the
+ * ConfigGetParam***ByHandle() functions without searching the parameter by
+ * name, which is useful for parameters which are read often. The handle stays
+ * valid until the section is deleted or reverted, or the core is shut down.
+ */
+typedef m64p_error (*ptr_ConfigGetParamHandle)(m64p_handle, const char *, m64p_handle *);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL ConfigGetParamHandle(m64p_handle, const char *, m64p_handle *);
+#endif
+
+/* ConfigGetParam***ByHandle()
+ *
+ * These functions behave like the ConfigGetParam***() functions, for a
+ * parameter handle given by ConfigGetParamHandle().
+ */
+typedef int          (*ptr_ConfigGetParamIntByHandle)(m64p_handle);
+typedef float        (*ptr_ConfigGetParamFloatByHandle)(m64p_handle);
+typedef int          (*ptr_ConfigGetParamBoolByHandle)(m64p_handle);
+typedef const char * (*ptr_ConfigGetParamStringByHandle)(m64p_handle);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT int          CALL ConfigGetParamIntByHandle(m64p_handle);
+EXPORT float        CALL ConfigGetParamFloatByHandle(m64p_handle);
+EXPORT int          CALL ConfigGetParamBoolByHandle(m64p_handle);
+EXPORT const char * CALL ConfigGetParamStringByHandle(m64p_handle);
+#endif
+
 /* ConfigGetSharedDataFilepath()
  *
  * This function is provided to allow a plugin to retrieve a full pathname to a
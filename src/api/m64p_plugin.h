@@ -238,6 +238,7 @@ typedef int  (*ptr_VolumeGetLevel)(void);
 typedef void (*ptr_VolumeSetLevel)(int level);
 typedef void (*ptr_VolumeMute)(void);
 typedef const char * (*ptr_VolumeGetString)(void);
+typedef unsigned int (*ptr_AiGetQueuedBytes)(void);
 #if defined(M64P_PLUGIN_PROTOTYPES)
 EXPORT void CALL AiDacrateChanged(int SystemType);
 EXPORT void CALL AiLenChanged(void);
@@ -250,6 +251,8 @@ EXPORT int  CALL VolumeGetLevel(void);
 EXPORT void CALL VolumeSetLevel(int level);
 EXPORT void CALL VolumeMute(void);
 EXPORT const char * CALL VolumeGetString(void);
+/* optional since audio API 2.1.0: number of bytes queued for playback */
+EXPORT unsigned int CALL AiGetQueuedBytes(void);
 #endif
 
 /* input plugin function pointers */
@@ -167,7 +167,22 @@ typedef enum {
   M64CMD_NETPLAY_CONTROL_PLAYER,
   M64CMD_NETPLAY_GET_VERSION,
   M64CMD_NETPLAY_CLOSE,
-  M64CMD_PIF_OPEN
+  M64CMD_PIF_OPEN,
+  M64CMD_STATE_REWIND,
+  M64CMD_PACING_GET_STATS,
+  M64CMD_BATCH_SET,
+  M64CMD_BATCH_GET_STATS,
+  M64CMD_MOVIE_RECORD,
+  M64CMD_MOVIE_PLAY,
+  M64CMD_MOVIE_STOP,
+  M64CMD_FORK_SERVER,
+  M64CMD_FRAME_EXPORT,
+  M64CMD_FRAME_HASH,
+  M64CMD_FRAME_HASH_GET_RESULT,
+  M64CMD_SCREENSHOT_BURST,
+  M64CMD_SCREENSHOT_GET_STATS,
+  M64CMD_FRAME_DUMP,
+  M64CMD_ROM_OPEN_FILE
 } m64p_command;
 
 typedef struct {
@@ -175,6 +190,133 @@ typedef struct {
   int      value;
 } m64p_cheat_code;
 
+#define M64P_PACING_HISTOGRAM_BINS 12
+
+typedef struct {
+  unsigned int frames;          /* frames paced since the emulation started */
+  unsigned int late_frames;     /* frames which started after their deadline */
+  unsigned int resyncs;         /* schedule resets after a stall, a pause or a speed change */
+  long long    drift_ns;        /* lateness of the last frame relative to its deadline (negative: early) */
+  /* Frame time error |actual - target|.
+   * Bin 0 counts errors below 32us, bin i errors in [32us << (i-1), 32us << i),
+   * and the last bin everything above. */
+  unsigned int jitter_histogram[M64P_PACING_HISTOGRAM_BINS];
+  /* Audio sync (Core AudioSync parameter) */
+  unsigned int audio_underruns;  /* frames started with an empty audio queue */
+  unsigned int audio_overruns;   /* frames started with more than twice the target latency queued */
+  unsigned int audio_latency_us; /* audio queued at the start of the last frame */
+  /* Audio thread ring (Core AudioThread parameter), in bytes, size is 0 if not used */
+  unsigned int audio_ring_size;
+  unsigned int audio_ring_used;
+  unsigned int audio_ring_peak;
+  unsigned int audio_ring_dropped; /* samples dropped because the ring was full */
+} m64p_pacing_stats;
+
+typedef struct {
+  unsigned int max_vis;     /* stop after this many VIs (0: no limit) */
+  unsigned int max_frames;  /* stop after this many rendered frames (0: no limit) */
+} m64p_batch_params;
+
+typedef struct {
+  unsigned int       vis;
+  unsigned int       frames;
+  unsigned long long wall_time_ns;
+  double             vis_per_second;
+  unsigned long long guest_instructions; /* estimated from the CP0 Count register and CountPerOp */
+  unsigned long long compile_time_ns;    /* recompiler */
+  unsigned long long gfx_time_ns;        /* RSP graphics tasks (including the video plugin) */
+  unsigned long long audio_time_ns;      /* RSP audio tasks */
+  unsigned long long rsp_time_ns;        /* other RSP tasks */
+} m64p_batch_stats;
+
+typedef enum {
+  M64MOVIE_POWER_ON = 0,  /* movie starts when the emulation starts */
+  M64MOVIE_SAVESTATE      /* movie starts from a savestate stored in the movie file */
+} m64p_movie_anchor;
+
+/* Shared memory frame export (M64CMD_FRAME_EXPORT).
+ * The shared memory object starts with a m64p_frame_export_header, followed by
+ * slot_count slots of slot_size bytes. Each slot starts with a m64p_frame_slot
+ * followed by RGB pixels (3 bytes per pixel, pitch bytes per row). */
+#define M64P_FRAME_EXPORT_MAGIC   0x4634364D /* "M64F" */
+#define M64P_FRAME_EXPORT_VERSION 1
+
+typedef struct {
+  const char*  name;        /* shared memory object name, such as "/m64p-frames" */
+  unsigned int slot_count;
+  unsigned int max_width;   /* larger frames are not exported */
+  unsigned int max_height;
+} m64p_frame_export_params;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t slot_size;       /* bytes from one slot to the next */
+  uint32_t slots_offset;    /* offset of the first slot */
+  uint32_t max_width;
+  uint32_t max_height;
+  uint32_t latest;          /* number of the latest complete frame (0: none), in slot (latest - 1) % slot_count */
+} m64p_frame_export_header;
+
+typedef enum {
+  M64P_FRAME_BOTTOM_UP = 1  /* first row is the bottom of the picture */
+} m64p_frame_flags;
+
+typedef struct {
+  uint32_t sequence;        /* odd while the slot is written: read it before and after the frame */
+  uint32_t frame;           /* frame number */
+  uint32_t vi;              /* VI count when the frame was exported */
+  uint32_t width;
+  uint32_t height;
+  uint32_t pitch;
+  uint32_t flags;           /* m64p_frame_flags */
+  uint32_t reserved;
+} m64p_frame_slot;
+
+/* Frame hashing (M64CMD_FRAME_HASH) */
+typedef struct {
+  const char* log_path;     /* hash log to write (NULL: none) */
+  const char* golden_path;  /* hash log to compare against (NULL: none) */
+  int stop_on_mismatch;     /* stop the emulation at the first mismatching frame */
+} m64p_frame_hash_params;
+
+typedef struct {
+  unsigned int vis;                 /* hashed VIs */
+  unsigned int compared;            /* VIs compared against the golden log */
+  int first_mismatch;               /* VI of the first mismatch (counted from 0), -1 if none */
+  unsigned long long expected_hash; /* golden and computed hashes of the first mismatching VI */
+  unsigned long long actual_hash;
+  unsigned int golden_vis;          /* VIs recorded in the golden log */
+} m64p_frame_hash_result;
+
+typedef struct {
+  unsigned int interval;    /* VIs between screenshots */
+  unsigned int count;       /* number of screenshots */
+} m64p_screenshot_burst;
+
+typedef struct {
+  unsigned int captured;    /* frames grabbed since the ROM was opened */
+  unsigned int written;     /* PNG files written */
+  unsigned int dropped;     /* captures dropped because too many were waiting to be written */
+  unsigned int failed;      /* captures that could not be written */
+  unsigned int pending;     /* captures waiting to be written */
+  unsigned int skipped;     /* captures skipped because all 1000 file names of the ROM are taken */
+} m64p_screenshot_stats;
+
+/* Frame dump (M64CMD_FRAME_DUMP) */
+typedef enum {
+  M64DUMP_Y4M = 0,          /* YUV4MPEG2, 4:4:4 BT.601 */
+  M64DUMP_RAW               /* top-down RGB24 frames, without header */
+} m64p_frame_dump_format;
+
+typedef struct {
+  const char*  video_path;  /* video stream to write (NULL: none) */
+  const char*  audio_path;  /* WAV file to write (NULL: none) */
+  m64p_frame_dump_format format;
+  unsigned int queue_size;  /* MB queued for the writer before dropping (0: default) */
+} m64p_frame_dump_params;
+
 typedef struct {
   /* Frontend-defined callback data. */
   void* cb_data;
@@ -23,6 +23,7 @@
 #define M64P_BACKENDS_API_AUDIO_OUT_BACKEND_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 struct audio_out_backend_interface
 {
@@ -33,6 +34,11 @@ struct audio_out_backend_interface
     /* Push samples to be played by the backend
      */
     void (*push_samples)(void* aout, const void* samples, size_t size);
+
+    /* Get the duration (in ns) of the audio queued by the backend and not played yet.
+     * Returns 0 if the backend can't tell.
+     */
+    int (*get_queued_duration)(void* aout, uint64_t* duration);
 };
 
 #endif
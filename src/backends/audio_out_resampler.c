@@ -0,0 +1,384 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - audio_out_resampler.c                                    *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "audio_out_resampler.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESAMPLER_NEON
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+enum { RESAMPLER_PHASE_BITS = 8 };
+enum { RESAMPLER_PHASES = 1 << RESAMPLER_PHASE_BITS };
+
+/* keep some headroom below Nyquist for the filter transition band */
+static const double resampler_cutoff = 0.95;
+
+static unsigned int quality_taps(int quality)
+{
+    switch (quality)
+    {
+    case AUDIO_RESAMPLER_LINEAR: return 2;
+    case AUDIO_RESAMPLER_SINC_FAST: return 16;
+    default: return 64;
+    }
+}
+
+static double blackman(double t)
+{
+    return (t <= -1.0 || t >= 1.0)
+        ? 0.0
+        : 0.42 + 0.5 * cos(M_PI * t) + 0.08 * cos(2.0 * M_PI * t);
+}
+
+static void build_coefs(struct audio_out_resampler* resampler)
+{
+    unsigned int taps = resampler->taps;
+    double cutoff = resampler_cutoff;
+    unsigned int p, k;
+
+    /* when downsampling, filter out what the output rate can't represent */
+    if (resampler->out_rate < resampler->in_rate)
+        cutoff *= (double)resampler->out_rate / resampler->in_rate;
+
+    for (p = 0; p < RESAMPLER_PHASES; ++p) {
+        float* coefs = resampler->coefs + (size_t)p * taps * 2;
+        double f = (double)p / RESAMPLER_PHASES;
+        double c[64];
+        double sum = 0.0;
+
+        for (k = 0; k < taps; ++k) {
+            /* output frame lies between taps taps/2-1 and taps/2 */
+            double x = (double)k - (taps / 2 - 1) - f;
+
+            if (taps == 2)
+                c[k] = 1.0 - fabs(x);
+            else
+                c[k] = ((x == 0.0) ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x))
+                     * blackman(x / (taps / 2));
+
+            sum += c[k];
+        }
+
+        for (k = 0; k < taps; ++k) {
+            coefs[2 * k + 0] = (float)(c[k] / sum);
+            coefs[2 * k + 1] = (float)(c[k] / sum);
+        }
+    }
+}
+
+/* Filter one stereo frame: out[c] = sum(history[2k+c] * coefs[2k+c]) */
+static void fir_scalar(const float* history, const float* coefs, unsigned int taps, float* out)
+{
+    float l = 0.0f, r = 0.0f;
+    unsigned int k;
+
+    for (k = 0; k < 2 * taps; k += 2) {
+        l += history[k + 0] * coefs[k + 0];
+        r += history[k + 1] * coefs[k + 1];
+    }
+
+    out[0] = l;
+    out[1] = r;
+}
+
+static int16_t clamp_sample(float v)
+{
+    v += (v >= 0.0f) ? 0.5f : -0.5f;
+
+    if (v >= 32767.0f) return 32767;
+    if (v <= -32768.0f) return -32768;
+    return (int16_t)v;
+}
+
+static void to_samples_scalar(const float* in, int16_t* out, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i)
+        out[i] = clamp_sample(in[i]);
+}
+
+#if defined(RESAMPLER_SSE2)
+
+static void fir_simd(const float* history, const float* coefs, unsigned int taps, float* out)
+{
+    /* two stereo frames per vector, taps is always even */
+    __m128 acc = _mm_setzero_ps();
+    unsigned int k;
+
+    for (k = 0; k < 2 * taps; k += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(history + k), _mm_loadu_ps(coefs + k)));
+
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    _mm_storel_pi((__m64*)out, acc);
+}
+
+/* round half away from zero and clamp like the scalar version
+ * (_mm_cvtps_epi32 would round half to even) */
+static __m128i round_samples_sse2(__m128 v)
+{
+    __m128 positive = _mm_cmpge_ps(v, _mm_setzero_ps());
+    __m128 half = _mm_or_ps(_mm_and_ps(positive, _mm_set1_ps(0.5f)),
+                            _mm_andnot_ps(positive, _mm_set1_ps(-0.5f)));
+
+    v = _mm_add_ps(v, half);
+    v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+    return _mm_cvttps_epi32(v);
+}
+
+static void to_samples_simd(const float* in, int16_t* out, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m128i a = round_samples_sse2(_mm_loadu_ps(in + i));
+        __m128i b = round_samples_sse2(_mm_loadu_ps(in + i + 4));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+    }
+
+    to_samples_scalar(in + i, out + i, count - i);
+}
+
+const char* audio_out_resampler_kernel_name(void) { return "SSE2"; }
+
+#elif defined(RESAMPLER_NEON)
+
+static void fir_simd(const float* history, const float* coefs, unsigned int taps, float* out)
+{
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    unsigned int k;
+
+    for (k = 0; k < 2 * taps; k += 4)
+        acc = vmlaq_f32(acc, vld1q_f32(history + k), vld1q_f32(coefs + k));
+
+    vst1_f32(out, vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+}
+
+static void to_samples_simd(const float* in, int16_t* out, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i + 4 <= count; i += 4) {
+        /* round half away from zero like the scalar version */
+        float32x4_t v = vld1q_f32(in + i);
+        float32x4_t half = vbslq_f32(vcgeq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(0.5f), vdupq_n_f32(-0.5f));
+        vst1_s16(out + i, vqmovn_s32(vcvtq_s32_f32(vaddq_f32(v, half))));
+    }
+
+    to_samples_scalar(in + i, out + i, count - i);
+}
+
+const char* audio_out_resampler_kernel_name(void) { return "NEON"; }
+
+#else
+
+#define fir_simd fir_scalar
+#define to_samples_simd to_samples_scalar
+
+const char* audio_out_resampler_kernel_name(void) { return "scalar"; }
+
+#endif
+
+static int reserve(void** buffer, size_t* capacity, size_t needed, size_t elem_size)
+{
+    void* p;
+    size_t n;
+
+    if (needed <= *capacity)
+        return 1;
+
+    n = (*capacity == 0) ? 4096 : *capacity;
+    while (n < needed)
+        n *= 2;
+
+    p = realloc(*buffer, n * elem_size);
+    if (p == NULL)
+        return 0;
+
+    *buffer = p;
+    *capacity = n;
+    return 1;
+}
+
+int audio_out_resampler_init(struct audio_out_resampler* resampler, unsigned int out_rate, int quality,
+                             void* aout, const struct audio_out_backend_interface* iaout)
+{
+    memset(resampler, 0, sizeof(*resampler));
+
+    if (out_rate == 0)
+        return -1;
+
+    resampler->aout = aout;
+    resampler->iaout = iaout;
+    resampler->out_rate = out_rate;
+    resampler->quality = quality;
+    resampler->bypass = 1;
+    resampler->taps = quality_taps(quality);
+
+    resampler->coefs = malloc((size_t)RESAMPLER_PHASES * resampler->taps * 2 * sizeof(float));
+    if (resampler->coefs == NULL) {
+        audio_out_resampler_release(resampler);
+        return -1;
+    }
+
+    return 0;
+}
+
+void audio_out_resampler_release(struct audio_out_resampler* resampler)
+{
+    free(resampler->coefs);
+    free(resampler->history);
+    free(resampler->out);
+    free(resampler->out_samples);
+    memset(resampler, 0, sizeof(*resampler));
+}
+
+size_t audio_out_resampler_process(struct audio_out_resampler* resampler, const int16_t* frames, size_t count)
+{
+    size_t i, n, avail, consumed, capacity;
+    float* history;
+
+    if (!reserve((void**)&resampler->history, &resampler->history_capacity,
+                 2 * (resampler->history_frames + count), sizeof(float)))
+        return 0;
+
+    history = resampler->history + 2 * resampler->history_frames;
+    for (i = 0; i < 2 * count; ++i)
+        history[i] = (float)frames[i];
+
+    resampler->history_frames += count;
+
+    if (resampler->history_frames < resampler->taps)
+        return 0;
+
+    /* number of frames which can start a full filter window */
+    avail = resampler->history_frames - resampler->taps + 1;
+    if ((resampler->pos >> 32) >= avail)
+        return 0;
+
+    /* both output buffers hold the same number of samples */
+    capacity = resampler->out_capacity;
+    n = (size_t)((((uint64_t)avail << 32) - resampler->pos) / resampler->step) + 2;
+    if (!reserve((void**)&resampler->out, &capacity, 2 * n, sizeof(float))
+     || !reserve((void**)&resampler->out_samples, &resampler->out_capacity, 2 * n, sizeof(int16_t)))
+        return 0;
+
+    for (n = 0; (resampler->pos >> 32) < avail; ++n) {
+        const float* window = resampler->history + 2 * (size_t)(resampler->pos >> 32);
+        const float* coefs = resampler->coefs
+            + (size_t)(((uint32_t)resampler->pos) >> (32 - RESAMPLER_PHASE_BITS)) * resampler->taps * 2;
+
+        if (resampler->scalar)
+            fir_scalar(window, coefs, resampler->taps, resampler->out + 2 * n);
+        else
+            fir_simd(window, coefs, resampler->taps, resampler->out + 2 * n);
+
+        resampler->pos += resampler->step;
+    }
+
+    /* drop frames which won't be used anymore
+     * (when downsampling, the next window may start past the available frames) */
+    consumed = (size_t)(resampler->pos >> 32);
+    if (consumed > resampler->history_frames)
+        consumed = resampler->history_frames;
+    memmove(resampler->history, resampler->history + 2 * consumed,
+            2 * (resampler->history_frames - consumed) * sizeof(float));
+    resampler->history_frames -= consumed;
+    resampler->pos -= (uint64_t)consumed << 32;
+
+    if (resampler->scalar)
+        to_samples_scalar(resampler->out, resampler->out_samples, 2 * n);
+    else
+        to_samples_simd(resampler->out, resampler->out_samples, 2 * n);
+
+    return n;
+}
+
+static void audio_resampler_set_format(void* aout, unsigned int frequency, unsigned int bits)
+{
+    struct audio_out_resampler* resampler = (struct audio_out_resampler*)aout;
+
+    /* only 16 bit stereo is converted */
+    resampler->bypass = (bits != 16 || frequency == resampler->out_rate || frequency == 0);
+
+    if (resampler->bypass) {
+        resampler->iaout->set_format(resampler->aout, frequency, bits);
+        return;
+    }
+
+    if (frequency != resampler->in_rate) {
+        resampler->in_rate = frequency;
+        resampler->step = ((uint64_t)frequency << 32) / resampler->out_rate;
+        build_coefs(resampler);
+    }
+
+    resampler->iaout->set_format(resampler->aout, resampler->out_rate, 16);
+}
+
+static void audio_resampler_push_samples(void* aout, const void* samples, size_t size)
+{
+    struct audio_out_resampler* resampler = (struct audio_out_resampler*)aout;
+    size_t n;
+
+    if (resampler->bypass) {
+        resampler->iaout->push_samples(resampler->aout, samples, size);
+        return;
+    }
+
+    n = audio_out_resampler_process(resampler, (const int16_t*)samples, size / 4);
+    if (n > 0)
+        resampler->iaout->push_samples(resampler->aout, resampler->out_samples, n * 4);
+}
+
+static int audio_resampler_get_queued_duration(void* aout, uint64_t* duration)
+{
+    struct audio_out_resampler* resampler = (struct audio_out_resampler*)aout;
+
+    if (resampler->iaout->get_queued_duration == NULL
+     || !resampler->iaout->get_queued_duration(resampler->aout, duration))
+        return 0;
+
+    /* plus the input frames held back for the filter */
+    if (!resampler->bypass)
+        *duration += (uint64_t)resampler->history_frames * UINT64_C(1000000000) / resampler->in_rate;
+
+    return 1;
+}
+
+const struct audio_out_backend_interface g_iaudio_out_backend_resampler =
+{
+    audio_resampler_set_format,
+    audio_resampler_push_samples,
+    audio_resampler_get_queued_duration
+};
@@ -0,0 +1,84 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - audio_out_resampler.h                                    *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_BACKENDS_AUDIO_OUT_RESAMPLER_H
+#define M64P_BACKENDS_AUDIO_OUT_RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "backends/api/audio_out_backend.h"
+
+/* Audio out backend which converts 16 bit stereo samples from the AI rate
+ * to a fixed output rate before forwarding them to another backend.
+ *
+ * Every quality level is a polyphase FIR filter (linear interpolation being
+ * the 2 taps case), evaluated with SSE2 or NEON when available.
+ */
+enum audio_resampler_quality
+{
+    AUDIO_RESAMPLER_LINEAR = 0,     /* 2 taps */
+    AUDIO_RESAMPLER_SINC_FAST = 1,  /* 16 taps windowed sinc */
+    AUDIO_RESAMPLER_SINC_BEST = 2   /* 64 taps windowed sinc */
+};
+
+struct audio_out_resampler
+{
+    void* aout;
+    const struct audio_out_backend_interface* iaout;
+
+    unsigned int in_rate;
+    unsigned int out_rate;
+    int quality;
+    int bypass;                 /* formats we can't or don't need to convert */
+    int scalar;                 /* don't use the SIMD filter (for benchmarking) */
+
+    unsigned int taps;
+    float* coefs;               /* per phase, taps coefficients each repeated for both channels */
+
+    uint64_t step;              /* input frames per output frame (32.32 fixed point) */
+    uint64_t pos;               /* first tap of the next output frame in history (32.32 fixed point) */
+
+    /* interleaved stereo input frames not fully consumed yet */
+    float* history;
+    size_t history_frames;
+    size_t history_capacity;
+
+    float* out;
+    int16_t* out_samples;
+    size_t out_capacity;
+};
+
+int audio_out_resampler_init(struct audio_out_resampler* resampler, unsigned int out_rate, int quality,
+                             void* aout, const struct audio_out_backend_interface* iaout);
+void audio_out_resampler_release(struct audio_out_resampler* resampler);
+
+/* Convert frames (interleaved 16 bit stereo) and return the number of output
+ * frames stored in resampler->out_samples. Set the input rate with set_format first. */
+size_t audio_out_resampler_process(struct audio_out_resampler* resampler, const int16_t* frames, size_t count);
+
+/* Name of the filter implementation selected at build time */
+const char* audio_out_resampler_kernel_name(void);
+
+extern const struct audio_out_backend_interface g_iaudio_out_backend_resampler;
+
+#endif
@@ -0,0 +1,307 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - audio_out_ring.c                                        *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "audio_out_ring.h"
+
+#include <SDL_thread.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+
+#if SDL_VERSION_ATLEAST(2,0,2)
+
+/* Ring content is a sequence of records: a header followed by its payload
+ * padded to the header size, so that a header never straddles the end of the buffer.
+ */
+enum audio_ring_record_type
+{
+    AUDIO_RING_SAMPLES,
+    AUDIO_RING_FORMAT,
+    AUDIO_RING_PAD          /* skip to the start of the buffer */
+};
+
+struct audio_ring_record
+{
+    uint32_t type;
+    uint32_t size;
+};
+
+struct audio_ring_format
+{
+    uint32_t frequency;
+    uint32_t bits;
+};
+
+enum { AUDIO_RING_ALIGN = sizeof(struct audio_ring_record) };
+
+/* consumer wake-up period when no samples are pushed */
+enum { AUDIO_RING_IDLE_MS = 100 };
+
+static size_t record_size(size_t payload)
+{
+    return sizeof(struct audio_ring_record) + ((payload + AUDIO_RING_ALIGN - 1) & ~(size_t)(AUDIO_RING_ALIGN - 1));
+}
+
+static uint32_t ring_used(struct audio_out_ring* ring)
+{
+    return (uint32_t)SDL_AtomicGet(&ring->head) - (uint32_t)SDL_AtomicGet(&ring->tail);
+}
+
+/* Producer: append a record, returns 0 if there isn't enough room */
+static int ring_write(struct audio_out_ring* ring, uint32_t type, const void* data, size_t size)
+{
+    uint32_t head = (uint32_t)SDL_AtomicGet(&ring->head);
+    uint32_t tail = (uint32_t)SDL_AtomicGet(&ring->tail);
+    size_t pos = head & (ring->size - 1);
+    size_t needed = record_size(size);
+    size_t pad = (ring->size - pos < needed) ? ring->size - pos : 0;
+    struct audio_ring_record record;
+    uint32_t used;
+
+    if (ring->size - (head - tail) < pad + needed)
+        return 0;
+
+    if (pad != 0) {
+        record.type = AUDIO_RING_PAD;
+        record.size = (uint32_t)(pad - sizeof(record));
+        memcpy(ring->buffer + pos, &record, sizeof(record));
+        pos = 0;
+    }
+
+    record.type = type;
+    record.size = (uint32_t)size;
+    memcpy(ring->buffer + pos, &record, sizeof(record));
+    memcpy(ring->buffer + pos + sizeof(record), data, size);
+
+    /* publish the record (SDL_AtomicSet is a full barrier) */
+    head += (uint32_t)(pad + needed);
+    SDL_AtomicSet(&ring->head, (int)head);
+
+    used = head - tail;
+    if (used > (uint32_t)SDL_AtomicGet(&ring->peak))
+        SDL_AtomicSet(&ring->peak, (int)used);
+
+    SDL_SemPost(ring->sem);
+    return 1;
+}
+
+/* Consumer: forward all published records to the wrapped backend */
+static void ring_drain(struct audio_out_ring* ring)
+{
+    uint32_t tail = (uint32_t)SDL_AtomicGet(&ring->tail);
+    uint32_t head = (uint32_t)SDL_AtomicGet(&ring->head);
+
+    while (tail != head) {
+        const unsigned char* p = ring->buffer + (tail & (ring->size - 1));
+        struct audio_ring_record record;
+
+        memcpy(&record, p, sizeof(record));
+        p += sizeof(record);
+
+        if (record.type == AUDIO_RING_SAMPLES) {
+            ring->iaout->push_samples(ring->aout, p, record.size);
+        }
+        else if (record.type == AUDIO_RING_FORMAT) {
+            struct audio_ring_format format;
+            memcpy(&format, p, sizeof(format));
+            ring->iaout->set_format(ring->aout, format.frequency, format.bits);
+        }
+
+        /* give the space back as soon as possible */
+        tail += (uint32_t)record_size(record.size);
+        SDL_AtomicSet(&ring->tail, (int)tail);
+
+        head = (uint32_t)SDL_AtomicGet(&ring->head);
+    }
+}
+
+/* Consumer: publish how much the wrapped backend has left to play */
+static void ring_sample_queue(struct audio_out_ring* ring)
+{
+    uint64_t duration;
+    int queued_us = -1;
+
+    if (ring->iaout->get_queued_duration != NULL
+     && ring->iaout->get_queued_duration(ring->aout, &duration)) {
+        queued_us = (duration / 1000 < INT_MAX) ? (int)(duration / 1000) : INT_MAX;
+    }
+
+    SDL_AtomicSet(&ring->queued_us, queued_us);
+}
+
+static int audio_ring_thread(void* opaque)
+{
+    struct audio_out_ring* ring = (struct audio_out_ring*)opaque;
+
+    while (!SDL_AtomicGet(&ring->quit)) {
+        SDL_SemWaitTimeout(ring->sem, AUDIO_RING_IDLE_MS);
+        ring_drain(ring);
+        ring_sample_queue(ring);
+    }
+
+    ring_drain(ring);
+    return 0;
+}
+
+int audio_out_ring_init(struct audio_out_ring* ring, size_t size,
+                        void* aout, const struct audio_out_backend_interface* iaout)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    /* counters are 32 bits wide */
+    if (size == 0 || (size & (size - 1)) != 0 || size > 0x40000000) {
+        DebugMessage(M64MSG_ERROR, "Invalid audio ring size %u", (unsigned int)size);
+        return -1;
+    }
+
+    ring->size = size;
+    ring->aout = aout;
+    ring->iaout = iaout;
+    SDL_AtomicSet(&ring->queued_us, -1);
+
+    ring->buffer = malloc(size);
+    ring->sem = SDL_CreateSemaphore(0);
+    if (ring->buffer == NULL || ring->sem == NULL) {
+        DebugMessage(M64MSG_ERROR, "Could not allocate audio ring");
+        audio_out_ring_release(ring);
+        return -1;
+    }
+
+    ring->thread = SDL_CreateThread(audio_ring_thread, "m64pAudio", ring);
+    if (ring->thread == NULL) {
+        DebugMessage(M64MSG_ERROR, "Could not start audio thread: %s", SDL_GetError());
+        audio_out_ring_release(ring);
+        return -1;
+    }
+
+    return 0;
+}
+
+void audio_out_ring_release(struct audio_out_ring* ring)
+{
+    if (ring->thread != NULL) {
+        SDL_AtomicSet(&ring->quit, 1);
+        SDL_SemPost(ring->sem);
+        SDL_WaitThread(ring->thread, NULL);
+    }
+
+    if (ring->sem != NULL)
+        SDL_DestroySemaphore(ring->sem);
+
+    free(ring->buffer);
+    memset(ring, 0, sizeof(*ring));
+}
+
+void audio_out_ring_get_stats(struct audio_out_ring* ring,
+                              size_t* used, size_t* peak, unsigned int* dropped)
+{
+    *used = (ring->buffer == NULL) ? 0 : ring_used(ring);
+    *peak = (uint32_t)SDL_AtomicGet(&ring->peak);
+    *dropped = ring->dropped;
+}
+
+static void audio_ring_set_format(void* aout, unsigned int frequency, unsigned int bits)
+{
+    struct audio_out_ring* ring = (struct audio_out_ring*)aout;
+    struct audio_ring_format format;
+
+    format.frequency = frequency;
+    format.bits = bits;
+
+    /* don't lose a format change, retry before the next samples */
+    ring->format_pending = !ring_write(ring, AUDIO_RING_FORMAT, &format, sizeof(format));
+    ring->frequency = frequency;
+    ring->bits = bits;
+}
+
+static void audio_ring_push_samples(void* aout, const void* samples, size_t size)
+{
+    struct audio_out_ring* ring = (struct audio_out_ring*)aout;
+
+    if (ring->format_pending)
+        audio_ring_set_format(ring, ring->frequency, ring->bits);
+
+    if (ring->format_pending || !ring_write(ring, AUDIO_RING_SAMPLES, samples, size))
+        ring->dropped += (unsigned int)size;
+}
+
+static int audio_ring_get_queued_duration(void* aout, uint64_t* duration)
+{
+    struct audio_out_ring* ring = (struct audio_out_ring*)aout;
+    int queued_us = SDL_AtomicGet(&ring->queued_us);
+
+    if (queued_us < 0 || ring->frequency == 0)
+        return 0;
+
+    /* the ring holds 16 bit stereo samples at the producer rate,
+     * record headers are negligible */
+    *duration = (uint64_t)queued_us * 1000
+              + (uint64_t)ring_used(ring) * UINT64_C(1000000000) / (4 * ring->frequency);
+    return 1;
+}
+
+#else /* SDL < 2.0.2: no atomics */
+
+int audio_out_ring_init(struct audio_out_ring* ring, size_t size,
+                        void* aout, const struct audio_out_backend_interface* iaout)
+{
+    memset(ring, 0, sizeof(*ring));
+    DebugMessage(M64MSG_WARNING, "Audio thread requires SDL 2.0.2 or later");
+    return -1;
+}
+
+void audio_out_ring_release(struct audio_out_ring* ring)
+{
+}
+
+void audio_out_ring_get_stats(struct audio_out_ring* ring,
+                              size_t* used, size_t* peak, unsigned int* dropped)
+{
+    *used = 0;
+    *peak = 0;
+    *dropped = 0;
+}
+
+static void audio_ring_set_format(void* aout, unsigned int frequency, unsigned int bits)
+{
+}
+
+static void audio_ring_push_samples(void* aout, const void* samples, size_t size)
+{
+}
+
+static int audio_ring_get_queued_duration(void* aout, uint64_t* duration)
+{
+    return 0;
+}
+
+#endif
+
+const struct audio_out_backend_interface g_iaudio_out_backend_ring =
+{
+    audio_ring_set_format,
+    audio_ring_push_samples,
+    audio_ring_get_queued_duration
+};
@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - audio_out_ring.h                                        *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_BACKENDS_AUDIO_OUT_RING_H
+#define M64P_BACKENDS_AUDIO_OUT_RING_H
+
+#include <SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "backends/api/audio_out_backend.h"
+
+/* Audio out backend which queues samples in a single-producer/single-consumer
+ * ring and forwards them to another backend from its own thread.
+ *
+ * The emulation thread only copies samples into the ring and never waits:
+ * when the ring is full, samples are dropped and counted.
+ * Requires SDL >= 2.0.2 for atomics, audio_out_ring_init fails otherwise.
+ */
+struct audio_out_ring
+{
+    unsigned char* buffer;
+    size_t size;                /* power of two */
+
+    void* aout;
+    const struct audio_out_backend_interface* iaout;
+
+#if SDL_VERSION_ATLEAST(2,0,2)
+    /* free running byte counters, head is only written by the producer
+     * and tail by the consumer */
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+    SDL_atomic_t peak;
+    SDL_atomic_t quit;
+    /* queue duration (us) of the wrapped backend, sampled by the consumer
+     * so that it is only ever called from one thread, -1 if unknown */
+    SDL_atomic_t queued_us;
+#endif
+    SDL_sem* sem;
+    SDL_Thread* thread;
+
+    /* producer side */
+    int format_pending;
+    unsigned int frequency;
+    unsigned int bits;
+    unsigned int dropped;
+};
+
+int audio_out_ring_init(struct audio_out_ring* ring, size_t size,
+                        void* aout, const struct audio_out_backend_interface* iaout);
+
+/* Wait for the queued samples to be forwarded and stop the consumer thread */
+void audio_out_ring_release(struct audio_out_ring* ring);
+
+/* Occupancy statistics (bytes) */
+void audio_out_ring_get_stats(struct audio_out_ring* ring,
+                              size_t* used, size_t* peak, unsigned int* dropped);
+
+extern const struct audio_out_backend_interface g_iaudio_out_backend_ring;
+
+#endif
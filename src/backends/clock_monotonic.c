@@ -0,0 +1,65 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - clock_monotonic.c                                       *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "clock_monotonic.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(WIN32)
+#include <windows.h>
+
+uint64_t monotonic_get_time_ns(void* clock)
+{
+    static LARGE_INTEGER freq = { 0 };
+    LARGE_INTEGER counter;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+
+    QueryPerformanceCounter(&counter);
+
+    /* split to avoid overflowing the multiplication */
+    return (uint64_t)(counter.QuadPart / freq.QuadPart) * UINT64_C(1000000000)
+         + (uint64_t)(counter.QuadPart % freq.QuadPart) * UINT64_C(1000000000) / (uint64_t)freq.QuadPart;
+}
+
+#else
+
+uint64_t monotonic_get_time_ns(void* clock)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+#endif
+
+time_t monotonic_get_time(void* clock)
+{
+    return time(NULL);
+}
+
+const struct clock_backend_interface g_iclock_monotonic =
+{
+    monotonic_get_time,
+    monotonic_get_time_ns
+};
@@ -0,0 +1,51 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - clock_virtual.c                                         *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "clock_virtual.h"
+
+void clock_virtual_init(struct clock_virtual* clock, time_t base)
+{
+    clock->base = base;
+    clock->elapsed = 0;
+}
+
+void clock_virtual_advance(struct clock_virtual* clock, uint64_t ns)
+{
+    clock->elapsed += ns;
+}
+
+static time_t virtual_get_time(void* clock)
+{
+    const struct clock_virtual* vclock = (const struct clock_virtual*)clock;
+
+    return vclock->base + (time_t)(vclock->elapsed / UINT64_C(1000000000));
+}
+
+static uint64_t virtual_get_time_ns(void* clock)
+{
+    return ((const struct clock_virtual*)clock)->elapsed;
+}
+
+const struct clock_backend_interface g_iclock_virtual =
+{
+    virtual_get_time,
+    virtual_get_time_ns
+};
@@ -0,0 +1,44 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - clock_virtual.h                                         *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_BACKENDS_CLOCK_VIRTUAL_H
+#define M64P_BACKENDS_CLOCK_VIRTUAL_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "backends/api/clock_backend.h"
+
+/* Clock following emulated time instead of host time,
+ * for reproducible runs. It is advanced by the emulation loop.
+ */
+struct clock_virtual
+{
+    time_t base;        /* calendar time at power-on */
+    uint64_t elapsed;   /* emulated time since power-on (ns) */
+};
+
+void clock_virtual_init(struct clock_virtual* clock, time_t base);
+void clock_virtual_advance(struct clock_virtual* clock, uint64_t ns);
+
+extern const struct clock_backend_interface g_iclock_virtual;
+
+#endif
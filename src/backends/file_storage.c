@@ -21,7 +21,9 @@
 
 #include "file_storage.h"
 
+#include <SDL.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
@@ -30,12 +32,34 @@
 #include "main/util.h"
 #include "main/netplay.h"
 
+/* A copy of the saved bytes, so the emulation can keep writing to the
+ * storage while the chunk is on its way to the disk. */
+struct file_storage_chunk
+{
+    struct list_head list;
+    size_t start;
+    size_t size;
+    int whole_file;
+    uint8_t data[];
+};
+
+static void file_storage_flush_work(struct work_struct* work);
+
+static void init_file_storage_flush(struct file_storage* fstorage)
+{
+    fstorage->lock = NULL;
+    INIT_LIST_HEAD(&fstorage->pending);
+    fstorage->flush_queued = 0;
+    init_work(&fstorage->flush_work, file_storage_flush_work);
+}
+
 int open_file_storage(struct file_storage* fstorage, size_t size, const char* filename)
 {
     /* ! Take ownership of filename ! */
     fstorage->filename = filename;
     fstorage->size = size;
     fstorage->first_access = 1;
+    init_file_storage_flush(fstorage);
 
     /* allocate memory for holding data */
     fstorage->data = malloc(fstorage->size);
@@ -60,6 +84,7 @@ int open_rom_file_storage(struct file_storage* fstorage, const char* filename)
     fstorage->size = 0;
     fstorage->filename = NULL;
     fstorage->first_access = 1;
+    init_file_storage_flush(fstorage);
 
     file_status_t err = load_file(filename, (void**)&fstorage->data, &fstorage->size);
 
@@ -73,6 +98,13 @@ int open_rom_file_storage(struct file_storage* fstorage, const char* filename)
 
 void close_file_storage(struct file_storage* fstorage)
 {
+    /* the worker may still be writing the last chunks */
+    if (fstorage->lock != NULL) {
+        flush_work(&fstorage->flush_work);
+        SDL_DestroyMutex(fstorage->lock);
+        fstorage->lock = NULL;
+    }
+
     free((void*)fstorage->data);
     free((void*)fstorage->filename);
 }
@@ -90,23 +122,15 @@ static size_t file_storage_size(const void* storage)
     return fstorage->size;
 }
 
-static void file_storage_save(void* storage, size_t start, size_t size)
+static void file_storage_write_chunk(const struct file_storage* fstorage, const struct file_storage_chunk* chunk)
 {
-    if (netplay_is_init() && netplay_get_controller(0) == -1)
-        return;
-
-    struct file_storage* fstorage = (struct file_storage*)storage;
-
     file_status_t err;
 
-    /* On first save access ignore start/size and write full storage content,
-     * otherwise write only updated chunk */
-    if (fstorage->first_access) {
-        fstorage->first_access = 0;
-        err = write_to_file(fstorage->filename, fstorage->data, fstorage->size);
+    if (chunk->whole_file) {
+        err = write_to_file(fstorage->filename, chunk->data, chunk->size);
     }
     else {
-        err = write_chunk_to_file(fstorage->filename, fstorage->data + start, size, start);
+        err = write_chunk_to_file(fstorage->filename, chunk->data, chunk->size, chunk->start);
     }
 
     switch(err)
@@ -122,6 +146,81 @@ static void file_storage_save(void* storage, size_t start, size_t size)
     }
 }
 
+/* Writes the pending chunks in the order they were saved. The work stays
+ * queued (flush_queued) until the list is drained, so there is never more
+ * than one writer per file. */
+static void file_storage_flush_work(struct work_struct* work)
+{
+    struct file_storage* fstorage = container_of(work, struct file_storage, flush_work);
+    struct file_storage_chunk* chunk;
+
+    for (;;) {
+        SDL_LockMutex(fstorage->lock);
+        if (list_empty(&fstorage->pending)) {
+            fstorage->flush_queued = 0;
+            SDL_UnlockMutex(fstorage->lock);
+            break;
+        }
+        chunk = list_first_entry(&fstorage->pending, struct file_storage_chunk, list);
+        list_del(&chunk->list);
+        SDL_UnlockMutex(fstorage->lock);
+
+        file_storage_write_chunk(fstorage, chunk);
+        free(chunk);
+    }
+}
+
+static void file_storage_save(void* storage, size_t start, size_t size)
+{
+    if (netplay_is_init() && netplay_get_controller(0) == -1)
+        return;
+
+    struct file_storage* fstorage = (struct file_storage*)storage;
+    struct file_storage_chunk* chunk;
+    int whole_file = 0;
+    int queue = 0;
+
+    /* On first save access ignore start/size and write full storage content,
+     * otherwise write only updated chunk */
+    if (fstorage->first_access) {
+        whole_file = 1;
+        start = 0;
+        size = fstorage->size;
+    }
+
+    if (fstorage->lock == NULL) {
+        fstorage->lock = SDL_CreateMutex();
+        if (fstorage->lock == NULL) {
+            DebugMessage(M64MSG_WARNING, "couldn't create storage lock for '%s'", fstorage->filename);
+            return;
+        }
+    }
+
+    chunk = malloc(sizeof(*chunk) + size);
+    if (chunk == NULL) {
+        DebugMessage(M64MSG_WARNING, "failed to write storage file '%s'", fstorage->filename);
+        return;
+    }
+
+    fstorage->first_access = 0;
+    chunk->start = start;
+    chunk->size = size;
+    chunk->whole_file = whole_file;
+    memcpy(chunk->data, fstorage->data + start, size);
+
+    SDL_LockMutex(fstorage->lock);
+    list_add_tail(&chunk->list, &fstorage->pending);
+    if (!fstorage->flush_queued) {
+        fstorage->flush_queued = 1;
+        queue = 1;
+    }
+    SDL_UnlockMutex(fstorage->lock);
+
+    /* storage is written behind the emulation, the same way as savestates */
+    if (queue)
+        queue_work_prio(&fstorage->flush_work, WORK_PRIO_LOW);
+}
+
 static void file_storage_parent_save(void* storage, size_t start, size_t size)
 {
     struct file_storage* fstorage = (struct file_storage*)((struct file_storage*)storage)->filename;
@@ -25,12 +25,23 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "main/list.h"
+#include "main/workqueue.h"
+
+struct SDL_mutex;
+
 struct file_storage
 {
     uint8_t* data;
     size_t size;
     const char* filename;
     int first_access;
+
+    /* saved chunks waiting to be written by the workqueue, oldest first */
+    struct SDL_mutex* lock;
+    struct list_head pending;
+    int flush_queued;
+    struct work_struct flush_work;
 };
 
 
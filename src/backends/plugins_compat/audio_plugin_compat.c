@@ -20,6 +20,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <stdint.h>
+#include <string.h>
 
 #include "backends/api/audio_out_backend.h"
 #include "device/rcp/ai/ai_controller.h"
@@ -28,6 +29,7 @@
 #include "device/rdram/rdram.h"
 #include "main/rom.h"
 #include "plugin/plugin.h"
+#include "plugins_compat.h"
 
 static void audio_plugin_set_format(void* aout, unsigned int frequency, unsigned int bits)
 {
@@ -61,8 +63,91 @@ static void audio_plugin_push_samples(void* aout, const void* buffer, size_t siz
     ai->regs[AI_DRAM_ADDR_REG] = saved_ai_dram;
 }
 
+/* The plugin counts bytes of the 16 bit stereo samples it was given,
+ * at the rate it derives from the DACRATE register it was shown. */
+static int audio_plugin_queued_duration(unsigned int vi_clock, uint32_t dacrate, uint64_t* duration)
+{
+    unsigned int frequency = vi_clock / (dacrate + 1);
+
+    if (audio.aiGetQueuedBytes == NULL || frequency == 0)
+        return 0;
+
+    *duration = (uint64_t)audio.aiGetQueuedBytes() * UINT64_C(1000000000) / (4 * frequency);
+    return 1;
+}
+
+static int audio_plugin_get_queued_duration(void* aout, uint64_t* duration)
+{
+    struct ai_controller* ai = (struct ai_controller*)aout;
+
+    return audio_plugin_queued_duration(ai->vi->clock, ai->regs[AI_DACRATE_REG], duration);
+}
+
 const struct audio_out_backend_interface g_iaudio_out_backend_plugin_compat =
 {
     audio_plugin_set_format,
-    audio_plugin_push_samples
+    audio_plugin_push_samples,
+    audio_plugin_get_queued_duration
+};
+
+
+struct audio_plugin_shadow g_audio_plugin_shadow;
+
+static uint32_t shadow_dacrate(const struct audio_plugin_shadow* shadow, unsigned int frequency)
+{
+    uint32_t divider = (shadow->vi_clock + frequency / 2) / frequency;
+
+    return (divider == 0) ? 0 : divider - 1;
+}
+
+unsigned int audio_plugin_shadow_exact_rate(const struct audio_plugin_shadow* shadow, unsigned int frequency)
+{
+    return shadow->vi_clock / (shadow_dacrate(shadow, frequency) + 1);
+}
+
+static void audio_plugin_shadow_set_format(void* aout, unsigned int frequency, unsigned int bits)
+{
+    struct audio_plugin_shadow* shadow = (struct audio_plugin_shadow*)aout;
+
+    /* rounded to the nearest, so that a rate from audio_plugin_shadow_exact_rate
+     * (or the AI's own rate) is the one the plugin computes back */
+    shadow->regs[AI_DACRATE_REG] = shadow_dacrate(shadow, frequency);
+    shadow->regs[AI_BITRATE_REG] = bits - 1;
+
+    audio.aiDacrateChanged(ROM_PARAMS.systemtype);
+}
+
+static void audio_plugin_shadow_push_samples(void* aout, const void* buffer, size_t size)
+{
+    /* the plugin only sees the shadow registers and memory,
+     * so it can be called without touching the emulated ones */
+    struct audio_plugin_shadow* shadow = (struct audio_plugin_shadow*)aout;
+    const uint8_t* samples = (const uint8_t*)buffer;
+
+    while (size > 0) {
+        size_t chunk = (size > AUDIO_PLUGIN_SHADOW_RAM_SIZE) ? AUDIO_PLUGIN_SHADOW_RAM_SIZE : size;
+
+        memcpy(shadow->ram, samples, chunk);
+        shadow->regs[AI_DRAM_ADDR_REG] = 0;
+        shadow->regs[AI_LEN_REG] = (uint32_t)chunk;
+
+        audio.aiLenChanged();
+
+        samples += chunk;
+        size -= chunk;
+    }
+}
+
+static int audio_plugin_shadow_get_queued_duration(void* aout, uint64_t* duration)
+{
+    struct audio_plugin_shadow* shadow = (struct audio_plugin_shadow*)aout;
+
+    return audio_plugin_queued_duration(shadow->vi_clock, shadow->regs[AI_DACRATE_REG], duration);
+}
+
+const struct audio_out_backend_interface g_iaudio_out_backend_plugin_compat_shadow =
+{
+    audio_plugin_shadow_set_format,
+    audio_plugin_shadow_push_samples,
+    audio_plugin_shadow_get_queued_duration
 };
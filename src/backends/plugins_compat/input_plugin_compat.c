@@ -27,6 +27,7 @@
 #include "plugin/plugin.h"
 
 #include "main/main.h"
+#include "main/movie.h"
 #include "main/netplay.h"
 
 #include <stdint.h>
@@ -61,7 +62,11 @@ static m64p_error input_plugin_get_input(void* opaque, uint32_t* input_)
     int pak_change_requested = 0;
 
     /* first poll controller */
-    if (!netplay_is_init())
+    if (movie_is_playing())
+    {
+        /* input comes from the movie, see movie_input below */
+    }
+    else if (!netplay_is_init())
     {
         if (input.getKeys)
             input.getKeys(cin_compat->control_id, &keys);
@@ -90,6 +95,7 @@ static m64p_error input_plugin_get_input(void* opaque, uint32_t* input_)
         return M64ERR_SYSTEM_FAIL;
     }
 
+    movie_input(cin_compat->control_id, &keys.Value);
 
     /* has Controls[i].Plugin changed since last call */
     if (cin_compat->last_pak_type != Controls[cin_compat->control_id].Plugin) {
@@ -26,6 +26,7 @@
 #include "backends/api/controller_input_backend.h"
 #include "backends/api/rumble_backend.h"
 #include "backends/api/joybus.h"
+#include "device/rcp/ai/ai_controller.h"
 
 #include <stdint.h>
 
@@ -34,6 +35,29 @@
 extern const struct audio_out_backend_interface
     g_iaudio_out_backend_plugin_compat;
 
+/* Audio plugin fed from another thread than the emulation one:
+ * it is given its own copy of the AI registers and samples memory
+ * instead of the emulated ones.
+ */
+enum { AUDIO_PLUGIN_SHADOW_RAM_SIZE = 0x40000 };
+
+struct audio_plugin_shadow
+{
+    int enabled;
+    unsigned int vi_clock;
+    uint32_t regs[AI_REGS_COUNT];
+    uint8_t ram[AUDIO_PLUGIN_SHADOW_RAM_SIZE];
+};
+
+extern struct audio_plugin_shadow g_audio_plugin_shadow;
+
+/* The plugin derives its rate from the DACRATE register, so it can only
+ * play at vi_clock / n. Returns the closest such rate to frequency. */
+unsigned int audio_plugin_shadow_exact_rate(const struct audio_plugin_shadow* shadow, unsigned int frequency);
+
+extern const struct audio_out_backend_interface
+    g_iaudio_out_backend_plugin_compat_shadow;
+
 /* Controller Input backend interface */
 
 struct controller_input_compat
@@ -27,15 +27,17 @@
 
 #include "api/m64p_types.h"
 #include "api/callbacks.h"
-
-#include <SDL_timer.h>
+#include "backends/api/clock_backend.h"
 
 #include <string.h>
 
 void init_biopak(struct biopak* bpk,
-    unsigned int bpm)
+    unsigned int bpm,
+    void* clock, const struct clock_backend_interface* iclock)
 {
     bpk->bpm = bpm;
+    bpk->clock = clock;
+    bpk->iclock = iclock;
 }
 
 static void plug_biopak(void* pak)
@@ -51,7 +53,7 @@ static void read_biopak(void* pak, uint16_t address, uint8_t* data, size_t size)
     struct biopak* bpk = (struct biopak*)pak;
 
     if (address == 0xc000) {
-        uint32_t now = SDL_GetTicks();
+        uint32_t now = (uint32_t)(bpk->iclock->get_time_ns(bpk->clock) / 1000000);
         uint32_t period = UINT32_C(60*1000) / bpk->bpm;
         uint32_t k = now % period;
 
@@ -24,13 +24,19 @@
 
 #include "device/controllers/game_controller.h"
 
+struct clock_backend_interface;
+
 struct biopak
 {
     unsigned int bpm;
+
+    void* clock;
+    const struct clock_backend_interface* iclock;
 };
 
 void init_biopak(struct biopak* bpk,
-    unsigned int bpm);
+    unsigned int bpm,
+    void* clock, const struct clock_backend_interface* iclock);
 
 extern const struct pak_interface g_ibiopak;
 
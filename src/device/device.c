@@ -33,7 +33,7 @@
 #include "rcp/si/si_controller.h"
 #include "rcp/vi/vi_controller.h"
 
-#define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
+#include "main/util.h"
 
 
 static void read_open_bus(void* opaque, uint32_t address, uint32_t* value)
@@ -85,6 +85,7 @@ void init_device(struct device* dev,
     unsigned int count_per_op,
     int no_compiled_jump,
     int randomize_interrupt,
+    uint32_t random_seed,
     uint32_t start_address,
     /* ai */
     void* aout, const struct audio_out_backend_interface* iaout,
@@ -177,7 +178,7 @@ void init_device(struct device* dev,
     init_rdram(&dev->rdram, mem_base_u32(base, MM_RDRAM_DRAM), dram_size, &dev->r4300);
 
     init_r4300(&dev->r4300, &dev->mem, &dev->mi, &dev->rdram, interrupt_handlers,
-            emumode, count_per_op, no_compiled_jump, randomize_interrupt, start_address);
+            emumode, count_per_op, no_compiled_jump, randomize_interrupt, random_seed, start_address);
     init_rdp(&dev->dp, &dev->sp, &dev->mi, &dev->mem, &dev->rdram, &dev->r4300);
     init_rsp(&dev->sp, mem_base_u32(base, MM_RSP_MEM), &dev->mi, &dev->dp, &dev->ri);
     init_ai(&dev->ai, &dev->mi, &dev->ri, &dev->vi, aout, iaout);
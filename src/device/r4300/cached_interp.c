@@ -35,6 +35,7 @@
 #include "device/r4300/r4300_core.h"
 #include "device/r4300/idec.h"
 #include "main/main.h"
+#include "main/profile.h"
 #include "osal/preproc.h"
 
 #ifdef DBG
@@ -237,7 +238,11 @@ void cached_interp_NOTCOMPILED(void)
         DebugMessage(M64MSG_ERROR, "not compiled exception");
     }
     else {
+        if (g_timing_enabled)
+            timed_section_start(TIMED_SECTION_COMPILER);
         r4300->cached_interp.recompile_block(r4300, mem, r4300->cached_interp.blocks[*r4300_pc(r4300) >> 12], *r4300_pc(r4300));
+        if (g_timing_enabled)
+            timed_section_end(TIMED_SECTION_COMPILER);
     }
 
 /*
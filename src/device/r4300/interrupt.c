@@ -23,9 +23,6 @@
 
 #include "interrupt.h"
 
-#ifdef __MINGW32__
-#define _CRT_RAND_S
-#endif
 #include <stdlib.h>
 
 #include <assert.h>
@@ -44,6 +41,8 @@
 #include "device/rcp/ai/ai_controller.h"
 #include "device/rcp/vi/vi_controller.h"
 #include "main/main.h"
+#include "main/movie.h"
+#include "main/rewind.h"
 #include "main/savestates.h"
 
 
@@ -115,13 +114,13 @@ static int before_event(const struct cp0* cp0, unsigned int evt1, unsigned int e
 unsigned int add_random_interrupt_time(struct r4300_core* r4300)
 {
     if (r4300->randomize_interrupt) {
-        unsigned int value;
-#ifdef __MINGW32__
-        rand_s(&value);
-#else
-        value = rand();
-#endif
-        return value % 0x40;
+        /* xorshift64* */
+        uint64_t x = r4300->random_state;
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        r4300->random_state = x;
+        return (unsigned int)((x * UINT64_C(0x2545F4914F6CDD1D)) >> 32) % 0x40;
     } else
         return 0;
 }
@@ -558,6 +557,18 @@ void gen_interrupt(struct r4300_core* r4300)
             return;
         }
 
+        if (rewind_restore_pending())
+        {
+            rewind_restore();
+            return;
+        }
+
+        if (movie_restore_pending())
+        {
+            movie_restore();
+            return;
+        }
+
         if (r4300->reset_hard_job)
         {
             call_interrupt_handler(&r4300->cp0, 11);
@@ -657,6 +668,16 @@ void gen_interrupt(struct r4300_core* r4300)
             savestates_save();
             return;
         }
+
+        if (rewind_capture_pending())
+        {
+            rewind_capture();
+        }
+
+        if (movie_update_pending())
+        {
+            movie_update();
+        }
     }
 }
 
@@ -33,6 +33,7 @@
 #include "api/m64p_types.h"
 #include "api/callbacks.h"
 #include "main/main.h"
+#include "main/profile.h"
 #include "main/rom.h"
 #include "device/memory/memory.h"
 #include "device/r4300/cached_interp.h"
@@ -7649,7 +7650,7 @@ void new_dynarec_cleanup(void)
   #endif
 }
 
-int new_recompile_block(int addr)
+static int recompile_block(int addr)
 {
 #if defined(RECOMPILER_DEBUG) && !defined(RECOMP_DBG)
   recomp_dbg_block(addr);
@@ -10958,6 +10959,16 @@ int new_recompile_block(int addr)
   return 0;
 }
 
+int new_recompile_block(int addr)
+{
+  int r;
+  if(!g_timing_enabled) return recompile_block(addr);
+  timed_section_start(TIMED_SECTION_COMPILER);
+  r=recompile_block(addr);
+  timed_section_end(TIMED_SECTION_COMPILER);
+  return r;
+}
+
 /* interpreted opcode */
 static void ldl_merge(void)
 {
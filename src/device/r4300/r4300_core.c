@@ -38,10 +38,21 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+
+static void r4300_seed_random(struct r4300_core* r4300, uint32_t seed)
+{
+    /* splitmix64 step, so that close seeds give unrelated sequences
+     * and the xorshift state is never 0 */
+    uint64_t z = (uint64_t)seed + UINT64_C(0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    z ^= z >> 31;
+
+    r4300->random_state = (z != 0) ? z : 1;
+}
 
 void init_r4300(struct r4300_core* r4300, struct memory* mem, struct mi_controller* mi, struct rdram* rdram, const struct interrupt_handler* interrupt_handlers,
-    unsigned int emumode, unsigned int count_per_op, int no_compiled_jump, int randomize_interrupt, uint32_t start_address)
+    unsigned int emumode, unsigned int count_per_op, int no_compiled_jump, int randomize_interrupt, uint32_t random_seed, uint32_t start_address)
 {
     struct new_dynarec_hot_state* new_dynarec_hot_state =
 #ifdef NEW_DYNAREC
@@ -63,7 +74,7 @@ void init_r4300(struct r4300_core* r4300, struct memory* mem, struct mi_controll
     r4300->rdram = rdram;
     r4300->randomize_interrupt = randomize_interrupt;
     r4300->start_address = start_address;
-    srand((unsigned int) time(NULL));
+    r4300_seed_random(r4300, random_seed);
 }
 
 void poweron_r4300(struct r4300_core* r4300)
@@ -57,6 +57,8 @@ struct tlb
     struct tlb_entry entries[32];
     uint32_t LUT_r[0x100000];
     uint32_t LUT_w[0x100000];
+    /* incremented whenever LUT_r or LUT_w is modified */
+    uint32_t generation;
 };
 
 void poweron_tlb(struct tlb* tlb);
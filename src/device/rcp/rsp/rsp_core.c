@@ -30,9 +30,7 @@
 #include "device/rcp/ri/ri_controller.h"
 #include "device/rdram/rdram.h"
 #include "main/main.h"
-#if defined(PROFILE)
 #include "main/profile.h"
-#endif
 #include "plugin/plugin.h"
 #include "api/callbacks.h"
 
@@ -316,13 +314,11 @@ void do_SP_Task(struct rsp_core* sp)
 
         //gfx.processDList();
         sp->regs2[SP_PC_REG] &= 0xfff;
-#if defined(PROFILE)
-        timed_section_start(TIMED_SECTION_GFX);
-#endif
+        if (g_timing_enabled)
+            timed_section_start(TIMED_SECTION_GFX);
         rsp.doRspCycles(0xffffffff);
-#if defined(PROFILE)
-        timed_section_end(TIMED_SECTION_GFX);
-#endif
+        if (g_timing_enabled)
+            timed_section_end(TIMED_SECTION_GFX);
         sp->regs2[SP_PC_REG] |= save_pc;
         new_frame();
 
@@ -344,13 +340,11 @@ void do_SP_Task(struct rsp_core* sp)
     {
         //audio.processAList();
         sp->regs2[SP_PC_REG] &= 0xfff;
-#if defined(PROFILE)
-        timed_section_start(TIMED_SECTION_AUDIO);
-#endif
+        if (g_timing_enabled)
+            timed_section_start(TIMED_SECTION_AUDIO);
         rsp.doRspCycles(0xffffffff);
-#if defined(PROFILE)
-        timed_section_end(TIMED_SECTION_AUDIO);
-#endif
+        if (g_timing_enabled)
+            timed_section_end(TIMED_SECTION_AUDIO);
         sp->regs2[SP_PC_REG] |= save_pc;
 
         sp_delay_time = 4000;
@@ -358,7 +352,11 @@ void do_SP_Task(struct rsp_core* sp)
     else
     {
         sp->regs2[SP_PC_REG] &= 0xfff;
+        if (g_timing_enabled)
+            timed_section_start(TIMED_SECTION_RSP);
         rsp.doRspCycles(0xffffffff);
+        if (g_timing_enabled)
+            timed_section_end(TIMED_SECTION_RSP);
         sp->regs2[SP_PC_REG] |= save_pc;
 
         sp_delay_time = 0;
@@ -0,0 +1,277 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - vi_scanout.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "vi_scanout.h"
+
+#include <string.h>
+
+#include "vi_controller.h"
+
+/* SIMD kernels assume the little endian layout of RDRAM words */
+#if !defined(M64P_BIG_ENDIAN)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCANOUT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCANOUT_NEON
+#endif
+#endif
+
+enum vi_pixel_type
+{
+    VI_TYPE_BLANK = 0,
+    VI_TYPE_RESERVED = 1,
+    VI_TYPE_RGBA5551 = 2,
+    VI_TYPE_RGBA8888 = 3
+};
+
+static uint8_t expand5(uint32_t c)
+{
+    return (uint8_t)((c << 3) | (c >> 2));
+}
+
+/* pixels are counted from the beginning of RDRAM, 2 pixels per word,
+ * the first one in the upper half */
+static void convert_rgba5551_scalar(const uint32_t* dram, uint32_t pixel, uint8_t* dst, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; ++i, ++pixel, dst += 3) {
+        uint32_t p = dram[pixel >> 1] >> ((pixel & 1) ? 0 : 16);
+
+        dst[0] = expand5((p >> 11) & 0x1f);
+        dst[1] = expand5((p >>  6) & 0x1f);
+        dst[2] = expand5((p >>  1) & 0x1f);
+    }
+}
+
+static void convert_rgba8888_scalar(const uint32_t* src, uint8_t* dst, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; ++i, dst += 3) {
+        dst[0] = (uint8_t)(src[i] >> 24);
+        dst[1] = (uint8_t)(src[i] >> 16);
+        dst[2] = (uint8_t)(src[i] >>  8);
+    }
+}
+
+#if defined(SCANOUT_SSE2)
+
+/* Store 4 pixels held as 0x00BBGGRR lanes. Writes one byte past the last
+ * pixel, which is overwritten by the following one. */
+static void store_rgb4(uint8_t* dst, __m128i v)
+{
+    uint32_t px[4];
+
+    _mm_storeu_si128((__m128i*)px, v);
+    memcpy(dst + 0, &px[0], 4);
+    memcpy(dst + 3, &px[1], 4);
+    memcpy(dst + 6, &px[2], 4);
+    memcpy(dst + 9, &px[3], 4);
+}
+
+static __m128i expand5_simd(__m128i c)
+{
+    return _mm_or_si128(_mm_slli_epi16(c, 3), _mm_srli_epi16(c, 2));
+}
+
+static void convert_rgba5551(const uint32_t* dram, uint32_t pixel, uint8_t* dst, unsigned int count)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    unsigned int i = 0;
+
+    /* vector loads start on a word boundary */
+    if ((pixel & 1) && count > 0) {
+        convert_rgba5551_scalar(dram, pixel, dst, 1);
+        i = 1;
+    }
+
+    /* leave at least one pixel to the scalar tail, see store_rgb4 */
+    for (; count - i > 8; i += 8) {
+        __m128i p = _mm_loadu_si128((const __m128i*)&dram[(pixel + i) >> 1]);
+        __m128i r, g, b, rg;
+
+        /* first pixel of each word is in its upper half */
+        p = _mm_shufflelo_epi16(p, _MM_SHUFFLE(2, 3, 0, 1));
+        p = _mm_shufflehi_epi16(p, _MM_SHUFFLE(2, 3, 0, 1));
+
+        r = expand5_simd(_mm_and_si128(_mm_srli_epi16(p, 11), mask5));
+        g = expand5_simd(_mm_and_si128(_mm_srli_epi16(p,  6), mask5));
+        b = expand5_simd(_mm_and_si128(_mm_srli_epi16(p,  1), mask5));
+
+        rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        store_rgb4(dst + 3 * i, _mm_unpacklo_epi16(rg, b));
+        store_rgb4(dst + 3 * (i + 4), _mm_unpackhi_epi16(rg, b));
+    }
+
+    convert_rgba5551_scalar(dram, pixel + i, dst + 3 * i, count - i);
+}
+
+static void convert_rgba8888(const uint32_t* src, uint8_t* dst, unsigned int count)
+{
+    const __m128i mask_g = _mm_set1_epi32(0x0000ff00);
+    const __m128i mask_b = _mm_set1_epi32(0x00ff0000);
+    unsigned int i;
+
+    for (i = 0; count - i > 4; i += 4) {
+        __m128i w = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i v = _mm_or_si128(_mm_srli_epi32(w, 24),
+                    _mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 8), mask_g),
+                                 _mm_and_si128(_mm_slli_epi32(w, 8), mask_b)));
+        store_rgb4(dst + 3 * i, v);
+    }
+
+    convert_rgba8888_scalar(src + i, dst + 3 * i, count - i);
+}
+
+#elif defined(SCANOUT_NEON)
+
+static uint8x8_t expand5_simd(uint8x8_t c)
+{
+    return vorr_u8(vshl_n_u8(c, 3), vshr_n_u8(c, 2));
+}
+
+static void convert_rgba5551(const uint32_t* dram, uint32_t pixel, uint8_t* dst, unsigned int count)
+{
+    const uint8x8_t mask5 = vdup_n_u8(0x1f);
+    unsigned int i = 0;
+
+    if ((pixel & 1) && count > 0) {
+        convert_rgba5551_scalar(dram, pixel, dst, 1);
+        i = 1;
+    }
+
+    for (; count - i >= 8; i += 8) {
+        /* first pixel of each word is in its upper half */
+        uint16x8_t p = vrev32q_u16(vreinterpretq_u16_u32(vld1q_u32(&dram[(pixel + i) >> 1])));
+        uint8x8x3_t rgb;
+
+        rgb.val[0] = expand5_simd(vmovn_u16(vshrq_n_u16(p, 11)));
+        rgb.val[1] = expand5_simd(vand_u8(vmovn_u16(vshrq_n_u16(p, 6)), mask5));
+        rgb.val[2] = expand5_simd(vand_u8(vmovn_u16(vshrq_n_u16(p, 1)), mask5));
+        vst3_u8(dst + 3 * i, rgb);
+    }
+
+    convert_rgba5551_scalar(dram, pixel + i, dst + 3 * i, count - i);
+}
+
+static void convert_rgba8888(const uint32_t* src, uint8_t* dst, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; count - i >= 8; i += 8) {
+        /* bytes of each word are A, B, G, R in memory */
+        uint8x8x4_t abgr = vld4_u8((const uint8_t*)&src[i]);
+        uint8x8x3_t rgb;
+
+        rgb.val[0] = abgr.val[3];
+        rgb.val[1] = abgr.val[2];
+        rgb.val[2] = abgr.val[1];
+        vst3_u8(dst + 3 * i, rgb);
+    }
+
+    convert_rgba8888_scalar(src + i, dst + 3 * i, count - i);
+}
+
+#else
+
+static void convert_rgba5551(const uint32_t* dram, uint32_t pixel, uint8_t* dst, unsigned int count)
+{
+    convert_rgba5551_scalar(dram, pixel, dst, count);
+}
+
+static void convert_rgba8888(const uint32_t* src, uint8_t* dst, unsigned int count)
+{
+    convert_rgba8888_scalar(src, dst, count);
+}
+
+#endif
+
+void vi_scanout_size(const struct vi_controller* vi, unsigned int* width, unsigned int* height)
+{
+    uint32_t type = vi->regs[VI_STATUS_REG] & 0x3;
+    uint32_t h_start = (vi->regs[VI_H_START_REG] >> 16) & 0x3ff;
+    uint32_t h_end = vi->regs[VI_H_START_REG] & 0x3ff;
+    uint32_t v_start = (vi->regs[VI_V_START_REG] >> 16) & 0x3ff;
+    uint32_t v_end = vi->regs[VI_V_START_REG] & 0x3ff;
+    uint32_t x_scale = vi->regs[VI_X_SCALE_REG] & 0xfff;
+    uint32_t y_scale = vi->regs[VI_Y_SCALE_REG] & 0xfff;
+    uint32_t line_width = vi->regs[VI_WIDTH_REG] & 0xfff;
+    uint32_t w, h;
+
+    *width = 0;
+    *height = 0;
+
+    if (type != VI_TYPE_RGBA5551 && type != VI_TYPE_RGBA8888)
+        return;
+
+    if (h_end <= h_start || v_end <= v_start)
+        return;
+
+    /* scales are 2.10 fixed point, V_START counts half lines */
+    w = ((h_end - h_start) * x_scale) >> 10;
+    h = (((v_end - v_start) >> 1) * y_scale) >> 10;
+
+    if (w > line_width)
+        w = line_width;
+    if (w > VI_SCANOUT_MAX_WIDTH)
+        w = VI_SCANOUT_MAX_WIDTH;
+    if (h > VI_SCANOUT_MAX_HEIGHT)
+        h = VI_SCANOUT_MAX_HEIGHT;
+
+    if (w == 0 || h == 0)
+        return;
+
+    *width = w;
+    *height = h;
+}
+
+void vi_scanout(const struct vi_controller* vi, const uint32_t* dram, size_t dram_size, uint8_t* rgb)
+{
+    uint32_t type = vi->regs[VI_STATUS_REG] & 0x3;
+    uint32_t origin = vi->regs[VI_ORIGIN_REG] & 0xffffff;
+    uint32_t line_width = vi->regs[VI_WIDTH_REG] & 0xfff;
+    unsigned int bpp = (type == VI_TYPE_RGBA8888) ? 4 : 2;
+    unsigned int width, height, y;
+
+    vi_scanout_size(vi, &width, &height);
+
+    for (y = 0; y < height; ++y) {
+        uint8_t* dst = rgb + (size_t)y * width * 3;
+        size_t addr = (size_t)origin + (size_t)y * line_width * bpp;
+
+        /* 32-bit pixels are word aligned, 16-bit ones halfword aligned */
+        addr &= ~(size_t)(bpp - 1);
+
+        if (addr + (size_t)width * bpp > dram_size) {
+            memset(dst, 0, (size_t)width * 3);
+            continue;
+        }
+
+        if (bpp == 4)
+            convert_rgba8888(&dram[addr >> 2], dst, width);
+        else
+            convert_rgba5551(dram, (uint32_t)(addr >> 1), dst, width);
+    }
+}
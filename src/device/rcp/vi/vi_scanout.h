@@ -0,0 +1,49 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - vi_scanout.h                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_DEVICE_RCP_VI_VI_SCANOUT_H
+#define M64P_DEVICE_RCP_VI_VI_SCANOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct vi_controller;
+
+/* Software scanout: decodes the framebuffer described by the VI registers
+ * straight from RDRAM, without the help of the video plugin.
+ *
+ * The picture has one pixel per framebuffer pixel: its size is the visible
+ * area (H_START/V_START) divided by the scale factors (X_SCALE/Y_SCALE).
+ * Filtering, anti-aliasing and dithering done by the VI aren't emulated.
+ */
+
+enum { VI_SCANOUT_MAX_WIDTH = 1024, VI_SCANOUT_MAX_HEIGHT = 1024 };
+
+/* Size of the picture, 0x0 when the VI is blanked */
+void vi_scanout_size(const struct vi_controller* vi, unsigned int* width, unsigned int* height);
+
+/* Decode the picture into top-down RGB24 rows of width*3 bytes,
+ * rgb must hold width*height*3 bytes as given by vi_scanout_size.
+ * Rows lying outside of RDRAM are black. */
+void vi_scanout(const struct vi_controller* vi, const uint32_t* dram, size_t dram_size, uint8_t* rgb);
+
+#endif
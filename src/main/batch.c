@@ -0,0 +1,112 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - batch.c                                                 *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "batch.h"
+
+#include <string.h>
+
+#include "backends/api/clock_backend.h"
+#include "backends/clock_monotonic.h"
+#include "profile.h"
+
+struct batch_globals {
+    int enabled;
+    m64p_batch_params params;
+
+    uint64_t start;             /* ns */
+    uint32_t last_count;
+    uint64_t cycles;            /* CP0 Count ticks since start */
+
+    m64p_batch_stats stats;
+};
+
+static struct batch_globals l_batch;
+
+static uint64_t batch_now(void)
+{
+    return g_iclock_monotonic.get_time_ns(NULL);
+}
+
+void batch_set_params(const m64p_batch_params* params)
+{
+    l_batch.enabled = (params != NULL);
+    if (params != NULL)
+        l_batch.params = *params;
+}
+
+int batch_enabled(void)
+{
+    return l_batch.enabled;
+}
+
+void batch_start(uint32_t count)
+{
+    memset(&l_batch.stats, 0, sizeof(l_batch.stats));
+    l_batch.cycles = 0;
+    l_batch.last_count = count;
+
+    timed_sections_reset();
+    l_batch.start = batch_now();
+}
+
+void batch_finish(uint32_t count, unsigned int count_per_op)
+{
+    m64p_batch_stats* stats = &l_batch.stats;
+
+    stats->wall_time_ns = batch_now() - l_batch.start;
+
+    l_batch.cycles += (uint32_t)(count - l_batch.last_count);
+    l_batch.last_count = count;
+
+    stats->vis_per_second = (stats->wall_time_ns == 0)
+        ? 0.0
+        : stats->vis * 1e9 / stats->wall_time_ns;
+    stats->guest_instructions = (count_per_op == 0) ? 0 : l_batch.cycles / count_per_op;
+
+    stats->compile_time_ns = timed_section_total(TIMED_SECTION_COMPILER);
+    stats->gfx_time_ns = timed_section_total(TIMED_SECTION_GFX);
+    stats->audio_time_ns = timed_section_total(TIMED_SECTION_AUDIO);
+    stats->rsp_time_ns = timed_section_total(TIMED_SECTION_RSP);
+}
+
+int batch_new_vi(uint32_t count)
+{
+    /* accumulate per VI, the 32 bits counter wraps every 90 seconds or so */
+    l_batch.cycles += (uint32_t)(count - l_batch.last_count);
+    l_batch.last_count = count;
+
+    ++l_batch.stats.vis;
+
+    return l_batch.params.max_vis != 0 && l_batch.stats.vis >= l_batch.params.max_vis;
+}
+
+int batch_new_frame(void)
+{
+    ++l_batch.stats.frames;
+
+    return l_batch.params.max_frames != 0 && l_batch.stats.frames >= l_batch.params.max_frames;
+}
+
+void batch_get_stats(m64p_batch_stats* stats)
+{
+    *stats = l_batch.stats;
+}
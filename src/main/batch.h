@@ -0,0 +1,49 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - batch.h                                                 *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_BATCH_H
+#define M64P_MAIN_BATCH_H
+
+#include <stdint.h>
+
+#include "api/m64p_types.h"
+
+/* Headless batch runs: the emulation runs unthrottled, without input
+ * polling nor OSD, stops after a fixed number of VIs or frames and
+ * reports performance statistics.
+ */
+
+/* Enable batch mode for the next runs (NULL disables it) */
+void batch_set_params(const m64p_batch_params* params);
+int batch_enabled(void);
+
+/* count is the CP0 Count register */
+void batch_start(uint32_t count);
+void batch_finish(uint32_t count, unsigned int count_per_op);
+
+/* Return 1 when the run limit is reached */
+int batch_new_vi(uint32_t count);
+int batch_new_frame(void);
+
+void batch_get_stats(m64p_batch_stats* stats);
+
+#endif /* M64P_MAIN_BATCH_H */
@@ -61,6 +61,27 @@ typedef struct cheat {
     struct list_head list;
 } cheat_t;
 
+/* compiled form of the codes of the enabled cheats, see compile_cheats */
+enum cheat_op_kind {
+    CHEAT_OP_WRITE8,
+    CHEAT_OP_WRITE16,
+    CHEAT_OP_TEST8,
+    CHEAT_OP_TEST16
+};
+
+#define CHEAT_OP_GS_BUTTON  0x01    /* only when the GS button is pressed */
+#define CHEAT_OP_NOT_EQUAL  0x02    /* tests: inverted comparison */
+
+struct cheat_op {
+    uint8_t kind;
+    uint8_t flags;
+    uint16_t value;
+    uint32_t address;       /* for cached code invalidation */
+    unsigned char* mem;     /* host address in RDRAM */
+    uint32_t* old_value;    /* where to save the overwritten value, or NULL */
+    size_t skip;            /* tests: number of ops to skip when false */
+};
+
 /* private functions */
 static uint16_t read_address_16bit(struct r4300_core* r4300, uint32_t address)
 {
@@ -195,6 +216,12 @@ void cheat_init(struct cheat_ctx* ctx)
 {
     ctx->mutex = SDL_CreateMutex();
     INIT_LIST_HEAD(&ctx->active_cheats);
+
+    ctx->program = NULL;
+    ctx->program_size = 0;
+    ctx->program_capacity = 0;
+    ctx->program_dram = NULL;
+    ctx->dirty = 1;
 }
 
 void cheat_uninit(struct cheat_ctx* ctx)
@@ -203,23 +230,19 @@ void cheat_uninit(struct cheat_ctx* ctx)
         SDL_DestroyMutex(ctx->mutex);
     }
     ctx->mutex = NULL;
+
+    free(ctx->program);
+    ctx->program = NULL;
+    ctx->program_size = 0;
+    ctx->program_capacity = 0;
 }
 
-void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry)
+static void apply_cheats_list(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry)
 {
     cheat_t *cheat;
     cheat_code_t *code;
     int cond_failed;
 
-    if (list_empty(&ctx->active_cheats))
-        return;
-
-    if (ctx->mutex == NULL || SDL_LockMutex(ctx->mutex) != 0)
-    {
-        DebugMessage(M64MSG_ERROR, "Internal error: failed to lock mutex in cheat_apply_cheats()");
-        return;
-    }
-
     list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
         if (cheat->enabled)
         {
@@ -312,6 +335,227 @@ void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int ent
             }
         }
     }
+}
+
+static struct cheat_op* emit_op(struct cheat_ctx* ctx, unsigned char* dram, unsigned char kind, unsigned char flags,
+                                uint32_t address, uint32_t value, uint32_t* old_value)
+{
+    struct cheat_op* op;
+
+    if (ctx->program_size == ctx->program_capacity) {
+        size_t capacity = (ctx->program_capacity == 0) ? 64 : 2 * ctx->program_capacity;
+        struct cheat_op* program = realloc(ctx->program, capacity * sizeof(*program));
+        if (program == NULL)
+            return NULL;
+
+        ctx->program = program;
+        ctx->program_capacity = capacity;
+    }
+
+    op = &ctx->program[ctx->program_size++];
+    op->kind = kind;
+    op->flags = flags;
+    op->value = (uint16_t)value;
+    op->old_value = old_value;
+    op->skip = 0;
+
+    if (kind == CHEAT_OP_WRITE8 || kind == CHEAT_OP_TEST8) {
+        op->address = address;
+        op->mem = dram + ((address & 0xFFFFFF) ^ S8);
+    }
+    else {
+        /* mask out bit 24 which is used by GS codes to specify 8/16 bits */
+        op->address = address & 0xfeffffff;
+        op->mem = dram + ((address & 0xFFFFFF) ^ S16);
+    }
+
+    return op;
+}
+
+/* Compile the codes of the enabled cheats as they are applied at ENTRY_VI,
+ * so that the codes don't have to be decoded again on every VI.
+ * A failed test jumps over the following tests and the next non-test code
+ * (which is what the cond_failed logic of apply_cheats_list amounts to),
+ * codes having no effect at ENTRY_VI are left out.
+ */
+static int compile_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300)
+{
+    unsigned char* dram = (unsigned char*)r4300->rdram->dram;
+    cheat_t *cheat;
+    cheat_code_t *code;
+    size_t tests, i;
+    int ok;
+
+    ctx->program_size = 0;
+
+    list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
+        if (!cheat->enabled)
+            continue;
+
+        /* first test of the current conditional block */
+        tests = SIZE_MAX;
+
+        list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+            uint32_t type = code->address & 0xFF000000;
+
+            /* conditional cheat codes */
+            if ((type & 0xF0000000) == 0xD0000000)
+            {
+                unsigned char kind;
+                unsigned char flags = (type >= 0xD8000000) ? CHEAT_OP_GS_BUTTON : 0;
+
+                switch (type) {
+                case 0xD0000000: case 0xD8000000: kind = CHEAT_OP_TEST8; break;
+                case 0xD1000000: case 0xD9000000: kind = CHEAT_OP_TEST16; break;
+                case 0xD2000000: case 0xDB000000: kind = CHEAT_OP_TEST8; flags |= CHEAT_OP_NOT_EQUAL; break;
+                case 0xD3000000: case 0xDA000000: kind = CHEAT_OP_TEST16; flags |= CHEAT_OP_NOT_EQUAL; break;
+                /* unknown tests always pass */
+                default: continue;
+                }
+
+                if (emit_op(ctx, dram, kind, flags, code->address, code->value, NULL) == NULL)
+                    return 0;
+                if (tests == SIZE_MAX)
+                    tests = ctx->program_size - 1;
+                continue;
+            }
+
+            ok = 1;
+            switch (type) {
+            case 0x80000000:
+            case 0xA0000000:
+                ok = emit_op(ctx, dram, CHEAT_OP_WRITE8, 0, code->address, code->value, &code->old_value) != NULL;
+                break;
+            case 0x81000000:
+            case 0xA1000000:
+                ok = emit_op(ctx, dram, CHEAT_OP_WRITE16, 0, code->address, code->value, &code->old_value) != NULL;
+                break;
+            /* GS button triggers cheat code */
+            case 0x88000000:
+            case 0xA8000000:
+                ok = emit_op(ctx, dram, CHEAT_OP_WRITE8, CHEAT_OP_GS_BUTTON, code->address, code->value, NULL) != NULL;
+                break;
+            case 0x89000000:
+            case 0xA9000000:
+                ok = emit_op(ctx, dram, CHEAT_OP_WRITE16, CHEAT_OP_GS_BUTTON, code->address, code->value, NULL) != NULL;
+                break;
+            case 0xEE000000:
+                ok = emit_op(ctx, dram, CHEAT_OP_WRITE16, 0, 0xF1000318, 0x0040, NULL) != NULL;
+                ok = ok && emit_op(ctx, dram, CHEAT_OP_WRITE16, 0, 0xF100031A, 0x0000, NULL) != NULL;
+                break;
+            /* boot-time and unknown codes don't do anything,
+             * but still end a conditional block */
+            default:
+                break;
+            }
+
+            if (!ok)
+                return 0;
+
+            if (tests != SIZE_MAX) {
+                for (i = tests; i < ctx->program_size && ctx->program[i].kind >= CHEAT_OP_TEST8; ++i)
+                    ctx->program[i].skip = ctx->program_size - (i + 1);
+                tests = SIZE_MAX;
+            }
+        }
+
+        /* trailing tests only skip to the end of the cheat */
+        if (tests != SIZE_MAX) {
+            for (i = tests; i < ctx->program_size; ++i)
+                ctx->program[i].skip = ctx->program_size - (i + 1);
+        }
+    }
+
+    ctx->program_dram = dram;
+    return 1;
+}
+
+static void run_cheat_program(struct cheat_ctx* ctx, struct r4300_core* r4300)
+{
+    const struct cheat_op* op = ctx->program;
+    const struct cheat_op* end = ctx->program + ctx->program_size;
+    int gs_active = event_gameshark_active();
+
+    while (op < end)
+    {
+        if ((op->flags & CHEAT_OP_GS_BUTTON) && !gs_active) {
+            /* a GS button test fails like a false condition */
+            op += 1 + ((op->kind >= CHEAT_OP_TEST8) ? op->skip : 0);
+            continue;
+        }
+
+        switch (op->kind)
+        {
+        /* memory which already holds the value is left alone,
+         * so that it doesn't invalidate the cached code every VI */
+        case CHEAT_OP_WRITE8:
+            if (*op->mem != (uint8_t)op->value) {
+                if (op->old_value && (*op->old_value == CHEAT_CODE_MAGIC_VALUE)) {
+                    *op->old_value = *op->mem;
+                }
+                *op->mem = (uint8_t)op->value;
+                invalidate_r4300_cached_code(r4300, op->address, 1);
+            }
+            else if (op->old_value && (*op->old_value == CHEAT_CODE_MAGIC_VALUE)) {
+                *op->old_value = op->value;
+            }
+            break;
+        case CHEAT_OP_WRITE16:
+            if (*(uint16_t*)op->mem != op->value) {
+                if (op->old_value && (*op->old_value == CHEAT_CODE_MAGIC_VALUE)) {
+                    *op->old_value = *(uint16_t*)op->mem;
+                }
+                *(uint16_t*)op->mem = op->value;
+                invalidate_r4300_cached_code(r4300, op->address, 2);
+            }
+            else if (op->old_value && (*op->old_value == CHEAT_CODE_MAGIC_VALUE)) {
+                *op->old_value = op->value;
+            }
+            break;
+        case CHEAT_OP_TEST8:
+            if ((*op->mem == (uint8_t)op->value) == !(op->flags & CHEAT_OP_NOT_EQUAL)) {
+                break;
+            }
+            op += op->skip;
+            break;
+        case CHEAT_OP_TEST16:
+            if ((*(uint16_t*)op->mem == op->value) == !(op->flags & CHEAT_OP_NOT_EQUAL)) {
+                break;
+            }
+            op += op->skip;
+            break;
+        }
+
+        ++op;
+    }
+}
+
+void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry)
+{
+    if (list_empty(&ctx->active_cheats))
+        return;
+
+    if (ctx->mutex == NULL || SDL_LockMutex(ctx->mutex) != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "Internal error: failed to lock mutex in cheat_apply_cheats()");
+        return;
+    }
+
+    if (entry == ENTRY_VI && !ctx->dirty && ctx->program_dram == (unsigned char*)r4300->rdram->dram)
+    {
+        run_cheat_program(ctx, r4300);
+    }
+    else
+    {
+        /* cheats were changed since the last VI: apply them (and restore
+         * the memory of disabled ones) from the list, then compile them.
+         * If that fails, we keep applying them from the list. */
+        apply_cheats_list(ctx, r4300, entry);
+
+        if (entry == ENTRY_VI) {
+            ctx->dirty = !compile_cheats(ctx, r4300);
+        }
+    }
 
     SDL_UnlockMutex(ctx->mutex);
 }
@@ -342,6 +586,9 @@ void cheat_delete_all(struct cheat_ctx* ctx)
         free(cheat);
     }
 
+    ctx->program_size = 0;
+    ctx->dirty = 1;
+
     SDL_UnlockMutex(ctx->mutex);
 }
 
@@ -362,6 +609,7 @@ int cheat_set_enabled(struct cheat_ctx* ctx, const char* name, int enabled)
         if (strcmp(name, cheat->name) == 0)
         {
             cheat->enabled = enabled;
+            ctx->dirty = 1;
             SDL_UnlockMutex(ctx->mutex);
             return 1;
         }
@@ -392,6 +640,7 @@ int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code
 
     /* default for new cheats is enabled */
     cheat->enabled = 1;
+    ctx->dirty = 1;
 
     for (i = 0; i < num_codes; i++)
     {
@@ -26,6 +26,7 @@
 
 #include "list.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define ENTRY_BOOT 0
@@ -33,11 +34,19 @@
 
 struct SDL_mutex;
 struct r4300_core;
+struct cheat_op;
 
 struct cheat_ctx
 {
     struct SDL_mutex* mutex;
     struct list_head active_cheats;
+
+    /* enabled cheats compiled for ENTRY_VI, rebuilt after any change */
+    struct cheat_op* program;
+    size_t program_size;
+    size_t program_capacity;
+    unsigned char* program_dram;
+    int dirty;
 };
 
 void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry);
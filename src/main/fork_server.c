@@ -0,0 +1,358 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - fork_server.c                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "fork_server.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "device/device.h"
+#include "main/main.h"
+#include "main/movie.h"
+
+#if !defined(WIN32)
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { FORK_SERVER_MAX_REQUEST = 4096 };
+enum { FORK_SERVER_POLL_MS = 250 };
+enum { FORK_SERVER_REQUEST_TIMEOUT_MS = 5000 };
+
+/* a client which went away must not kill the server with SIGPIPE */
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+struct fork_server_globals {
+    char *socket_path;          /* NULL if not armed */
+    unsigned int vis;           /* VIs left before serving */
+
+    pid_t *children;            /* not reaped yet */
+    size_t child_count;
+    size_t child_capacity;
+};
+
+static struct fork_server_globals l_fork_server;
+
+m64p_error fork_server_start(const char* socket_path, unsigned int vis)
+{
+    struct sockaddr_un addr;
+
+    if (l_fork_server.socket_path != NULL)
+        return M64ERR_INVALID_STATE;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+        return M64ERR_INPUT_INVALID;
+
+    l_fork_server.socket_path = malloc(strlen(socket_path) + 1);
+    if (l_fork_server.socket_path == NULL)
+        return M64ERR_NO_MEMORY;
+
+    strcpy(l_fork_server.socket_path, socket_path);
+    l_fork_server.vis = vis;
+
+    return M64ERR_SUCCESS;
+}
+
+void fork_server_cancel(void)
+{
+    free(l_fork_server.socket_path);
+    l_fork_server.socket_path = NULL;
+    l_fork_server.vis = 0;
+}
+
+int fork_server_new_vi(void)
+{
+    if (l_fork_server.socket_path == NULL)
+        return 0;
+
+    if (l_fork_server.vis > 0) {
+        l_fork_server.vis--;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Reaps every child which exited, including ones fork_server_add_child could not track */
+static void fork_server_reap_children(void)
+{
+    pid_t pid;
+
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        size_t i;
+
+        for (i = 0; i < l_fork_server.child_count; ++i) {
+            if (l_fork_server.children[i] == pid) {
+                l_fork_server.children[i] = l_fork_server.children[--l_fork_server.child_count];
+                break;
+            }
+        }
+    }
+}
+
+static int64_t fork_server_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int fork_server_add_child(pid_t pid)
+{
+    if (l_fork_server.child_count == l_fork_server.child_capacity) {
+        size_t capacity = (l_fork_server.child_capacity == 0) ? 16 : 2 * l_fork_server.child_capacity;
+        pid_t *children = realloc(l_fork_server.children, capacity * sizeof(*children));
+        if (children == NULL)
+            return -1;
+        l_fork_server.children = children;
+        l_fork_server.child_capacity = capacity;
+    }
+
+    l_fork_server.children[l_fork_server.child_count++] = pid;
+    return 0;
+}
+
+static void fork_server_reply(int fd, const char* reply)
+{
+    size_t size = strlen(reply);
+
+    while (size > 0) {
+        ssize_t n = send(fd, reply, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        reply += n;
+        size -= n;
+    }
+}
+
+/* Read one request line, without its terminator.
+ * The whole line must arrive within FORK_SERVER_REQUEST_TIMEOUT_MS, so a client
+ * trickling bytes can't hold the server; also gives up if the emulation is stopped. */
+static int fork_server_read_request(struct device* dev, int fd, char* request, size_t size)
+{
+    int64_t deadline = fork_server_now_ms() + FORK_SERVER_REQUEST_TIMEOUT_MS;
+    size_t len = 0;
+
+    while (len + 1 < size) {
+        struct pollfd pfd;
+        int64_t left = deadline - fork_server_now_ms();
+        ssize_t n;
+
+        if (left <= 0 || *r4300_stop(&dev->r4300)) {
+            len = 0;
+            break;
+        }
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        n = poll(&pfd, 1, (left < FORK_SERVER_POLL_MS) ? (int)left : FORK_SERVER_POLL_MS);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n == 0)
+            continue;
+        if (n < 0)
+            break;
+
+        n = read(fd, request + len, 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        if (request[len] == '\n')
+            break;
+        ++len;
+    }
+
+    if (len > 0 && request[len - 1] == '\r')
+        --len;
+
+    request[len] = '\0';
+    return (len > 0) ? 0 : -1;
+}
+
+/* Returns 1 in the child */
+static int fork_server_fork(int listen_fd, int fd, const char* movie)
+{
+    char reply[64];
+    pid_t pid;
+
+    /* don't let children output buffered messages of the server again */
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0) {
+        fork_server_reply(fd, "ERROR fork failed\n");
+        return 0;
+    }
+
+    if (pid == 0) {
+        close(listen_fd);
+        close(fd);
+
+        free(l_fork_server.children);
+        memset(&l_fork_server, 0, sizeof(l_fork_server));
+
+        if (movie != NULL && movie_play_from_current_state(movie) != M64ERR_SUCCESS)
+            DebugMessage(M64MSG_ERROR, "Fork server child could not play movie %s", movie);
+
+        return 1;
+    }
+
+    if (fork_server_add_child(pid) != 0)
+        DebugMessage(M64MSG_WARNING, "Fork server can't track child %d", (int)pid);
+
+    snprintf(reply, sizeof(reply), "%d\n", (int)pid);
+    fork_server_reply(fd, reply);
+    return 0;
+}
+
+int fork_server_run(struct device* dev)
+{
+    struct sockaddr_un addr;
+    char request[FORK_SERVER_MAX_REQUEST];
+    int listen_fd;
+    int child = 0;
+    int quit = 0;
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        DebugMessage(M64MSG_ERROR, "Fork server could not create socket: %s", strerror(errno));
+        fork_server_cancel();
+        return 0;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, l_fork_server.socket_path);
+    unlink(l_fork_server.socket_path);
+
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+     || listen(listen_fd, 16) != 0) {
+        DebugMessage(M64MSG_ERROR, "Fork server could not listen on %s: %s",
+                     l_fork_server.socket_path, strerror(errno));
+        close(listen_fd);
+        fork_server_cancel();
+        return 0;
+    }
+
+    DebugMessage(M64MSG_INFO, "Fork server listening on %s", l_fork_server.socket_path);
+
+    while (!quit && !*r4300_stop(&dev->r4300)) {
+        struct pollfd pfd;
+        int fd;
+
+        fork_server_reap_children();
+
+        pfd.fd = listen_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, FORK_SERVER_POLL_MS) <= 0)
+            continue;
+
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+
+#if defined(SO_NOSIGPIPE)
+        {
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+        }
+#endif
+
+        if (fork_server_read_request(dev, fd, request, sizeof(request)) != 0) {
+            fork_server_reply(fd, "ERROR empty request\n");
+        }
+        else if (strcmp(request, "FORK") == 0) {
+            child = fork_server_fork(listen_fd, fd, NULL);
+        }
+        else if (strncmp(request, "FORK ", 5) == 0) {
+            child = fork_server_fork(listen_fd, fd, request + 5);
+        }
+        else if (strcmp(request, "QUIT") == 0) {
+            fork_server_reply(fd, "OK\n");
+            quit = 1;
+        }
+        else {
+            fork_server_reply(fd, "ERROR unknown request\n");
+        }
+
+        /* the child resumes the emulation */
+        if (child)
+            return 1;
+
+        close(fd);
+    }
+
+    close(listen_fd);
+    unlink(l_fork_server.socket_path);
+    fork_server_reap_children();
+    DebugMessage(M64MSG_INFO, "Fork server stopped, %u children still running",
+                 (unsigned int)l_fork_server.child_count);
+
+    free(l_fork_server.children);
+    l_fork_server.children = NULL;
+    l_fork_server.child_count = 0;
+    l_fork_server.child_capacity = 0;
+    fork_server_cancel();
+
+    return 0;
+}
+
+#else
+
+m64p_error fork_server_start(const char* socket_path, unsigned int vis)
+{
+    return M64ERR_UNSUPPORTED;
+}
+
+void fork_server_cancel(void)
+{
+}
+
+int fork_server_new_vi(void)
+{
+    return 0;
+}
+
+int fork_server_run(struct device* dev)
+{
+    return 0;
+}
+
+#endif
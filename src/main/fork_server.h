@@ -0,0 +1,59 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - fork_server.h                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_FORK_SERVER_H
+#define M64P_MAIN_FORK_SERVER_H
+
+#include "api/m64p_types.h"
+
+struct device;
+
+/* Fork server: once the emulation reaches the requested VI, the emulation
+ * thread stops there and serves requests on a local (unix domain) socket.
+ * Each request forks a child process which resumes the emulation from that
+ * VI, sharing memory and translated code copy-on-write with the server.
+ *
+ * Protocol, one text line per request and per reply:
+ *   "FORK [movie]"  fork a child, which replays the input of the movie file
+ *                   (if given) from the fork point. Replies the child pid.
+ *   "QUIT"          stop serving and stop the emulation. Replies "OK".
+ * Failures are replied as "ERROR <reason>".
+ *
+ * Only the emulation thread survives in children: the audio thread must be
+ * disabled and plugins must not rely on threads of their own. Children also
+ * inherit the plugins' windows, GL contexts and devices, so no audio plugin
+ * may be attached and the video plugin must render offscreen.
+ * Only available on POSIX systems.
+ */
+
+/* Serve on socket_path after vis more VIs */
+m64p_error fork_server_start(const char* socket_path, unsigned int vis);
+void fork_server_cancel(void);
+
+/* Called on each VI, returns 1 when the server must run */
+int fork_server_new_vi(void);
+
+/* Serve requests until QUIT or until the emulation is stopped.
+ * Returns 1 in forked children, 0 in the server. */
+int fork_server_run(struct device* dev);
+
+#endif /* M64P_MAIN_FORK_SERVER_H */
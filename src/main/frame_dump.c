@@ -0,0 +1,600 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_dump.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "frame_dump.h"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "backends/api/audio_out_backend.h"
+#include "main/list.h"
+#include "main/main.h"
+#include "plugin/plugin.h"
+
+/* bytes queued for the writer before dropping */
+static const size_t default_queue_budget = 256 * 1024 * 1024;
+
+/* stdio buffer of the output files */
+enum { FRAME_DUMP_FILE_BUFFER = 4 * 1024 * 1024 };
+
+enum { WAV_HEADER_SIZE = 44 };
+
+enum frame_dump_block_type
+{
+    DUMP_VIDEO,
+    DUMP_VIDEO_REPEAT,      /* no new frame, write the previous one again */
+    DUMP_AUDIO,
+    DUMP_AUDIO_FORMAT
+};
+
+struct frame_dump_block
+{
+    struct list_head list;
+    uint32_t type;
+    uint32_t width;         /* DUMP_VIDEO */
+    uint32_t height;
+    uint32_t flags;         /* m64p_frame_flags */
+    uint32_t frequency;     /* DUMP_AUDIO_FORMAT */
+    size_t size;
+    unsigned char data[];
+};
+
+struct frame_dump_globals {
+    /* set up by the front-end */
+    int armed;
+    char *video_path;
+    char *audio_path;
+    m64p_frame_dump_format format;
+    size_t budget;
+
+    FILE *video;
+    FILE *audio;
+
+    /* queue, protected by lock */
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *cond;
+    struct list_head queue;
+    size_t queued;
+    int quit;
+
+    /* emulation thread */
+    unsigned int frames;
+    unsigned int dropped_frames;
+    size_t dropped_audio;
+    void *aout;
+    const struct audio_out_backend_interface *iaout;
+
+    /* writer thread */
+    unsigned int vi_rate;
+    unsigned int width;
+    unsigned int height;
+    unsigned char *rgb;     /* last frame, top-down */
+    unsigned char *out;     /* conversion buffer */
+    unsigned int audio_frequency;
+    int audio_header_written;
+    uint64_t audio_bytes;
+    unsigned char *samples;
+    size_t samples_capacity;
+    int write_error;
+};
+
+static struct frame_dump_globals l_frame_dump;
+
+static void put_u16(unsigned char* p, uint16_t v)
+{
+    p[0] = (unsigned char)(v >> 0);
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >>  0);
+    p[1] = (unsigned char)(v >>  8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static char* frame_dump_strdup(const char* s)
+{
+    char* copy;
+
+    if (s == NULL)
+        return NULL;
+
+    copy = malloc(strlen(s) + 1);
+    if (copy != NULL)
+        strcpy(copy, s);
+    return copy;
+}
+
+/*********************************************************************************************************
+* Writer thread
+*/
+
+static void frame_dump_write(FILE* f, const void* data, size_t size)
+{
+    if (!l_frame_dump.write_error && fwrite(data, 1, size, f) != size) {
+        DebugMessage(M64MSG_ERROR, "Could not write frame dump, dumping stopped");
+        l_frame_dump.write_error = 1;
+    }
+}
+
+/* BT.601 limited range */
+static void rgb_to_yuv444(const unsigned char* rgb, unsigned char* yuv, size_t pixels)
+{
+    unsigned char* y = yuv;
+    unsigned char* u = yuv + pixels;
+    unsigned char* v = yuv + 2 * pixels;
+    size_t i;
+
+    for (i = 0; i < pixels; ++i, rgb += 3) {
+        int r = rgb[0], g = rgb[1], b = rgb[2];
+
+        y[i] = (unsigned char)((( 66 * r + 129 * g +  25 * b + 128) >> 8) +  16);
+        u[i] = (unsigned char)(((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128);
+        v[i] = (unsigned char)(((112 * r -  94 * g -  18 * b + 128) >> 8) + 128);
+    }
+}
+
+static void frame_dump_write_frame(void)
+{
+    size_t pixels = (size_t)l_frame_dump.width * l_frame_dump.height;
+
+    if (l_frame_dump.format == M64DUMP_Y4M) {
+        static const char frame_header[] = "FRAME\n";
+
+        rgb_to_yuv444(l_frame_dump.rgb, l_frame_dump.out, pixels);
+        frame_dump_write(l_frame_dump.video, frame_header, sizeof(frame_header) - 1);
+        frame_dump_write(l_frame_dump.video, l_frame_dump.out, pixels * 3);
+    }
+    else {
+        frame_dump_write(l_frame_dump.video, l_frame_dump.rgb, pixels * 3);
+    }
+}
+
+static void frame_dump_video(const struct frame_dump_block* block)
+{
+    unsigned int y, rows, row_size;
+
+    /* the first frame gives the video size */
+    if (l_frame_dump.rgb == NULL) {
+        size_t size = (size_t)block->width * block->height * 3;
+
+        l_frame_dump.rgb = malloc(size);
+        l_frame_dump.out = malloc(size);
+        if (l_frame_dump.rgb == NULL || l_frame_dump.out == NULL) {
+            DebugMessage(M64MSG_ERROR, "Could not allocate frame dump buffers, dumping stopped");
+            l_frame_dump.write_error = 1;
+            return;
+        }
+
+        l_frame_dump.width = block->width;
+        l_frame_dump.height = block->height;
+
+        if (l_frame_dump.format == M64DUMP_Y4M) {
+            fprintf(l_frame_dump.video, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n",
+                    l_frame_dump.width, l_frame_dump.height, l_frame_dump.vi_rate);
+        }
+
+        DebugMessage(M64MSG_INFO, "Dumping %ux%u frames at %u fps", l_frame_dump.width, l_frame_dump.height, l_frame_dump.vi_rate);
+    }
+
+    rows = (block->height < l_frame_dump.height) ? block->height : l_frame_dump.height;
+    row_size = ((block->width < l_frame_dump.width) ? block->width : l_frame_dump.width) * 3;
+
+    if (rows < l_frame_dump.height || row_size < l_frame_dump.width * 3)
+        memset(l_frame_dump.rgb, 0, (size_t)l_frame_dump.width * l_frame_dump.height * 3);
+
+    for (y = 0; y < rows; ++y) {
+        unsigned int src_y = (block->flags & M64P_FRAME_BOTTOM_UP) ? block->height - 1 - y : y;
+
+        memcpy(l_frame_dump.rgb + (size_t)y * l_frame_dump.width * 3,
+               block->data + (size_t)src_y * block->width * 3, row_size);
+    }
+
+    frame_dump_write_frame();
+}
+
+static void frame_dump_write_wav_header(uint32_t data_size)
+{
+    unsigned char header[WAV_HEADER_SIZE];
+
+    memcpy(header + 0, "RIFF", 4);
+    put_u32(header + 4, 36 + data_size);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_u32(header + 16, 16);
+    put_u16(header + 20, 1);                /* PCM */
+    put_u16(header + 22, 2);                /* stereo */
+    put_u32(header + 24, l_frame_dump.audio_frequency);
+    put_u32(header + 28, l_frame_dump.audio_frequency * 4);
+    put_u16(header + 32, 4);
+    put_u16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    put_u32(header + 40, data_size);
+
+    frame_dump_write(l_frame_dump.audio, header, sizeof(header));
+}
+
+static void frame_dump_audio(const struct frame_dump_block* block)
+{
+    size_t i, count = block->size / 4;
+
+    if (!l_frame_dump.audio_header_written) {
+        if (l_frame_dump.audio_frequency == 0)
+            l_frame_dump.audio_frequency = 44100;
+
+        /* sizes are written once the dump is complete */
+        frame_dump_write_wav_header(0);
+        l_frame_dump.audio_header_written = 1;
+    }
+
+    if (block->size > l_frame_dump.samples_capacity) {
+        unsigned char* samples = realloc(l_frame_dump.samples, block->size);
+        if (samples == NULL)
+            return;
+        l_frame_dump.samples = samples;
+        l_frame_dump.samples_capacity = block->size;
+    }
+
+    /* AI samples are big endian, left channel first, in RDRAM words */
+    for (i = 0; i < count; ++i) {
+        uint32_t word;
+
+        memcpy(&word, block->data + 4 * i, 4);
+        put_u16(l_frame_dump.samples + 4 * i + 0, (uint16_t)(word >> 16));
+        put_u16(l_frame_dump.samples + 4 * i + 2, (uint16_t)word);
+    }
+
+    frame_dump_write(l_frame_dump.audio, l_frame_dump.samples, count * 4);
+    l_frame_dump.audio_bytes += count * 4;
+}
+
+static void frame_dump_process(const struct frame_dump_block* block)
+{
+    if (l_frame_dump.write_error)
+        return;
+
+    switch (block->type)
+    {
+    case DUMP_VIDEO:
+        frame_dump_video(block);
+        break;
+    case DUMP_VIDEO_REPEAT:
+        if (l_frame_dump.rgb != NULL)
+            frame_dump_write_frame();
+        break;
+    case DUMP_AUDIO:
+        frame_dump_audio(block);
+        break;
+    case DUMP_AUDIO_FORMAT:
+        if (l_frame_dump.audio_header_written && block->frequency != l_frame_dump.audio_frequency)
+            DebugMessage(M64MSG_WARNING, "Audio frequency changed to %u Hz, the dump keeps %u Hz",
+                         block->frequency, l_frame_dump.audio_frequency);
+        else if (!l_frame_dump.audio_header_written)
+            l_frame_dump.audio_frequency = block->frequency;
+        break;
+    }
+}
+
+static int frame_dump_thread(void* opaque)
+{
+    for (;;) {
+        struct frame_dump_block* block;
+
+        SDL_LockMutex(l_frame_dump.lock);
+        while (list_empty(&l_frame_dump.queue) && !l_frame_dump.quit)
+            SDL_CondWait(l_frame_dump.cond, l_frame_dump.lock);
+
+        if (list_empty(&l_frame_dump.queue)) {
+            SDL_UnlockMutex(l_frame_dump.lock);
+            break;
+        }
+
+        block = list_first_entry(&l_frame_dump.queue, struct frame_dump_block, list);
+        list_del(&block->list);
+        SDL_UnlockMutex(l_frame_dump.lock);
+
+        frame_dump_process(block);
+
+        SDL_LockMutex(l_frame_dump.lock);
+        l_frame_dump.queued -= block->size;
+        SDL_UnlockMutex(l_frame_dump.lock);
+
+        free(block);
+    }
+
+    return 0;
+}
+
+/*********************************************************************************************************
+* Emulation thread
+*/
+
+/* Returns NULL when the writer is too far behind */
+static struct frame_dump_block* frame_dump_alloc(uint32_t type, size_t size)
+{
+    struct frame_dump_block* block;
+
+    SDL_LockMutex(l_frame_dump.lock);
+    if (l_frame_dump.queued + size > l_frame_dump.budget) {
+        SDL_UnlockMutex(l_frame_dump.lock);
+        return NULL;
+    }
+    l_frame_dump.queued += size;
+    SDL_UnlockMutex(l_frame_dump.lock);
+
+    block = malloc(sizeof(*block) + size);
+    if (block == NULL) {
+        SDL_LockMutex(l_frame_dump.lock);
+        l_frame_dump.queued -= size;
+        SDL_UnlockMutex(l_frame_dump.lock);
+        return NULL;
+    }
+
+    memset(block, 0, sizeof(*block));
+    block->type = type;
+    block->size = size;
+    return block;
+}
+
+static void frame_dump_push(struct frame_dump_block* block)
+{
+    SDL_LockMutex(l_frame_dump.lock);
+    list_add_tail(&block->list, &l_frame_dump.queue);
+    SDL_CondSignal(l_frame_dump.cond);
+    SDL_UnlockMutex(l_frame_dump.lock);
+}
+
+static void frame_dump_set_format(void* aout, unsigned int frequency, unsigned int bits)
+{
+    struct frame_dump_block* block;
+
+    l_frame_dump.iaout->set_format(l_frame_dump.aout, frequency, bits);
+
+    block = frame_dump_alloc(DUMP_AUDIO_FORMAT, 0);
+    if (block != NULL) {
+        block->frequency = frequency;
+        frame_dump_push(block);
+    }
+}
+
+static void frame_dump_push_samples(void* aout, const void* samples, size_t size)
+{
+    struct frame_dump_block* block;
+
+    l_frame_dump.iaout->push_samples(l_frame_dump.aout, samples, size);
+
+    block = frame_dump_alloc(DUMP_AUDIO, size);
+    if (block == NULL) {
+        l_frame_dump.dropped_audio += size;
+        return;
+    }
+
+    memcpy(block->data, samples, size);
+    frame_dump_push(block);
+}
+
+static int frame_dump_get_queued_duration(void* aout, uint64_t* duration)
+{
+    if (l_frame_dump.iaout->get_queued_duration == NULL)
+        return 0;
+
+    return l_frame_dump.iaout->get_queued_duration(l_frame_dump.aout, duration);
+}
+
+static const struct audio_out_backend_interface l_iaudio_out_backend_frame_dump =
+{
+    frame_dump_set_format,
+    frame_dump_push_samples,
+    frame_dump_get_queued_duration
+};
+
+static void frame_dump_clear(void)
+{
+    free(l_frame_dump.video_path);
+    free(l_frame_dump.audio_path);
+    memset(&l_frame_dump, 0, sizeof(l_frame_dump));
+    INIT_LIST_HEAD(&l_frame_dump.queue);
+}
+
+m64p_error frame_dump_setup(const m64p_frame_dump_params* params)
+{
+    frame_dump_clear();
+
+    if (params == NULL)
+        return M64ERR_SUCCESS;
+
+    if ((params->video_path == NULL && params->audio_path == NULL)
+     || (params->format != M64DUMP_Y4M && params->format != M64DUMP_RAW))
+        return M64ERR_INPUT_INVALID;
+
+    l_frame_dump.video_path = frame_dump_strdup(params->video_path);
+    l_frame_dump.audio_path = frame_dump_strdup(params->audio_path);
+    if ((params->video_path != NULL && l_frame_dump.video_path == NULL)
+     || (params->audio_path != NULL && l_frame_dump.audio_path == NULL)) {
+        frame_dump_clear();
+        return M64ERR_NO_MEMORY;
+    }
+
+    l_frame_dump.format = params->format;
+    l_frame_dump.budget = (params->queue_size > 0) ? (size_t)params->queue_size * 1024 * 1024 : default_queue_budget;
+    l_frame_dump.armed = 1;
+
+    return M64ERR_SUCCESS;
+}
+
+int frame_dump_enabled(void)
+{
+    return l_frame_dump.thread != NULL;
+}
+
+static FILE* frame_dump_open(const char* path)
+{
+    FILE* f = fopen(path, "wb");
+
+    if (f == NULL) {
+        DebugMessage(M64MSG_ERROR, "Could not create frame dump file %s", path);
+        return NULL;
+    }
+
+    setvbuf(f, NULL, _IOFBF, FRAME_DUMP_FILE_BUFFER);
+    return f;
+}
+
+static void frame_dump_close_files(void)
+{
+    if (l_frame_dump.video != NULL)
+        fclose(l_frame_dump.video);
+    if (l_frame_dump.audio != NULL)
+        fclose(l_frame_dump.audio);
+
+    l_frame_dump.video = NULL;
+    l_frame_dump.audio = NULL;
+}
+
+void frame_dump_start(unsigned int vi_rate, void** aout, const struct audio_out_backend_interface** iaout)
+{
+    if (!l_frame_dump.armed)
+        return;
+
+    /* one run per setup */
+    l_frame_dump.armed = 0;
+    l_frame_dump.vi_rate = vi_rate;
+
+    if ((l_frame_dump.video_path != NULL && (l_frame_dump.video = frame_dump_open(l_frame_dump.video_path)) == NULL)
+     || (l_frame_dump.audio_path != NULL && (l_frame_dump.audio = frame_dump_open(l_frame_dump.audio_path)) == NULL)) {
+        frame_dump_close_files();
+        return;
+    }
+
+    l_frame_dump.lock = SDL_CreateMutex();
+    l_frame_dump.cond = SDL_CreateCond();
+    if (l_frame_dump.lock != NULL && l_frame_dump.cond != NULL)
+        l_frame_dump.thread = SDL_CreateThread(frame_dump_thread, "m64pDump", NULL);
+
+    if (l_frame_dump.thread == NULL) {
+        DebugMessage(M64MSG_ERROR, "Could not start frame dump thread");
+        frame_dump_finish();
+        return;
+    }
+
+    if (l_frame_dump.audio != NULL) {
+        l_frame_dump.aout = *aout;
+        l_frame_dump.iaout = *iaout;
+        *aout = &l_frame_dump;
+        *iaout = &l_iaudio_out_backend_frame_dump;
+    }
+}
+
+void frame_dump_new_vi(void)
+{
+    struct frame_dump_block* block = NULL;
+    const unsigned char* frame;
+    unsigned int width, height;
+    int w = 0, h = 0;
+
+    if (l_frame_dump.video == NULL)
+        return;
+
+    frame = main_scanout_frame(&width, &height);
+    if (frame == NULL) {
+        gfx.readScreen(NULL, &w, &h, 1);
+        width = (w > 0 && h > 0) ? (unsigned int)w : 0;
+        height = (w > 0 && h > 0) ? (unsigned int)h : 0;
+    }
+
+    if (width != 0)
+        block = frame_dump_alloc(DUMP_VIDEO, (size_t)width * height * 3);
+
+    if (block != NULL) {
+        block->width = width;
+        block->height = height;
+
+        if (frame != NULL) {
+            memcpy(block->data, frame, block->size);
+        }
+        else {
+            gfx.readScreen(block->data, &w, &h, 1);
+            block->flags = M64P_FRAME_BOTTOM_UP;
+        }
+    }
+    else {
+        /* keep the frame rate */
+        if (width != 0)
+            l_frame_dump.dropped_frames++;
+
+        block = frame_dump_alloc(DUMP_VIDEO_REPEAT, 0);
+        if (block == NULL)
+            return;
+    }
+
+    l_frame_dump.frames++;
+    frame_dump_push(block);
+}
+
+void frame_dump_finish(void)
+{
+    if (l_frame_dump.thread != NULL) {
+        SDL_LockMutex(l_frame_dump.lock);
+        l_frame_dump.quit = 1;
+        SDL_CondSignal(l_frame_dump.cond);
+        SDL_UnlockMutex(l_frame_dump.lock);
+        SDL_WaitThread(l_frame_dump.thread, NULL);
+        l_frame_dump.thread = NULL;
+
+        DebugMessage(M64MSG_INFO, "Frame dump: %u frames (%u dropped), %u audio bytes dropped",
+                     l_frame_dump.frames, l_frame_dump.dropped_frames, (unsigned int)l_frame_dump.dropped_audio);
+    }
+
+    /* RIFF sizes are limited to 32 bits */
+    if (l_frame_dump.audio != NULL && l_frame_dump.audio_header_written && !l_frame_dump.write_error
+     && fseek(l_frame_dump.audio, 0, SEEK_SET) == 0) {
+        uint64_t size = l_frame_dump.audio_bytes;
+        frame_dump_write_wav_header((size > UINT32_C(0xffffffff) - 36) ? UINT32_C(0xffffffff) - 36 : (uint32_t)size);
+    }
+
+    frame_dump_close_files();
+
+    if (l_frame_dump.cond != NULL)
+        SDL_DestroyCond(l_frame_dump.cond);
+    if (l_frame_dump.lock != NULL)
+        SDL_DestroyMutex(l_frame_dump.lock);
+
+    free(l_frame_dump.rgb);
+    free(l_frame_dump.out);
+    free(l_frame_dump.samples);
+
+    l_frame_dump.cond = NULL;
+    l_frame_dump.lock = NULL;
+    l_frame_dump.rgb = NULL;
+    l_frame_dump.out = NULL;
+    l_frame_dump.samples = NULL;
+    l_frame_dump.samples_capacity = 0;
+    l_frame_dump.aout = NULL;
+    l_frame_dump.iaout = NULL;
+}
@@ -0,0 +1,53 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_dump.h                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_FRAME_DUMP_H
+#define M64P_MAIN_FRAME_DUMP_H
+
+#include "api/m64p_types.h"
+
+struct audio_out_backend_interface;
+
+/* Dumps the frame displayed on each VI to a Y4M (YUV 4:4:4) or raw RGB24
+ * stream, and the AI samples to a WAV file.
+ *
+ * The emulation thread only copies frames and samples into a queue, a writer
+ * thread converts and writes them. When the queue is full, frames are dropped
+ * (the previous frame is repeated to keep the frame rate) and so are samples.
+ * The video size is the size of the first frame, later frames are cropped
+ * or padded with black.
+ */
+
+/* Arm dumping for the next run (NULL disarms it) */
+m64p_error frame_dump_setup(const m64p_frame_dump_params* params);
+int frame_dump_enabled(void);
+
+/* Called before the emulation starts: opens the files, starts the writer
+ * and inserts the audio tap in front of the given audio out backend. */
+void frame_dump_start(unsigned int vi_rate, void** aout, const struct audio_out_backend_interface** iaout);
+
+void frame_dump_new_vi(void);
+
+/* Called when the emulation ends: writes what is queued and closes the files */
+void frame_dump_finish(void);
+
+#endif /* M64P_MAIN_FRAME_DUMP_H */
@@ -0,0 +1,272 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_export.c                                          *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "frame_export.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "main/main.h"
+#include "plugin/plugin.h"
+
+#if !defined(WIN32)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* slots are page aligned so that consumers can map them on their own */
+enum { FRAME_EXPORT_ALIGN = 4096 };
+
+struct frame_export_globals {
+    char *name;
+    unsigned char *mem;
+    size_t size;
+
+    m64p_frame_export_header *header;
+    size_t pixels_capacity;
+
+    uint32_t frame;             /* last exported frame number */
+    uint32_t vi;
+    m64p_frame_slot *current;   /* slot being written, NULL if none */
+};
+
+static struct frame_export_globals l_frame_export;
+
+static size_t frame_export_align(size_t size)
+{
+    return (size + FRAME_EXPORT_ALIGN - 1) & ~(size_t)(FRAME_EXPORT_ALIGN - 1);
+}
+
+static m64p_frame_slot *frame_export_slot(uint32_t frame)
+{
+    const m64p_frame_export_header *header = l_frame_export.header;
+
+    return (m64p_frame_slot*)(l_frame_export.mem + header->slots_offset
+        + (size_t)((frame - 1) % header->slot_count) * header->slot_size);
+}
+
+m64p_error frame_export_setup(const m64p_frame_export_params* params)
+{
+    size_t slot_size;
+    size_t slots_offset = frame_export_align(sizeof(m64p_frame_export_header));
+    m64p_frame_export_header *header;
+    int fd;
+
+    frame_export_release();
+
+    if (params == NULL)
+        return M64ERR_SUCCESS;
+
+    if (params->name == NULL || params->slot_count == 0
+     || params->max_width == 0 || params->max_height == 0
+     || params->max_width > 4096 || params->max_height > 4096)
+        return M64ERR_INPUT_INVALID;
+
+    l_frame_export.pixels_capacity = (size_t)params->max_width * params->max_height * 3;
+    slot_size = frame_export_align(sizeof(m64p_frame_slot) + l_frame_export.pixels_capacity);
+    l_frame_export.size = slots_offset + params->slot_count * slot_size;
+
+    l_frame_export.name = malloc(strlen(params->name) + 1);
+    if (l_frame_export.name == NULL)
+        return M64ERR_NO_MEMORY;
+    strcpy(l_frame_export.name, params->name);
+
+    fd = shm_open(params->name, O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0) {
+        DebugMessage(M64MSG_ERROR, "Could not create shared memory %s: %s", params->name, strerror(errno));
+        free(l_frame_export.name);
+        memset(&l_frame_export, 0, sizeof(l_frame_export));
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    if (ftruncate(fd, (off_t)l_frame_export.size) != 0
+     || (l_frame_export.mem = mmap(NULL, l_frame_export.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        DebugMessage(M64MSG_ERROR, "Could not map shared memory %s: %s", params->name, strerror(errno));
+        close(fd);
+        shm_unlink(params->name);
+        free(l_frame_export.name);
+        memset(&l_frame_export, 0, sizeof(l_frame_export));
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    /* the mapping stays valid without the descriptor */
+    close(fd);
+
+    header = (m64p_frame_export_header*)l_frame_export.mem;
+    header->version = M64P_FRAME_EXPORT_VERSION;
+    header->slot_count = params->slot_count;
+    header->slot_size = (uint32_t)slot_size;
+    header->slots_offset = (uint32_t)slots_offset;
+    header->max_width = params->max_width;
+    header->max_height = params->max_height;
+    header->latest = 0;
+    /* magic last, so that consumers polling for it see a complete header */
+    __atomic_store_n(&header->magic, M64P_FRAME_EXPORT_MAGIC, __ATOMIC_RELEASE);
+
+    l_frame_export.header = header;
+
+    DebugMessage(M64MSG_INFO, "Exporting frames to shared memory %s (%u slots of %ux%u)",
+                 params->name, params->slot_count, params->max_width, params->max_height);
+
+    return M64ERR_SUCCESS;
+}
+
+void frame_export_release(void)
+{
+    if (l_frame_export.mem != NULL)
+        shm_unlink(l_frame_export.name);
+
+    frame_export_fork_child();
+}
+
+void frame_export_fork_child(void)
+{
+    if (l_frame_export.mem != NULL)
+        munmap(l_frame_export.mem, l_frame_export.size);
+
+    free(l_frame_export.name);
+    memset(&l_frame_export, 0, sizeof(l_frame_export));
+}
+
+int frame_export_enabled(void)
+{
+    return l_frame_export.header != NULL;
+}
+
+uint8_t* frame_export_acquire(size_t* capacity)
+{
+    m64p_frame_slot *slot;
+
+    if (l_frame_export.header == NULL)
+        return NULL;
+
+    slot = frame_export_slot(l_frame_export.frame + 1);
+
+    /* odd sequence: consumers of this slot retry or skip it */
+    if (l_frame_export.current != slot) {
+        __atomic_store_n(&slot->sequence, slot->sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        l_frame_export.current = slot;
+    }
+
+    *capacity = l_frame_export.pixels_capacity;
+    return (uint8_t*)(slot + 1);
+}
+
+void frame_export_commit(unsigned int width, unsigned int height, unsigned int pitch, unsigned int flags)
+{
+    m64p_frame_slot *slot = l_frame_export.current;
+
+    if (slot == NULL)
+        return;
+
+    ++l_frame_export.frame;
+
+    slot->frame = l_frame_export.frame;
+    slot->vi = l_frame_export.vi;
+    slot->width = width;
+    slot->height = height;
+    slot->pitch = pitch;
+    slot->flags = flags;
+
+    __atomic_store_n(&slot->sequence, slot->sequence + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&l_frame_export.header->latest, l_frame_export.frame, __ATOMIC_RELEASE);
+
+    l_frame_export.current = NULL;
+}
+
+void frame_export_new_vi(void)
+{
+    uint8_t *pixels;
+    const uint8_t *frame;
+    size_t capacity;
+    int width = 0, height = 0;
+    unsigned int scanout_width, scanout_height;
+
+    if (l_frame_export.header == NULL)
+        return;
+
+    ++l_frame_export.vi;
+
+    frame = main_scanout_frame(&scanout_width, &scanout_height);
+    if (frame != NULL) {
+        if (scanout_width > l_frame_export.header->max_width
+         || scanout_height > l_frame_export.header->max_height)
+            return;
+
+        pixels = frame_export_acquire(&capacity);
+        memcpy(pixels, frame, (size_t)scanout_width * scanout_height * 3);
+        frame_export_commit(scanout_width, scanout_height, scanout_width * 3, 0);
+        return;
+    }
+
+    gfx.readScreen(NULL, &width, &height, 1);
+    if (width <= 0 || height <= 0
+     || (unsigned int)width > l_frame_export.header->max_width
+     || (unsigned int)height > l_frame_export.header->max_height)
+        return;
+
+    /* the video plugin writes straight into the shared memory */
+    pixels = frame_export_acquire(&capacity);
+    gfx.readScreen(pixels, &width, &height, 1);
+
+    frame_export_commit((unsigned int)width, (unsigned int)height, (unsigned int)width * 3, M64P_FRAME_BOTTOM_UP);
+}
+
+#else
+
+m64p_error frame_export_setup(const m64p_frame_export_params* params)
+{
+    return (params == NULL) ? M64ERR_SUCCESS : M64ERR_UNSUPPORTED;
+}
+
+void frame_export_release(void)
+{
+}
+
+void frame_export_fork_child(void)
+{
+}
+
+int frame_export_enabled(void)
+{
+    return 0;
+}
+
+uint8_t* frame_export_acquire(size_t* capacity)
+{
+    return NULL;
+}
+
+void frame_export_commit(unsigned int width, unsigned int height, unsigned int pitch, unsigned int flags)
+{
+}
+
+void frame_export_new_vi(void)
+{
+}
+
+#endif
@@ -0,0 +1,56 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_export.h                                          *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_FRAME_EXPORT_H
+#define M64P_MAIN_FRAME_EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "api/m64p_types.h"
+
+/* Exports frames to a ring of slots in a named shared memory object.
+ *
+ * The emulation thread never waits for consumers: each slot is protected
+ * by a sequence counter (seqlock), consumers check that it was even and
+ * unchanged around their read, and retry or skip the frame otherwise.
+ * Only available on POSIX systems.
+ */
+
+/* NULL params releases the export */
+m64p_error frame_export_setup(const m64p_frame_export_params* params);
+void frame_export_release(void);
+
+/* Stop exporting without removing the shared memory (the parent keeps exporting) */
+void frame_export_fork_child(void);
+int frame_export_enabled(void);
+
+/* Pixels of the next slot to fill (NULL if export is disabled),
+ * then publish them. */
+uint8_t* frame_export_acquire(size_t* capacity);
+void frame_export_commit(unsigned int width, unsigned int height, unsigned int pitch, unsigned int flags);
+
+/* Called on each VI, exports the software scanout frame if any,
+ * the front buffer of the video plugin otherwise */
+void frame_export_new_vi(void);
+
+#endif /* M64P_MAIN_FRAME_EXPORT_H */
@@ -0,0 +1,349 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_hash.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "frame_hash.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#include "api/callbacks.h"
+#include "main/main.h"
+#include "plugin/plugin.h"
+
+#define FRAME_HASH_MAGIC   0x4834364D /* "M64H" */
+#define FRAME_HASH_VERSION 1
+
+enum { FRAME_HASH_HEADER_SIZE = 16 };
+
+enum frame_hash_source
+{
+    FRAME_HASH_SOURCE_PLUGIN = 0,
+    FRAME_HASH_SOURCE_SCANOUT = 1
+};
+
+struct frame_hash_globals {
+    int enabled;
+    int stop_on_mismatch;
+    FILE *log;
+    FILE *golden;
+    uint32_t golden_source;
+    int source_checked;
+
+    /* frames read from the video plugin */
+    unsigned char *pixels;
+    size_t capacity;
+
+    m64p_frame_hash_result result;
+};
+
+static struct frame_hash_globals l_frame_hash = { 0, 0, NULL, NULL, 0, 0, NULL, 0, { 0, 0, -1, 0, 0, 0 } };
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >>  0);
+    p[1] = (unsigned char)(v >>  8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+    return ((uint32_t)p[0] <<  0)
+         | ((uint32_t)p[1] <<  8)
+         | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+static void put_u64(unsigned char* p, uint64_t v)
+{
+    put_u32(p + 0, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t get_u64(const unsigned char* p)
+{
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static unsigned int frame_hash_source(void)
+{
+    unsigned int width, height;
+
+    return (main_scanout_frame(&width, &height) != NULL)
+        ? FRAME_HASH_SOURCE_SCANOUT
+        : FRAME_HASH_SOURCE_PLUGIN;
+}
+
+static void frame_hash_close(void)
+{
+    if (l_frame_hash.log != NULL)
+        fclose(l_frame_hash.log);
+    if (l_frame_hash.golden != NULL)
+        fclose(l_frame_hash.golden);
+
+    free(l_frame_hash.pixels);
+
+    l_frame_hash.enabled = 0;
+    l_frame_hash.log = NULL;
+    l_frame_hash.golden = NULL;
+    l_frame_hash.pixels = NULL;
+    l_frame_hash.capacity = 0;
+}
+
+m64p_error frame_hash_setup(const m64p_frame_hash_params* params)
+{
+    unsigned char header[FRAME_HASH_HEADER_SIZE];
+    unsigned int golden_vis = 0;
+    long size;
+
+    frame_hash_close();
+
+    if (params == NULL)
+        return M64ERR_SUCCESS;
+
+    if (params->log_path == NULL && params->golden_path == NULL)
+        return M64ERR_INPUT_INVALID;
+
+    if (params->golden_path != NULL) {
+        l_frame_hash.golden = fopen(params->golden_path, "rb");
+        if (l_frame_hash.golden == NULL) {
+            DebugMessage(M64MSG_ERROR, "Could not open golden frame hash log %s", params->golden_path);
+            return M64ERR_FILES;
+        }
+
+        if (fread(header, 1, sizeof(header), l_frame_hash.golden) != sizeof(header)
+         || get_u32(header + 0) != FRAME_HASH_MAGIC
+         || get_u32(header + 4) > FRAME_HASH_VERSION) {
+            DebugMessage(M64MSG_ERROR, "%s is not a frame hash log", params->golden_path);
+            frame_hash_close();
+            return M64ERR_INPUT_INVALID;
+        }
+
+        l_frame_hash.golden_source = get_u32(header + 8);
+
+        /* one record per VI after the header */
+        if (fseek(l_frame_hash.golden, 0, SEEK_END) != 0
+         || (size = ftell(l_frame_hash.golden)) < FRAME_HASH_HEADER_SIZE
+         || fseek(l_frame_hash.golden, FRAME_HASH_HEADER_SIZE, SEEK_SET) != 0) {
+            DebugMessage(M64MSG_ERROR, "Could not read golden frame hash log %s", params->golden_path);
+            frame_hash_close();
+            return M64ERR_FILES;
+        }
+        golden_vis = (unsigned int)((size - FRAME_HASH_HEADER_SIZE) / 8);
+    }
+
+    if (params->log_path != NULL) {
+        l_frame_hash.log = fopen(params->log_path, "wb");
+        if (l_frame_hash.log == NULL) {
+            DebugMessage(M64MSG_ERROR, "Could not create frame hash log %s", params->log_path);
+            frame_hash_close();
+            return M64ERR_FILES;
+        }
+    }
+
+    memset(&l_frame_hash.result, 0, sizeof(l_frame_hash.result));
+    l_frame_hash.result.first_mismatch = -1;
+    l_frame_hash.result.golden_vis = golden_vis;
+    l_frame_hash.stop_on_mismatch = params->stop_on_mismatch;
+    l_frame_hash.source_checked = 0;
+    l_frame_hash.enabled = 1;
+
+    return M64ERR_SUCCESS;
+}
+
+int frame_hash_enabled(void)
+{
+    return l_frame_hash.enabled;
+}
+
+/* Hash the displayed frame, seeded with its size. */
+static uint64_t frame_hash_compute(void)
+{
+    const unsigned char *frame;
+    unsigned int width, height;
+    int w = 0, h = 0;
+    size_t size;
+
+    frame = main_scanout_frame(&width, &height);
+    if (frame == NULL) {
+        gfx.readScreen(NULL, &w, &h, 1);
+        if (w <= 0 || h <= 0)
+            return 0;
+
+        size = (size_t)w * h * 3;
+        if (size > l_frame_hash.capacity) {
+            unsigned char *pixels = realloc(l_frame_hash.pixels, size);
+            if (pixels == NULL)
+                return 0;
+            l_frame_hash.pixels = pixels;
+            l_frame_hash.capacity = size;
+        }
+
+        gfx.readScreen(l_frame_hash.pixels, &w, &h, 1);
+        frame = l_frame_hash.pixels;
+        width = (unsigned int)w;
+        height = (unsigned int)h;
+    }
+
+    if (width == 0 || height == 0)
+        return 0;
+
+    return XXH3_64bits_withSeed(frame, (size_t)width * height * 3, ((uint64_t)width << 32) | height);
+}
+
+/* Returns 1 on the first mismatch */
+static int frame_hash_compare(uint64_t hash)
+{
+    unsigned char record[8];
+    uint64_t expected;
+
+    if (!l_frame_hash.source_checked) {
+        l_frame_hash.source_checked = 1;
+
+        if (l_frame_hash.golden_source != frame_hash_source())
+            DebugMessage(M64MSG_WARNING, "Golden frame hash log was made from another frame source");
+    }
+
+    if (fread(record, 1, sizeof(record), l_frame_hash.golden) != sizeof(record)) {
+        /* past the end of the golden log */
+        fclose(l_frame_hash.golden);
+        l_frame_hash.golden = NULL;
+        return 0;
+    }
+
+    expected = get_u64(record);
+    l_frame_hash.result.compared++;
+
+    if (expected == hash || l_frame_hash.result.first_mismatch >= 0)
+        return 0;
+
+    l_frame_hash.result.first_mismatch = (int)l_frame_hash.result.vis;
+    l_frame_hash.result.expected_hash = expected;
+    l_frame_hash.result.actual_hash = hash;
+
+    DebugMessage(M64MSG_ERROR, "Frame hash mismatch at VI %u: expected %016llx, got %016llx",
+                 l_frame_hash.result.vis, (unsigned long long)expected, (unsigned long long)hash);
+    return 1;
+}
+
+int frame_hash_new_vi(void)
+{
+    unsigned char record[8];
+    uint64_t hash;
+    int mismatch = 0;
+
+    if (!l_frame_hash.enabled)
+        return 0;
+
+    hash = frame_hash_compute();
+
+    if (l_frame_hash.log != NULL) {
+        /* the frame source is only known once the emulation runs */
+        if (l_frame_hash.result.vis == 0) {
+            unsigned char header[FRAME_HASH_HEADER_SIZE];
+
+            put_u32(header + 0, FRAME_HASH_MAGIC);
+            put_u32(header + 4, FRAME_HASH_VERSION);
+            put_u32(header + 8, frame_hash_source());
+            put_u32(header + 12, 0);
+            fwrite(header, 1, sizeof(header), l_frame_hash.log);
+        }
+
+        put_u64(record, hash);
+        if (fwrite(record, 1, sizeof(record), l_frame_hash.log) != sizeof(record)) {
+            DebugMessage(M64MSG_ERROR, "Could not write frame hash log, logging stopped");
+            fclose(l_frame_hash.log);
+            l_frame_hash.log = NULL;
+        }
+    }
+
+    if (l_frame_hash.golden != NULL)
+        mismatch = frame_hash_compare(hash);
+
+    l_frame_hash.result.vis++;
+
+    return mismatch && l_frame_hash.stop_on_mismatch;
+}
+
+void frame_hash_flush(void)
+{
+    if (l_frame_hash.log != NULL)
+        fflush(l_frame_hash.log);
+}
+
+void frame_hash_fork_child(void)
+{
+    /* buffers were flushed before forking, closing doesn't write anything */
+    frame_hash_close();
+}
+
+/* A run shorter than the golden one doesn't match it either */
+static void frame_hash_check_leftover(void)
+{
+    unsigned char record[8];
+    m64p_frame_hash_result* result = &l_frame_hash.result;
+
+    if (l_frame_hash.golden == NULL || result->first_mismatch >= 0
+     || fread(record, 1, sizeof(record), l_frame_hash.golden) != sizeof(record))
+        return;
+
+    result->first_mismatch = (int)result->vis;
+    result->expected_hash = get_u64(record);
+    result->actual_hash = 0;
+
+    DebugMessage(M64MSG_ERROR, "Frame hash mismatch: run ended at VI %u, golden log has %u VIs",
+                 result->vis, result->golden_vis);
+}
+
+void frame_hash_finish(void)
+{
+    const m64p_frame_hash_result* result = &l_frame_hash.result;
+
+    if (!l_frame_hash.enabled)
+        return;
+
+    if (l_frame_hash.log != NULL && fclose(l_frame_hash.log) != 0)
+        DebugMessage(M64MSG_ERROR, "Could not write frame hash log");
+    l_frame_hash.log = NULL;
+
+    frame_hash_check_leftover();
+
+    if (result->first_mismatch >= 0)
+        DebugMessage(M64MSG_INFO, "Frame hashes: %u VIs, %u compared, first mismatch at VI %d",
+                     result->vis, result->compared, result->first_mismatch);
+    else if (result->compared > 0 || l_frame_hash.golden != NULL)
+        DebugMessage(M64MSG_INFO, "Frame hashes: %u VIs, %u compared, all matching", result->vis, result->compared);
+    else
+        DebugMessage(M64MSG_INFO, "Frame hashes: %u VIs", result->vis);
+
+    frame_hash_close();
+}
+
+void frame_hash_get_result(m64p_frame_hash_result* result)
+{
+    *result = l_frame_hash.result;
+}
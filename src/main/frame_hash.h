@@ -0,0 +1,56 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_hash.h                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_FRAME_HASH_H
+#define M64P_MAIN_FRAME_HASH_H
+
+#include "api/m64p_types.h"
+
+/* Hashes the frame displayed on each VI (XXH3), streams the hashes to a log
+ * and/or compares them against a golden log made by a previous run.
+ *
+ * Log layout (all integers are little endian):
+ *   header: "M64H" magic, u32 version, u32 frame source, u32 reserved
+ *   one u64 hash per VI, 0 for VIs without picture
+ *
+ * Frames come from the software scanout when it is enabled, from the video
+ * plugin otherwise, so logs can only be compared for the same source and
+ * video plugin.
+ */
+
+/* Arm hashing for the next run (NULL disarms it) */
+m64p_error frame_hash_setup(const m64p_frame_hash_params* params);
+int frame_hash_enabled(void);
+
+/* Returns 1 when the emulation should stop on a mismatch */
+int frame_hash_new_vi(void);
+
+/* Write buffered hashes before forking, stop hashing in forked children */
+void frame_hash_flush(void);
+void frame_hash_fork_child(void);
+
+/* Called when the emulation ends: closes the logs and reports the result */
+void frame_hash_finish(void);
+
+void frame_hash_get_result(m64p_frame_hash_result* result);
+
+#endif /* M64P_MAIN_FRAME_HASH_H */
@@ -0,0 +1,197 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_pacer.c                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "frame_pacer.h"
+
+#include <SDL.h>
+#include <string.h>
+
+#include "backends/api/audio_out_backend.h"
+#include "backends/api/clock_backend.h"
+
+#define NS_PER_MS UINT64_C(1000000)
+
+/* don't try to catch up after being that late (pause, loading, host stall) */
+static const uint64_t max_lateness = 50 * NS_PER_MS;
+
+static const uint64_t min_sleep_margin = 200000;
+static const uint64_t max_sleep_margin = 4 * NS_PER_MS;
+
+static const uint64_t histogram_base = 32000;
+
+/* maximum frame duration adjustment for audio sync (1/200 = 0.5%) */
+static const uint64_t audio_max_adjust_div = 200;
+
+static uint64_t frame_pacer_now(const struct frame_pacer* pacer)
+{
+    return pacer->iclock->get_time_ns(pacer->clock);
+}
+
+static void frame_pacer_record(struct frame_pacer* pacer, uint64_t frame_time)
+{
+    uint64_t error = (frame_time > pacer->period)
+        ? frame_time - pacer->period
+        : pacer->period - frame_time;
+    unsigned int bin = 0;
+
+    while (bin < M64P_PACING_HISTOGRAM_BINS - 1 && error >= (histogram_base << bin))
+        ++bin;
+
+    pacer->stats.jitter_histogram[bin]++;
+}
+
+static void frame_pacer_sleep_until(struct frame_pacer* pacer, uint64_t deadline)
+{
+    uint64_t now = frame_pacer_now(pacer);
+
+    /* coarse sleep, leaving enough time to absorb the scheduler wake-up latency */
+    while (now + pacer->sleep_margin + NS_PER_MS <= deadline) {
+        Uint32 ms = (Uint32)((deadline - now - pacer->sleep_margin) / NS_PER_MS);
+        uint64_t before = now;
+        uint64_t overshoot;
+
+        SDL_Delay(ms);
+        now = frame_pacer_now(pacer);
+
+        overshoot = (now - before > ms * NS_PER_MS) ? now - before - ms * NS_PER_MS : 0;
+
+        /* grow immediately, shrink slowly */
+        if (overshoot > pacer->sleep_margin)
+            pacer->sleep_margin = overshoot;
+        else
+            pacer->sleep_margin = (pacer->sleep_margin * 7 + overshoot) / 8;
+
+        if (pacer->sleep_margin < min_sleep_margin)
+            pacer->sleep_margin = min_sleep_margin;
+        if (pacer->sleep_margin > max_sleep_margin)
+            pacer->sleep_margin = max_sleep_margin;
+    }
+
+    /* precise part */
+    while (now < deadline)
+        now = frame_pacer_now(pacer);
+}
+
+/* Returns the duration of the current frame, stretched or shrunk a bit
+ * to bring the audio queue toward the target latency. */
+static uint64_t frame_pacer_audio_period(struct frame_pacer* pacer, uint64_t period)
+{
+    uint64_t latency, max_adjust, adjust;
+
+    if (pacer->audio_target == 0
+     || !pacer->iaout->get_queued_duration(pacer->aout, &latency))
+        return period;
+
+    pacer->stats.audio_latency_us = (unsigned int)(latency / 1000);
+
+    if (latency == 0) {
+        /* the queue is empty until the first samples are played */
+        if (pacer->audio_started)
+            pacer->stats.audio_underruns++;
+    }
+    else {
+        pacer->audio_started = 1;
+    }
+
+    if (latency > 2 * pacer->audio_target)
+        pacer->stats.audio_overruns++;
+
+    /* proportional to the latency error, saturating at one target of error */
+    max_adjust = period / audio_max_adjust_div;
+
+    if (latency > pacer->audio_target) {
+        adjust = (latency - pacer->audio_target >= pacer->audio_target)
+            ? max_adjust
+            : max_adjust * (latency - pacer->audio_target) / pacer->audio_target;
+        return period + adjust;
+    }
+    else {
+        adjust = max_adjust * (pacer->audio_target - latency) / pacer->audio_target;
+        return period - adjust;
+    }
+}
+
+void frame_pacer_init(struct frame_pacer* pacer, void* clock, const struct clock_backend_interface* iclock)
+{
+    memset(pacer, 0, sizeof(*pacer));
+
+    pacer->clock = clock;
+    pacer->iclock = iclock;
+    pacer->sleep_margin = NS_PER_MS;
+}
+
+void frame_pacer_set_audio(struct frame_pacer* pacer, void* aout, const struct audio_out_backend_interface* iaout,
+                           uint64_t target)
+{
+    pacer->aout = aout;
+    pacer->iaout = iaout;
+    pacer->audio_started = 0;
+    pacer->audio_target = (iaout != NULL && iaout->get_queued_duration != NULL) ? target : 0;
+}
+
+void frame_pacer_reset(struct frame_pacer* pacer)
+{
+    pacer->deadline = 0;
+}
+
+void frame_pacer_wait(struct frame_pacer* pacer, uint64_t period, int limit)
+{
+    uint64_t now;
+
+    if (!limit) {
+        pacer->deadline = 0;
+        return;
+    }
+
+    now = frame_pacer_now(pacer);
+    pacer->stats.frames++;
+
+    if (pacer->deadline == 0 || period != pacer->period) {
+        pacer->stats.resyncs++;
+        pacer->stats.drift_ns = 0;
+        pacer->period = period;
+        pacer->last_frame = now;
+        pacer->deadline = now + period;
+        return;
+    }
+
+    pacer->stats.drift_ns = (long long)(now - pacer->deadline);
+
+    if (now >= pacer->deadline) {
+        pacer->stats.late_frames++;
+
+        if (now - pacer->deadline > max_lateness) {
+            pacer->stats.resyncs++;
+            pacer->last_frame = now;
+            pacer->deadline = now + period;
+            return;
+        }
+    }
+    else {
+        frame_pacer_sleep_until(pacer, pacer->deadline);
+        now = frame_pacer_now(pacer);
+    }
+
+    frame_pacer_record(pacer, now - pacer->last_frame);
+
+    pacer->last_frame = now;
+    pacer->deadline += frame_pacer_audio_period(pacer, period);
+}
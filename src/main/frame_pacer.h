@@ -0,0 +1,70 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - frame_pacer.h                                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_FRAME_PACER_H
+#define M64P_MAIN_FRAME_PACER_H
+
+#include <stdint.h>
+
+#include "api/m64p_types.h"
+
+struct audio_out_backend_interface;
+struct clock_backend_interface;
+
+/* Paces frames on absolute deadlines (so that sleep errors don't accumulate).
+ * Waiting sleeps until shortly before the deadline, then spins on the clock.
+ * The spin margin adapts to the observed sleep overshoot.
+ */
+struct frame_pacer
+{
+    void* clock;
+    const struct clock_backend_interface* iclock;
+
+    uint64_t period;        /* target frame duration (ns) */
+    uint64_t deadline;      /* end of the current frame (ns), 0 if not scheduled */
+    uint64_t last_frame;    /* start of the current frame (ns) */
+    uint64_t sleep_margin;  /* time left to spin after sleeping (ns) */
+
+    /* audio sync: frame duration is adjusted to keep the audio queue
+     * of the backend around the target latency */
+    void* aout;
+    const struct audio_out_backend_interface* iaout;
+    uint64_t audio_target;          /* target latency (ns), 0 if disabled */
+    int audio_started;
+
+    m64p_pacing_stats stats;
+};
+
+void frame_pacer_init(struct frame_pacer* pacer, void* clock, const struct clock_backend_interface* iclock);
+
+/* Pace on the audio queue of the backend instead of the clock alone.
+ * A target of 0 disables audio sync. */
+void frame_pacer_set_audio(struct frame_pacer* pacer, void* aout, const struct audio_out_backend_interface* iaout,
+                           uint64_t target);
+
+/* Drop the current schedule, the next frame starts a new one */
+void frame_pacer_reset(struct frame_pacer* pacer);
+
+/* Wait for the end of the current frame. If limit is 0, only keeps track
+ * of time without waiting. */
+void frame_pacer_wait(struct frame_pacer* pacer, uint64_t period, int limit);
+
+#endif /* M64P_MAIN_FRAME_PACER_H */
@@ -80,6 +80,20 @@ static osal_inline int list_empty(const struct list_head *head)
     return (head->next == head);
 }
 
+/* Moves all entries of list to the end of head, leaving list empty */
+static osal_inline void list_splice_tail_init(struct list_head *list, struct list_head *head)
+{
+    if (list_empty(list))
+        return;
+
+    list->next->prev = head->prev;
+    head->prev->next = list->next;
+    list->prev->next = head;
+    head->prev = list->prev;
+
+    INIT_LIST_HEAD(list);
+}
+
 #ifdef __GNUC__
 
 #define container_of(ptr, type, member) __extension__ ({ \
@@ -35,6 +35,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define M64P_CORE_PROTOTYPES 1
 #include "api/callbacks.h"
@@ -52,7 +53,11 @@
 #include "backends/api/storage_backend.h"
 #include "backends/api/video_capture_backend.h"
 #include "backends/plugins_compat/plugins_compat.h"
+#include "backends/audio_out_resampler.h"
+#include "backends/audio_out_ring.h"
 #include "backends/clock_ctime_plus_delta.h"
+#include "backends/clock_monotonic.h"
+#include "backends/clock_virtual.h"
 #include "backends/file_storage.h"
 #include "cheat.h"
 #include "device/device.h"
@@ -63,19 +68,27 @@
 #include "device/controllers/paks/transferpak.h"
 #include "device/gb/gb_cart.h"
 #include "device/pif/bootrom_hle.h"
+#include "device/rcp/vi/vi_scanout.h"
+#include "batch.h"
 #include "eventloop.h"
+#include "frame_pacer.h"
+#include "fork_server.h"
+#include "frame_export.h"
+#include "frame_dump.h"
+#include "frame_hash.h"
 #include "main.h"
+#include "movie.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "plugin/plugin.h"
-#if defined(PROFILE)
 #include "profile.h"
-#endif
+#include "rewind.h"
 #include "rom.h"
 #include "savestates.h"
 #include "screenshot.h"
 #include "util.h"
+#include "workqueue.h"
 #include "netplay.h"
 
 #ifdef DBG
@@ -110,6 +123,15 @@ void* g_mem_base = NULL;
 
 uint32_t g_start_address = UINT32_C(0xa4000040);
 
+/* The emulated device. There can be only one per process:
+ * - the zilmar plugin specs have no instance argument (plugin.c points
+ *   GFX_INFO/AUDIO_INFO/RSP_INFO directly at its registers and memory),
+ * - dynarec trampolines (recomp.c dynarec_*, cached_interp ops) are parameterless
+ *   and generated code / linkage assembly addresses g_dev fields absolutely,
+ * - the front-end API and main loop keep their state in globals.
+ * Device code below these layers only reaches other components through
+ * the pointers given at init time and should keep doing so.
+ */
 struct device g_dev;
 
 m64p_media_loader g_media_loader;
@@ -122,6 +144,33 @@ static int   l_TakeScreenshot = 0;       // Tell OSD Rendering callback to take
 static int   l_SpeedFactor = 100;        // percentage of nominal game speed at which emulator is running
 static int   l_FrameAdvance = 0;         // variable to check if we pause on next frame
 static int   l_MainSpeedLimit = 1;       // insert delay during vi_interrupt to keep speed at real-time
+static struct frame_pacer l_frame_pacer;
+static struct device* l_dev;             // device run by main_run, for the per-VI hooks
+static struct audio_out_ring l_audio_ring;
+static struct audio_out_resampler l_audio_resampler;
+
+/* real-time clocks and timers of the emulated hardware follow
+ * the virtual clock in deterministic mode, the host clock otherwise */
+static struct clock_virtual l_virtual_clock;
+static const time_t deterministic_epoch = 946684800; /* 2000-01-01 00:00:00 UTC */
+static uint64_t l_vi_period_ns;
+static void* l_rtc_clock;
+static const struct clock_backend_interface* l_rtc_iclock = &g_iclock_ctime_plus_delta;
+static void* l_timer_clock;
+static const struct clock_backend_interface* l_timer_iclock = &g_iclock_monotonic;
+
+/* frame decoded from RDRAM on each VI when software scanout is enabled */
+static struct
+{
+    int enabled;
+    uint8_t* pixels;
+    size_t capacity;
+    unsigned int width;
+    unsigned int height;
+} l_scanout;
+
+/* large enough for a few maximum sized AI DMAs */
+enum { AUDIO_RING_SIZE = 0x100000 };
 
 static osd_message_t *l_msgVol = NULL;
 static osd_message_t *l_msgFF = NULL;
@@ -355,6 +404,16 @@ int main_set_core_defaults(void)
     ConfigSetDefaultInt(g_CoreConfig, "SiDmaDuration", -1, "Duration of SI DMA (-1: use per game settings)");
     ConfigSetDefaultString(g_CoreConfig, "GbCameraVideoCaptureBackend1", DEFAULT_VIDEO_CAPTURE_BACKEND, "Gameboy Camera Video Capture backend");
     ConfigSetDefaultInt(g_CoreConfig, "SaveDiskFormat", 1, "Disk Save Format (0: Full Disk Copy (*.ndr/*.d6r), 1: RAM Area Only (*.ram))");
+    ConfigSetDefaultInt(g_CoreConfig, "RewindBufferSize", 0, "Memory budget in MB for rewind snapshots (0: rewind disabled)");
+    ConfigSetDefaultInt(g_CoreConfig, "RewindInterval", 30, "Number of VIs between two rewind snapshots");
+    ConfigSetDefaultBool(g_CoreConfig, "AudioSync", 0, "Adjust emulation speed to keep the audio queue at AudioSyncLatency (requires audio plugin support)");
+    ConfigSetDefaultInt(g_CoreConfig, "AudioSyncLatency", 64, "Target audio latency in ms for AudioSync");
+    ConfigSetDefaultBool(g_CoreConfig, "AudioThread", 0, "Feed the audio plugin from a separate thread so that it never blocks emulation (takes effect when the audio plugin is attached)");
+    ConfigSetDefaultInt(g_CoreConfig, "AudioResampleRate", 0, "Resample audio to this rate (Hz), rounded to the nearest rate the audio plugin can represent, before sending it to the audio plugin, 0 to let the plugin resample (takes effect when the audio plugin is attached)");
+    ConfigSetDefaultInt(g_CoreConfig, "AudioResampleQuality", AUDIO_RESAMPLER_SINC_FAST, "Core audio resampler quality: 0=Linear, 1=Sinc (16 taps), 2=Sinc (64 taps)");
+    ConfigSetDefaultBool(g_CoreConfig, "Deterministic", 0, "Reproducible runs: seed interrupt timing randomization with RandomSeed and run the real-time clocks on emulated time");
+    ConfigSetDefaultInt(g_CoreConfig, "RandomSeed", 0, "Seed of the interrupt timing randomization when Deterministic is set");
+    ConfigSetDefaultBool(g_CoreConfig, "SoftwareScanout", 0, "Decode each VI frame from RDRAM in the core, for screenshots and frame export without a video plugin");
 
     /* handle upgrades */
     if (bUpgrade)
@@ -569,6 +628,14 @@ void main_state_load(const char *filename)
         savestates_set_job(savestates_job_load, savestates_type_unknown, filename);
 }
 
+m64p_error main_state_rewind(int steps)
+{
+    if (netplay_is_init())
+        return M64ERR_INVALID_STATE;
+
+    return rewind_request(steps);
+}
+
 void main_state_save(int format, const char *filename)
 {
     if (netplay_is_init())
@@ -848,6 +915,9 @@ void new_frame(void)
     /* advance the current frame */
     l_CurrentFrame++;
 
+    if (batch_enabled() && batch_new_frame())
+        main_stop();
+
     if (l_FrameAdvance) {
         g_rom_pause = 1;
         l_FrameAdvance = 0;
@@ -855,85 +925,122 @@ void new_frame(void)
     }
 }
 
-#define SAMPLE_COUNT 3
 static void apply_speed_limiter(void)
 {
-    static unsigned long totalVIs = 0;
-    static int resetOnce = 0;
-    static int lastSpeedFactor = 100;
-    static unsigned int StartFPSTime = 0;
-    static const double defaultSpeedFactor = 100.0;
-    unsigned int CurrentFPSTime = SDL_GetTicks();
-    static double sleepTimes[SAMPLE_COUNT];
-    static unsigned int sleepTimesIndex = 0;
-
     // calculate frame duration based upon ROM setting (50/60hz) and mupen64plus speed adjustment
-    const double VILimitMilliseconds = 1000.0 / g_dev.vi.expected_refresh_rate;
-    const double SpeedFactorMultiple = defaultSpeedFactor/l_SpeedFactor;
-    const double AdjustedLimit = VILimitMilliseconds * SpeedFactorMultiple;
+    const uint64_t period = (uint64_t)(1000000000.0 / g_dev.vi.expected_refresh_rate * 100.0 / l_SpeedFactor);
 
-    //if this is the first time or we are resuming from pause
-    if(StartFPSTime == 0 || !resetOnce || lastSpeedFactor != l_SpeedFactor)
-    {
-       StartFPSTime = CurrentFPSTime;
-       totalVIs = 0;
-       resetOnce = 1;
-    }
-    else
-    {
-        ++totalVIs;
-    }
-
-    lastSpeedFactor = l_SpeedFactor;
-
-#if defined(PROFILE)
-    timed_section_start(TIMED_SECTION_IDLE);
-#endif
+    if (g_timing_enabled)
+        timed_section_start(TIMED_SECTION_IDLE);
 
 #ifdef DBG
     if(g_DebuggerActive) DebuggerCallback(DEBUG_UI_VI, 0);
 #endif
 
-    double totalElapsedGameTime = AdjustedLimit*totalVIs;
-    double elapsedRealTime = CurrentFPSTime - StartFPSTime;
-    double sleepTime = totalElapsedGameTime - elapsedRealTime;
+    frame_pacer_wait(&l_frame_pacer, period, l_MainSpeedLimit);
 
-    //Reset if the sleep needed is an unreasonable value
-    static const double minSleepNeeded = -50;
-    static const double maxSleepNeeded = 50;
-    if(sleepTime < minSleepNeeded || sleepTime > (maxSleepNeeded*SpeedFactorMultiple))
-    {
-       resetOnce = 0;
-    }
+    if (g_timing_enabled)
+        timed_section_end(TIMED_SECTION_IDLE);
+}
 
-    sleepTimes[sleepTimesIndex%SAMPLE_COUNT] = sleepTime;
-    sleepTimesIndex++;
+void main_get_pacing_stats(m64p_pacing_stats* stats)
+{
+    size_t used, peak;
+
+    *stats = l_frame_pacer.stats;
 
-    unsigned int elementsForAverage = sleepTimesIndex > SAMPLE_COUNT ? SAMPLE_COUNT : sleepTimesIndex;
+    audio_out_ring_get_stats(&l_audio_ring, &used, &peak, &stats->audio_ring_dropped);
+    stats->audio_ring_size = (unsigned int)l_audio_ring.size;
+    stats->audio_ring_used = (unsigned int)used;
+    stats->audio_ring_peak = (unsigned int)peak;
+}
 
-    // compute the average sleepTime
-    double sum = 0;
-    unsigned int index;
-    for(index = 0; index < elementsForAverage; index++)
+uint64_t main_get_virtual_time(void)
+{
+    return l_virtual_clock.elapsed;
+}
+
+void main_set_virtual_time(uint64_t ns)
+{
+    l_virtual_clock.elapsed = ns;
+}
+
+const uint8_t* main_scanout_frame(unsigned int* width, unsigned int* height)
+{
+    if (!l_scanout.enabled || l_scanout.width == 0)
+        return NULL;
+
+    *width = l_scanout.width;
+    *height = l_scanout.height;
+    return l_scanout.pixels;
+}
+
+static void main_scanout(struct device* dev)
+{
+    unsigned int width, height;
+    size_t size;
+
+    if (!l_scanout.enabled)
+        return;
+
+    vi_scanout_size(&dev->vi, &width, &height);
+    size = (size_t)width * height * 3;
+
+    if (size > l_scanout.capacity) {
+        uint8_t* pixels = realloc(l_scanout.pixels, size);
+        if (pixels == NULL) {
+            l_scanout.width = l_scanout.height = 0;
+            return;
+        }
+        l_scanout.pixels = pixels;
+        l_scanout.capacity = size;
+    }
+
+    vi_scanout(&dev->vi, dev->rdram.dram, dev->rdram.dram_size, l_scanout.pixels);
+    l_scanout.width = width;
+    l_scanout.height = height;
+
+    /* the render callback of the video plugin may never come */
+    if (l_TakeScreenshot != 0 && width != 0)
     {
-        sum += sleepTimes[index];
+        TakeScreenshot(l_TakeScreenshot - 1);
+        l_TakeScreenshot = 0;
     }
+}
 
-    double averageSleep = sum/elementsForAverage;
+/* Serve fork requests at the current VI. Forked children return from here
+ * and resume the emulation, the server stops the emulation once done. */
+static void main_fork_server(struct device* dev)
+{
+    if (l_audio_ring.thread != NULL || movie_is_active() || frame_dump_enabled()) {
+        DebugMessage(M64MSG_ERROR, "Fork server requires AudioThread to be disabled, no active movie and no frame dump");
+        fork_server_cancel();
+        return;
+    }
 
-    int sleepMs = (int)averageSleep;
+    /* children would share the audio device of the server */
+    if (plugin_attached(M64PLUGIN_AUDIO)) {
+        DebugMessage(M64MSG_ERROR, "Fork server requires no audio plugin to be attached");
+        fork_server_cancel();
+        return;
+    }
 
-    if(sleepMs > 0 && sleepMs < maxSleepNeeded*SpeedFactorMultiple && l_MainSpeedLimit)
-    {
-       DebugMessage(M64MSG_VERBOSE, "    apply_speed_limiter(): Waiting %ims", sleepMs);
+    /* workers don't survive fork */
+    flush_workqueue();
+    frame_hash_flush();
 
-       SDL_Delay(sleepMs);
+    if (!fork_server_run(dev)) {
+        main_stop();
+        return;
     }
 
+    workqueue_fork_child();
+    frame_export_fork_child();
+    frame_hash_fork_child();
+    frame_pacer_reset(&l_frame_pacer);
 
-#if defined(PROFILE)
-    timed_section_end(TIMED_SECTION_IDLE);
-#endif
+    if (batch_enabled())
+        batch_start(r4300_cp0_regs(&dev->r4300.cp0)[CP0_COUNT_REG]);
 }
 
 /* TODO: make a GameShark module and move that there */
@@ -977,8 +1084,34 @@ void new_vi(void)
 
     gs_apply_cheats(&g_cheat_ctx);
 
-    apply_speed_limiter();
-    main_check_inputs();
+    rewind_new_vi();
+
+    clock_virtual_advance(&l_virtual_clock, l_vi_period_ns);
+
+    if (fork_server_new_vi())
+        main_fork_server(l_dev);
+
+    if (ScreenshotBurstNewVI())
+        main_take_next_screenshot();
+
+    main_scanout(l_dev);
+    frame_export_new_vi();
+    frame_dump_new_vi();
+
+    if (frame_hash_new_vi())
+        main_stop();
+
+    if (batch_enabled())
+    {
+        /* unthrottled, no input polling */
+        if (batch_new_vi(r4300_cp0_regs(&l_dev->r4300.cp0)[CP0_COUNT_REG]))
+            main_stop();
+    }
+    else
+    {
+        apply_speed_limiter();
+        main_check_inputs();
+    }
 
     pause_loop();
 
@@ -1374,7 +1507,7 @@ void main_change_gb_cart(int control_id)
     init_gb_cart(gb_cart,
             data, init_gb_rom, release_gb_rom,
             data, init_gb_ram, release_gb_ram,
-            NULL, &g_iclock_ctime_plus_delta,
+            l_rtc_clock, l_rtc_iclock,
             &data->control_id, &g_irumble_backend_plugin_compat,
             data->gbcam_backend, data->igbcam_backend);
 
@@ -1409,6 +1542,7 @@ m64p_error main_run(void)
     int32_t si_dma_duration;
     int32_t no_compiled_jump;
     int32_t randomize_interrupt;
+    uint32_t random_seed;
     struct file_storage eep;
     struct file_storage fla;
     struct file_storage sra;
@@ -1424,6 +1558,9 @@ m64p_error main_run(void)
     void* gbcam_backend;
     const struct video_capture_backend_interface* igbcam_backend;
 
+    void* aout;
+    const struct audio_out_backend_interface* iaout;
+
     /* XXX: select type of flashram from db */
     uint32_t flashram_type = MX29L1100_ID;
 
@@ -1435,8 +1572,30 @@ m64p_error main_run(void)
     savestates_set_autoinc_slot(ConfigGetParamBool(g_CoreConfig, "AutoStateSlotIncrement"));
     savestates_select_slot(ConfigGetParamInt(g_CoreConfig, "CurrentStateSlot"));
     no_compiled_jump = ConfigGetParamBool(g_CoreConfig, "NoCompiledJump");
-    //We disable any randomness for netplay
-    randomize_interrupt = !netplay_is_init() ? ConfigGetParamBool(g_CoreConfig, "RandomizeInterrupt") : 0;
+    //We disable any randomness for netplay and input movies
+    randomize_interrupt = (!netplay_is_init() && !movie_is_active()) ? ConfigGetParamBool(g_CoreConfig, "RandomizeInterrupt") : 0;
+
+    clock_virtual_init(&l_virtual_clock, deterministic_epoch);
+    l_vi_period_ns = UINT64_C(1000000000) / vi_expected_refresh_rate_from_tv_standard(ROM_PARAMS.systemtype);
+
+    if (ConfigGetParamBool(g_CoreConfig, "Deterministic"))
+    {
+        random_seed = (uint32_t)ConfigGetParamInt(g_CoreConfig, "RandomSeed");
+        l_rtc_clock = l_timer_clock = &l_virtual_clock;
+        l_rtc_iclock = l_timer_iclock = &g_iclock_virtual;
+        DebugMessage(M64MSG_INFO, "Deterministic mode, random seed %u", random_seed);
+    }
+    else
+    {
+        random_seed = (uint32_t)time(NULL);
+        l_rtc_clock = NULL;
+        l_rtc_iclock = &g_iclock_ctime_plus_delta;
+        l_timer_clock = NULL;
+        l_timer_iclock = &g_iclock_monotonic;
+    }
+
+    l_scanout.enabled = ConfigGetParamBool(g_CoreConfig, "SoftwareScanout");
+    l_scanout.width = l_scanout.height = 0;
     count_per_op = ConfigGetParamInt(g_CoreConfig, "CountPerOp");
 
     if (ROM_PARAMS.disableextramem)
@@ -1523,7 +1682,7 @@ m64p_error main_run(void)
 
     load_dd_rom((uint8_t*)mem_base_u32(g_mem_base, MM_DD_ROM), &dd_rom_size);
     if (dd_rom_size > 0) {
-        dd_rtc_iclock = &g_iclock_ctime_plus_delta;
+        dd_rtc_iclock = l_rtc_iclock;
         load_dd_disk(&dd_disk, &dd_idisk);
     }
 
@@ -1584,7 +1743,7 @@ m64p_error main_run(void)
             for(k = 0; k < PAK_MAX_SIZE; ++k) {
                 /* Bio Pak */
                 if (l_ipaks[k] == &g_ibiopak) {
-                    init_biopak(&g_dev.biopaks[i], 64);
+                    init_biopak(&g_dev.biopaks[i], 64, l_timer_clock, l_timer_iclock);
                     l_paks[i][k] = &g_dev.biopaks[i];
 
                     if (Controls[i].Plugin == PLUGIN_BIO_PAK) {
@@ -1621,7 +1780,7 @@ m64p_error main_run(void)
                     init_gb_cart(&g_dev.gb_carts[i],
                             &l_gb_carts_data[i], init_gb_rom, release_gb_rom,
                             &l_gb_carts_data[i], init_gb_ram, release_gb_ram,
-                            NULL, &g_iclock_ctime_plus_delta,
+                            l_rtc_clock, l_rtc_iclock,
                             &l_gb_carts_data[i].control_id, &g_irumble_backend_plugin_compat,
                             l_gb_carts_data[i].gbcam_backend, l_gb_carts_data[i].igbcam_backend);
 
@@ -1669,26 +1828,71 @@ m64p_error main_run(void)
     }
 
 
+    /* audio plugin with its own copy of the AI registers can be fed
+     * with resampled audio and from the audio thread */
+    aout = &g_dev.ai;
+    iaout = &g_iaudio_out_backend_plugin_compat;
+    if (g_audio_plugin_shadow.enabled)
+    {
+        int resample_rate = ConfigGetParamInt(g_CoreConfig, "AudioResampleRate");
+
+        g_audio_plugin_shadow.vi_clock = vi_clock_from_tv_standard(ROM_PARAMS.systemtype);
+        aout = &g_audio_plugin_shadow;
+        iaout = &g_iaudio_out_backend_plugin_compat_shadow;
+
+        if (resample_rate > 0)
+        {
+            unsigned int exact_rate = audio_plugin_shadow_exact_rate(&g_audio_plugin_shadow, (unsigned int)resample_rate);
+
+            if (audio_out_resampler_init(&l_audio_resampler, exact_rate,
+                                         ConfigGetParamInt(g_CoreConfig, "AudioResampleQuality"), aout, iaout) == 0)
+            {
+                aout = &l_audio_resampler;
+                iaout = &g_iaudio_out_backend_resampler;
+                DebugMessage(M64MSG_INFO, "Resampling audio to %u Hz (%s)", exact_rate, audio_out_resampler_kernel_name());
+            }
+            else
+            {
+                DebugMessage(M64MSG_WARNING, "Could not create audio resampler");
+            }
+        }
+
+        if (ConfigGetParamBool(g_CoreConfig, "AudioThread")
+         && audio_out_ring_init(&l_audio_ring, AUDIO_RING_SIZE, aout, iaout) == 0)
+        {
+            aout = &l_audio_ring;
+            iaout = &g_iaudio_out_backend_ring;
+        }
+        else if (ConfigGetParamBool(g_CoreConfig, "AudioThread"))
+        {
+            DebugMessage(M64MSG_WARNING, "Audio thread disabled, audio plugin is called from the emulation thread");
+        }
+    }
+
+    /* samples are dumped as they come out of the AI */
+    frame_dump_start(vi_expected_refresh_rate_from_tv_standard(ROM_PARAMS.systemtype), &aout, &iaout);
+
     init_device(&g_dev,
                 g_mem_base,
                 emumode,
                 count_per_op,
                 no_compiled_jump,
                 randomize_interrupt,
+                random_seed,
                 g_start_address,
-                &g_dev.ai, &g_iaudio_out_backend_plugin_compat,
+                aout, iaout,
                 si_dma_duration,
                 rdram_size,
                 joybus_devices, ijoybus_devices,
                 vi_clock_from_tv_standard(ROM_PARAMS.systemtype), vi_expected_refresh_rate_from_tv_standard(ROM_PARAMS.systemtype),
-                NULL, &g_iclock_ctime_plus_delta,
+                l_rtc_clock, l_rtc_iclock,
                 g_rom_size,
                 (ROM_SETTINGS.savetype != EEPROM_16KB) ? JDT_EEPROM_4K : JDT_EEPROM_16K,
                 &eep, &g_ifile_storage,
                 flashram_type,
                 &fla, &g_ifile_storage,
                 &sra, &g_ifile_storage,
-                NULL, dd_rtc_iclock,
+                l_rtc_clock, dd_rtc_iclock,
                 dd_rom_size,
                 &dd_disk, dd_idisk);
 
@@ -1707,10 +1911,11 @@ m64p_error main_run(void)
     }
 
     /* set up the SDL key repeat and event filter to catch keyboard/joystick commands for the core */
-    event_initialize();
+    if (!batch_enabled())
+        event_initialize();
 
     /* initialize the on-screen display */
-    if (ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
+    if (!batch_enabled() && ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
     {
         // init on-screen display
         int width = 640, height = 480;
@@ -1733,13 +1938,70 @@ m64p_error main_run(void)
     /* Startup message on the OSD */
     osd_new_message(OSD_MIDDLE_CENTER, "Mupen64Plus Started...");
 
+    l_dev = &g_dev;
+    movie_init(&g_dev);
+
+    if (!netplay_is_init())
+    {
+        int rewind_size = ConfigGetParamInt(g_CoreConfig, "RewindBufferSize");
+        int rewind_interval = ConfigGetParamInt(g_CoreConfig, "RewindInterval");
+        rewind_init(&g_dev, (rewind_size > 0) ? (size_t)rewind_size * 1024 * 1024 : 0,
+                    (rewind_interval > 0) ? (unsigned int)rewind_interval : 0);
+    }
+
+    frame_pacer_init(&l_frame_pacer, NULL, &g_iclock_monotonic);
+    if (ConfigGetParamBool(g_CoreConfig, "AudioSync"))
+    {
+        int latency = ConfigGetParamInt(g_CoreConfig, "AudioSyncLatency");
+        frame_pacer_set_audio(&l_frame_pacer, g_dev.ai.aout, g_dev.ai.iaout,
+                              (latency > 0) ? (uint64_t)latency * 1000000 : 0);
+        if (audio.aiGetQueuedBytes == NULL)
+        {
+            DebugMessage(M64MSG_WARNING, "Audio plugin can't report its queue, AudioSync disabled");
+            frame_pacer_set_audio(&l_frame_pacer, NULL, NULL, 0);
+        }
+    }
+
+    /* sections are timed for the periodic profile log and the batch statistics */
+#if defined(PROFILE)
+    g_timing_enabled = 1;
+#else
+    g_timing_enabled = batch_enabled();
+#endif
+
     g_EmulatorRunning = 1;
     StateChanged(M64CORE_EMU_STATE, M64EMU_RUNNING);
 
     poweron_device(&g_dev);
     pif_bootrom_hle_execute(&g_dev.r4300);
+
+    if (batch_enabled())
+        batch_start(r4300_cp0_regs(&g_dev.r4300.cp0)[CP0_COUNT_REG]);
+
     run_device(&g_dev);
 
+    if (batch_enabled())
+    {
+        m64p_batch_stats stats;
+
+        batch_finish(r4300_cp0_regs(&g_dev.r4300.cp0)[CP0_COUNT_REG], g_dev.r4300.cp0.count_per_op);
+        batch_get_stats(&stats);
+        DebugMessage(M64MSG_INFO, "Batch run: %u VIs, %u frames in %.3f s (%.1f VI/s)",
+                     stats.vis, stats.frames, stats.wall_time_ns / 1e9, stats.vis_per_second);
+    }
+
+    movie_finish();
+    frame_hash_finish();
+    frame_dump_finish();
+    ScreenshotFlush();
+    fork_server_cancel();
+    rewind_deinit();
+    l_dev = NULL;
+    free(l_scanout.pixels);
+    memset(&l_scanout, 0, sizeof(l_scanout));
+    audio_out_ring_release(&l_audio_ring);
+    audio_out_resampler_release(&l_audio_resampler);
+
     /* now begin to shut down */
 #ifdef WITH_LIRC
     lircStop();
@@ -1766,7 +2028,7 @@ m64p_error main_run(void)
     close_file_storage(&mpk);
     close_dd_disk(&dd_disk);
 
-    if (ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
+    if (!batch_enabled() && ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
     {
         osd_exit();
     }
@@ -1787,6 +2049,10 @@ on_input_open_failure:
 on_audio_open_failure:
     gfx.romClosed();
 on_gfx_open_failure:
+    frame_dump_finish();
+    audio_out_ring_release(&l_audio_ring);
+    audio_out_resampler_release(&l_audio_resampler);
+
     /* release gb_carts */
     for(i = 0; i < GAME_CONTROLLERS_COUNT; ++i) {
         if (!Controls[i].RawData && g_dev.gb_carts[i].read_gb_cart != NULL) {
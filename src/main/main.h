@@ -84,6 +84,17 @@ void main_state_inc_slot(void);
 void main_state_dec_slot(void);
 void main_state_load(const char *filename);
 void main_state_save(int format, const char *filename);
+m64p_error main_state_rewind(int steps);
+
+void main_get_pacing_stats(m64p_pacing_stats* stats);
+
+/* emulated time elapsed on the virtual clock (ns), kept in savestates */
+uint64_t main_get_virtual_time(void);
+void main_set_virtual_time(uint64_t ns);
+
+/* top-down RGB24 frame of the current VI decoded by the software scanout,
+ * NULL if it is disabled or the VI is blanked */
+const uint8_t* main_scanout_frame(unsigned int* width, unsigned int* height);
 
 m64p_error main_core_state_query(m64p_core_param param, int *rval);
 m64p_error main_core_state_set(m64p_core_param param, int val);
@@ -0,0 +1,537 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - movie.c                                                 *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "movie.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "device/device.h"
+#include "main/batch.h"
+#include "main/main.h"
+#include "main/netplay.h"
+#include "main/rom.h"
+#include "main/savestates.h"
+#include "main/state_container.h"
+#include "osd/osd.h"
+#include "plugin/plugin.h"
+
+#define MOVIE_HEADER_ID STATE_SECTION_ID('M', 'O', 'V', 'H')
+#define MOVIE_STATE_ID  STATE_SECTION_ID('M', 'O', 'V', 'S')
+#define MOVIE_INPUT_ID  STATE_SECTION_ID('M', 'O', 'V', 'I')
+
+enum { MOVIE_HEADER_VERSION = 1 };
+enum { MOVIE_INPUT_VERSION = 1 };
+enum { MOVIE_MD5_SIZE = 32 };
+enum { MOVIE_HEADER_SIZE = 3 * 4 + MOVIE_MD5_SIZE };
+
+enum { MOVIE_MAX_REPEAT = 0x80 };
+enum { MOVIE_CHANGE_TOKEN = 0x80 };
+
+enum { MOVIE_INITIAL_CAPACITY = 0x10000 };
+
+enum movie_mode
+{
+    MOVIE_IDLE,
+    MOVIE_RECORDING,
+    MOVIE_PLAYING
+};
+
+enum movie_request
+{
+    MOVIE_REQUEST_NONE,
+    MOVIE_REQUEST_CAPTURE,  /* capture the anchor state, then start recording */
+    MOVIE_REQUEST_RESTORE,  /* restore the anchor state, then start playing */
+    MOVIE_REQUEST_STOP
+};
+
+struct movie_globals {
+    enum movie_mode mode;
+    /* set by the frontend thread, processed at a safe point of the emulation thread */
+    volatile enum movie_request request;
+
+    m64p_movie_anchor anchor;
+    char *filepath;             /* recording destination */
+    uint32_t present;
+    uint32_t polls;
+
+    unsigned char *state;       /* anchor savestate */
+    size_t state_size;
+
+    unsigned char *stream;
+    size_t size;
+    size_t capacity;            /* recording only */
+    size_t pos;                 /* playing only */
+
+    uint32_t last_input[GAME_CONTROLLERS_COUNT];
+    /* polls not yet written (recording) or still to replay (playing)
+     * of the current run of unchanged inputs */
+    unsigned int repeat;
+};
+
+static struct movie_globals l_movie;
+
+/* the anchor state is saved and loaded from this device, set by main_run */
+static struct device* l_movie_dev;
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >>  0);
+    p[1] = (unsigned char)(v >>  8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+    return ((uint32_t)p[0] <<  0)
+         | ((uint32_t)p[1] <<  8)
+         | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t movie_present_mask(void)
+{
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < GAME_CONTROLLERS_COUNT; ++i) {
+        if (Controls[i].Present && !Controls[i].RawData)
+            mask |= (1 << i);
+    }
+
+    return mask;
+}
+
+static void movie_clear(void)
+{
+    free(l_movie.filepath);
+    free(l_movie.state);
+    free(l_movie.stream);
+    memset(&l_movie, 0, sizeof(l_movie));
+}
+
+static int movie_emit(unsigned char byte)
+{
+    if (l_movie.size == l_movie.capacity) {
+        size_t capacity = 2 * l_movie.capacity;
+        unsigned char *stream = realloc(l_movie.stream, capacity);
+        if (stream == NULL)
+            return -1;
+        l_movie.stream = stream;
+        l_movie.capacity = capacity;
+    }
+
+    l_movie.stream[l_movie.size++] = byte;
+    return 0;
+}
+
+static int movie_flush_repeat(void)
+{
+    if (l_movie.repeat == 0)
+        return 0;
+
+    if (movie_emit((unsigned char)(l_movie.repeat - 1)) != 0)
+        return -1;
+
+    l_movie.repeat = 0;
+    return 0;
+}
+
+static int movie_write(void)
+{
+    unsigned char header[MOVIE_HEADER_SIZE];
+    struct state_section_data sections[3];
+    size_t count = 0;
+
+    put_u32(header + 0, (uint32_t)l_movie.anchor);
+    put_u32(header + 4, l_movie.present);
+    put_u32(header + 8, l_movie.polls);
+    memcpy(header + 12, ROM_SETTINGS.MD5, MOVIE_MD5_SIZE);
+
+    sections[count].id = MOVIE_HEADER_ID;
+    sections[count].version = MOVIE_HEADER_VERSION;
+    sections[count].data = header;
+    sections[count].size = sizeof(header);
+    ++count;
+
+    if (l_movie.anchor == M64MOVIE_SAVESTATE) {
+        sections[count].id = MOVIE_STATE_ID;
+        sections[count].version = 1;
+        sections[count].data = l_movie.state;
+        sections[count].size = l_movie.state_size;
+        ++count;
+    }
+
+    sections[count].id = MOVIE_INPUT_ID;
+    sections[count].version = MOVIE_INPUT_VERSION;
+    sections[count].data = l_movie.stream;
+    sections[count].size = l_movie.size;
+    ++count;
+
+    return state_container_write(l_movie.filepath, sections, count);
+}
+
+static void movie_end(void)
+{
+    if (l_movie.mode == MOVIE_RECORDING) {
+        if (movie_flush_repeat() != 0 || movie_write() != 0) {
+            main_message(M64MSG_ERROR, OSD_BOTTOM_LEFT, "Could not write movie %s", l_movie.filepath);
+        }
+        else {
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Movie recorded: %u polls, %u bytes",
+                         l_movie.polls, (unsigned int)l_movie.size);
+        }
+    }
+    else if (l_movie.mode == MOVIE_PLAYING) {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Movie playback stopped");
+    }
+
+    movie_clear();
+}
+
+static void movie_record_input(int control_id, uint32_t input)
+{
+    uint32_t delta = input ^ l_movie.last_input[control_id];
+    unsigned char token = MOVIE_CHANGE_TOKEN | (unsigned char)(control_id << 4);
+    int i;
+
+    l_movie.polls++;
+
+    if (delta == 0) {
+        if (++l_movie.repeat == MOVIE_MAX_REPEAT && movie_flush_repeat() != 0)
+            goto fail;
+        return;
+    }
+
+    if (movie_flush_repeat() != 0)
+        goto fail;
+
+    for (i = 0; i < 4; ++i) {
+        if ((delta >> (8 * i)) & 0xff)
+            token |= (1 << i);
+    }
+
+    if (movie_emit(token) != 0)
+        goto fail;
+
+    for (i = 0; i < 4; ++i) {
+        if ((token & (1 << i)) && movie_emit((unsigned char)(delta >> (8 * i))) != 0)
+            goto fail;
+    }
+
+    l_movie.last_input[control_id] = input;
+    return;
+
+fail:
+    DebugMessage(M64MSG_ERROR, "Could not grow movie buffer, recording stopped");
+    l_movie.mode = MOVIE_IDLE;
+    movie_clear();
+}
+
+static void movie_play_input(int control_id, uint32_t* input)
+{
+    unsigned char token;
+    uint32_t delta = 0;
+    int i;
+
+    l_movie.polls++;
+
+    if (l_movie.repeat > 0) {
+        l_movie.repeat--;
+        *input = l_movie.last_input[control_id];
+        return;
+    }
+
+    if (l_movie.pos == l_movie.size) {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Movie playback finished");
+        *input = l_movie.last_input[control_id];
+        movie_clear();
+        if (batch_enabled())
+            main_stop();
+        return;
+    }
+
+    token = l_movie.stream[l_movie.pos++];
+
+    if (!(token & MOVIE_CHANGE_TOKEN)) {
+        l_movie.repeat = token;
+        *input = l_movie.last_input[control_id];
+        return;
+    }
+
+    if ((token & 0x40) || ((token >> 4) & 0x3) != control_id) {
+        DebugMessage(M64MSG_ERROR, "Movie desynchronized after %u polls, playback stopped", l_movie.polls);
+        movie_clear();
+        return;
+    }
+
+    for (i = 0; i < 4; ++i) {
+        if (token & (1 << i)) {
+            if (l_movie.pos == l_movie.size) {
+                DebugMessage(M64MSG_ERROR, "Truncated movie, playback stopped");
+                movie_clear();
+                return;
+            }
+            delta |= (uint32_t)l_movie.stream[l_movie.pos++] << (8 * i);
+        }
+    }
+
+    l_movie.last_input[control_id] ^= delta;
+    *input = l_movie.last_input[control_id];
+}
+
+static m64p_error movie_check_idle(void)
+{
+    if (l_movie.mode != MOVIE_IDLE || l_movie.request != MOVIE_REQUEST_NONE)
+        return M64ERR_INVALID_STATE;
+
+    /* netplay has its own input synchronization */
+    if (netplay_is_init())
+        return M64ERR_INVALID_STATE;
+
+    return M64ERR_SUCCESS;
+}
+
+m64p_error movie_record(const char* filepath, m64p_movie_anchor anchor)
+{
+    m64p_error err = movie_check_idle();
+    if (err != M64ERR_SUCCESS)
+        return err;
+
+    if (anchor != M64MOVIE_POWER_ON && anchor != M64MOVIE_SAVESTATE)
+        return M64ERR_INPUT_INVALID;
+
+    /* power-on movies must be armed before starting the emulation */
+    if (anchor == M64MOVIE_POWER_ON && g_EmulatorRunning)
+        return M64ERR_INVALID_STATE;
+
+    l_movie.filepath = malloc(strlen(filepath) + 1);
+    l_movie.stream = malloc(MOVIE_INITIAL_CAPACITY);
+    if (l_movie.filepath == NULL || l_movie.stream == NULL) {
+        movie_clear();
+        return M64ERR_NO_MEMORY;
+    }
+
+    strcpy(l_movie.filepath, filepath);
+    l_movie.capacity = MOVIE_INITIAL_CAPACITY;
+    l_movie.anchor = anchor;
+    l_movie.present = movie_present_mask();
+
+    if (anchor == M64MOVIE_POWER_ON)
+        l_movie.mode = MOVIE_RECORDING;
+    else
+        l_movie.request = MOVIE_REQUEST_CAPTURE;
+
+    DebugMessage(M64MSG_INFO, "Recording movie to %s", filepath);
+    return M64ERR_SUCCESS;
+}
+
+static int movie_read_section(struct state_container* container, uint32_t id, uint32_t version,
+                              unsigned char** data, size_t* size)
+{
+    const struct state_section* section = state_container_find(container, id);
+
+    if (section == NULL || section->version > version)
+        return -1;
+
+    *data = malloc(section->size > 0 ? section->size : 1);
+    if (*data == NULL)
+        return -1;
+
+    *size = section->size;
+    return state_container_read(container, section, *data);
+}
+
+static m64p_error movie_open(const char* filepath, int from_current_state)
+{
+    struct state_container container;
+    unsigned char* header = NULL;
+    size_t header_size = 0;
+    uint32_t present;
+    m64p_error err = movie_check_idle();
+
+    if (err != M64ERR_SUCCESS)
+        return err;
+
+    if (state_container_open(&container, filepath) != 0)
+        return M64ERR_FILES;
+
+    if (movie_read_section(&container, MOVIE_HEADER_ID, MOVIE_HEADER_VERSION, &header, &header_size) != 0
+     || header_size < MOVIE_HEADER_SIZE) {
+        DebugMessage(M64MSG_ERROR, "%s is not a movie", filepath);
+        err = M64ERR_INPUT_INVALID;
+        goto fail;
+    }
+
+    l_movie.anchor = (m64p_movie_anchor)get_u32(header + 0);
+    present = get_u32(header + 4);
+
+    if (l_movie.anchor == M64MOVIE_POWER_ON && g_EmulatorRunning && !from_current_state) {
+        err = M64ERR_INVALID_STATE;
+        goto fail;
+    }
+
+    if ((l_movie.anchor == M64MOVIE_SAVESTATE && !from_current_state
+         && movie_read_section(&container, MOVIE_STATE_ID, 1, &l_movie.state, &l_movie.state_size) != 0)
+     || (l_movie.anchor != M64MOVIE_POWER_ON && l_movie.anchor != M64MOVIE_SAVESTATE)
+     || movie_read_section(&container, MOVIE_INPUT_ID, MOVIE_INPUT_VERSION, &l_movie.stream, &l_movie.size) != 0) {
+        DebugMessage(M64MSG_ERROR, "Corrupted or unsupported movie %s", filepath);
+        err = M64ERR_INPUT_INVALID;
+        goto fail;
+    }
+
+    if (memcmp(header + 12, ROM_SETTINGS.MD5, MOVIE_MD5_SIZE) != 0)
+        DebugMessage(M64MSG_WARNING, "Movie %s was recorded with another ROM", filepath);
+
+    if (present != movie_present_mask())
+        DebugMessage(M64MSG_WARNING, "Movie %s was recorded with other controllers plugged", filepath);
+
+    l_movie.present = present;
+
+    if (l_movie.anchor == M64MOVIE_POWER_ON || from_current_state)
+        l_movie.mode = MOVIE_PLAYING;
+    else
+        l_movie.request = MOVIE_REQUEST_RESTORE;
+
+    DebugMessage(M64MSG_INFO, "Playing movie %s (%u polls)", filepath, get_u32(header + 8));
+
+    free(header);
+    state_container_close(&container);
+    return M64ERR_SUCCESS;
+
+fail:
+    free(header);
+    state_container_close(&container);
+    movie_clear();
+    return err;
+}
+
+m64p_error movie_play(const char* filepath)
+{
+    return movie_open(filepath, 0);
+}
+
+m64p_error movie_play_from_current_state(const char* filepath)
+{
+    return movie_open(filepath, 1);
+}
+
+m64p_error movie_stop(void)
+{
+    if (l_movie.mode == MOVIE_IDLE && l_movie.request == MOVIE_REQUEST_NONE)
+        return M64ERR_INVALID_STATE;
+
+    if (g_EmulatorRunning)
+        l_movie.request = MOVIE_REQUEST_STOP;
+    else
+        movie_end();
+
+    return M64ERR_SUCCESS;
+}
+
+int movie_is_active(void)
+{
+    return l_movie.mode != MOVIE_IDLE || l_movie.request != MOVIE_REQUEST_NONE;
+}
+
+int movie_is_playing(void)
+{
+    return l_movie.mode == MOVIE_PLAYING;
+}
+
+void movie_input(int control_id, uint32_t* input)
+{
+    switch (l_movie.mode)
+    {
+    case MOVIE_RECORDING:
+        movie_record_input(control_id, *input);
+        break;
+    case MOVIE_PLAYING:
+        movie_play_input(control_id, input);
+        break;
+    default:
+        break;
+    }
+}
+
+int movie_restore_pending(void)
+{
+    return l_movie.request == MOVIE_REQUEST_RESTORE;
+}
+
+void movie_restore(void)
+{
+    l_movie.request = MOVIE_REQUEST_NONE;
+
+    if (!savestates_load_m64p_mem(l_movie_dev, l_movie.state, l_movie.state_size)) {
+        main_message(M64MSG_ERROR, OSD_BOTTOM_LEFT, "Could not load movie savestate");
+        movie_clear();
+        return;
+    }
+
+    free(l_movie.state);
+    l_movie.state = NULL;
+    l_movie.mode = MOVIE_PLAYING;
+}
+
+int movie_update_pending(void)
+{
+    return l_movie.request == MOVIE_REQUEST_CAPTURE
+        || l_movie.request == MOVIE_REQUEST_STOP;
+}
+
+void movie_update(void)
+{
+    if (l_movie.request == MOVIE_REQUEST_STOP) {
+        movie_end();
+        return;
+    }
+
+    l_movie.request = MOVIE_REQUEST_NONE;
+    l_movie.state_size = savestates_m64p_size();
+    l_movie.state = malloc(l_movie.state_size);
+
+    if (l_movie.state == NULL
+     || !savestates_save_m64p_mem(l_movie_dev, l_movie.state, l_movie.state_size)) {
+        main_message(M64MSG_ERROR, OSD_BOTTOM_LEFT, "Could not capture movie savestate");
+        movie_clear();
+        return;
+    }
+
+    l_movie.mode = MOVIE_RECORDING;
+}
+
+void movie_init(struct device* dev)
+{
+    l_movie_dev = dev;
+}
+
+void movie_finish(void)
+{
+    if (movie_is_active())
+        movie_end();
+
+    l_movie_dev = NULL;
+}
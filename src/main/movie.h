@@ -0,0 +1,81 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - movie.h                                                 *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_MOVIE_H
+#define M64P_MAIN_MOVIE_H
+
+#include <stdint.h>
+
+#include "api/m64p_types.h"
+
+struct device;
+
+/* Input movies record the value returned by each controller poll and
+ * replay them instead of polling the input plugin. A movie starts either
+ * at power-on or from a savestate embedded in the movie file.
+ *
+ * Movie files are savestate containers (see state_container.h) with
+ * the following sections:
+ *   "MOVH": u32 anchor, u32 mask of present controllers, u32 poll count,
+ *           32 chars ROM MD5
+ *   "MOVS": anchor savestate (only for M64MOVIE_SAVESTATE)
+ *   "MOVI": input stream, one token per poll or run of polls:
+ *       0RRRRRRR            R+1 polls returning the last value of the polled controller
+ *       10CCMMMM [bytes]    poll of controller CC, followed by the non-zero bytes
+ *                           (bit i of M set for byte i, least significant first)
+ *                           of the XOR between the new and the last value
+ *
+ * Replay is only deterministic with RandomizeInterrupt disabled, which is
+ * forced while a movie is active. Savestate loads and rewinds during a
+ * movie are not tracked. Controllers in raw data mode are not recorded.
+ */
+
+m64p_error movie_record(const char* filepath, m64p_movie_anchor anchor);
+m64p_error movie_play(const char* filepath);
+
+/* Play the input of a movie right away, ignoring its anchor.
+ * Must be called from the emulation thread. */
+m64p_error movie_play_from_current_state(const char* filepath);
+
+/* Stop recording (and write the movie file) or playback */
+m64p_error movie_stop(void);
+
+int movie_is_active(void);
+int movie_is_playing(void);
+
+/* Called on each poll of a present controller. While recording, input is
+ * appended to the movie. While playing, input is replaced by the recorded value. */
+void movie_input(int control_id, uint32_t* input);
+
+/* Anchor states are restored / captured and requests are processed at
+ * safe points of the interrupt handler */
+int movie_restore_pending(void);
+void movie_restore(void);
+int movie_update_pending(void);
+void movie_update(void);
+
+/* Called when the emulation starts, anchor states are saved to and loaded from dev */
+void movie_init(struct device* dev);
+/* Called when the emulation stops, writes the recorded movie */
+void movie_finish(void);
+
+#endif /* M64P_MAIN_MOVIE_H */
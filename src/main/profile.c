@@ -26,7 +26,10 @@
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
 
+int g_timing_enabled = 0;
+
 static long long int time_in_section[NUM_TIMED_SECTIONS];
+static long long int total_in_section[NUM_TIMED_SECTIONS];
 static long long int last_start[NUM_TIMED_SECTIONS];
 
 #if defined(WIN32) && !defined(__MINGW32__)
@@ -72,6 +75,20 @@ void timed_section_end(enum timed_section section)
 {
    long long int end = get_time();
    time_in_section[section] += end - last_start[section];
+   total_in_section[section] += end - last_start[section];
+}
+
+long long int timed_section_total(enum timed_section section)
+{
+   return time_to_nsec(total_in_section[section]);
+}
+
+void timed_sections_reset(void)
+{
+   int i;
+
+   for (i = 0; i < NUM_TIMED_SECTIONS; ++i)
+      total_in_section[i] = 0;
 }
 
 void timed_sections_refresh()
@@ -80,18 +97,21 @@ void timed_sections_refresh()
    if(time_to_nsec(curr_time - last_start[TIMED_SECTION_ALL]) >= 2000000000)
    {
       time_in_section[TIMED_SECTION_ALL] = curr_time - last_start[TIMED_SECTION_ALL];
-      DebugMessage(M64MSG_INFO, "gfx=%f%% - audio=%f%% - compiler=%f%%, idle=%f%%",
+      DebugMessage(M64MSG_INFO, "gfx=%f%% - audio=%f%% - rsp=%f%% - compiler=%f%%, idle=%f%%",
          100.0 * (double)time_in_section[TIMED_SECTION_GFX] / time_in_section[TIMED_SECTION_ALL],
          100.0 * (double)time_in_section[TIMED_SECTION_AUDIO] / time_in_section[TIMED_SECTION_ALL],
+         100.0 * (double)time_in_section[TIMED_SECTION_RSP] / time_in_section[TIMED_SECTION_ALL],
          100.0 * (double)time_in_section[TIMED_SECTION_COMPILER] / time_in_section[TIMED_SECTION_ALL],
          100.0 * (double)time_in_section[TIMED_SECTION_IDLE] / time_in_section[TIMED_SECTION_ALL]);
-      DebugMessage(M64MSG_INFO, "gfx=%llins - audio=%llins - compiler %llins - idle=%llins",
+      DebugMessage(M64MSG_INFO, "gfx=%llins - audio=%llins - rsp=%llins - compiler %llins - idle=%llins",
          time_to_nsec(time_in_section[TIMED_SECTION_GFX]),
          time_to_nsec(time_in_section[TIMED_SECTION_AUDIO]),
+         time_to_nsec(time_in_section[TIMED_SECTION_RSP]),
          time_to_nsec(time_in_section[TIMED_SECTION_COMPILER]),
          time_to_nsec(time_in_section[TIMED_SECTION_IDLE]));
       time_in_section[TIMED_SECTION_GFX] = 0;
       time_in_section[TIMED_SECTION_AUDIO] = 0;
+      time_in_section[TIMED_SECTION_RSP] = 0;
       time_in_section[TIMED_SECTION_COMPILER] = 0;
       time_in_section[TIMED_SECTION_IDLE] = 0;
       last_start[TIMED_SECTION_ALL] = curr_time;
@@ -31,11 +31,21 @@ enum timed_section
     TIMED_SECTION_AUDIO,
     TIMED_SECTION_COMPILER,
     TIMED_SECTION_IDLE,
+    TIMED_SECTION_RSP,
     NUM_TIMED_SECTIONS
 };
 
+/* Set when sections are timed: in PROFILE builds and when batch statistics
+ * are collected. Callers check it before timing a section, so that other
+ * runs don't read the clock. */
+extern int g_timing_enabled;
+
 void timed_section_start(enum timed_section section);
 void timed_section_end(enum timed_section section);
 void timed_sections_refresh(void);
 
+/* Accumulated time (ns) in a section since the last reset */
+long long int timed_section_total(enum timed_section section);
+void timed_sections_reset(void);
+
 #endif
@@ -0,0 +1,489 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rewind.c                                                *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "rewind.h"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "device/device.h"
+#include "main/list.h"
+#include "main/main.h"
+#include "main/savestates.h"
+#include "main/workqueue.h"
+#include "osal/write_watch.h"
+#include "osd/osd.h"
+
+/* compressed delta allowing to go from the next (newer) state to this one:
+ * the bitmap of the modified pages followed by their (older XOR newer) content */
+struct rewind_snapshot {
+    struct list_head list;
+    size_t size;
+    unsigned char data[];
+};
+
+enum { REWIND_PAGE_SIZE = 0x1000 };
+enum { REWIND_RDRAM_DIRTY_SIZE = RDRAM_MAX_SIZE / REWIND_PAGE_SIZE / 32 * sizeof(uint32_t) };
+
+struct rewind_globals {
+    struct device* dev;
+    int enabled;
+    size_t budget;
+    unsigned int interval;
+    unsigned int vi_counter;
+    int capture_pending;
+    int restore_steps;
+    /* set once the newest state has been restored, so that another rewind
+     * request goes further back instead of restoring it again */
+    int restored;
+
+    size_t state_size;
+    size_t page_count;
+    size_t bitmap_size;
+    unsigned char *current;     /* newest captured state (NULL if none yet) */
+    unsigned char *delta;       /* pages staged by the capture, then turned into
+                                   the delta of the modified ones by the worker */
+    uint32_t *staged;           /* bitmap of the staged pages */
+    uint32_t *changed;          /* bitmap of the modified pages */
+    unsigned char *scratch;     /* compression buffer */
+    size_t scratch_size;
+    uint32_t tlb_generation;    /* of the TLB lookup tables in current */
+
+    /* RDRAM writes are tracked with the host memory protection when
+     * supported, so that only the written pages are copied at capture */
+    int watching;
+    uint32_t *rdram_dirty;      /* 4KB blocks of RDRAM written since the last capture */
+    /* set while current only holds the bulk copy made by the worker,
+     * the next capture then brings it up to date without storing a delta */
+    int syncing;
+
+    /* oldest snapshot first */
+    struct list_head snapshots;
+    size_t used;
+    unsigned int count;
+
+    /* protects snapshots, used, count and busy */
+    SDL_mutex *lock;
+    int busy;
+    struct work_struct work;
+    struct work_struct copy_work;
+};
+
+static struct rewind_globals l_rewind;
+
+static void rewind_xor(unsigned char *dst, const unsigned char *src, size_t size)
+{
+    size_t i;
+    size_t words = size / sizeof(uint32_t);
+    uint32_t *d = (uint32_t *)dst;
+    const uint32_t *s = (const uint32_t *)src;
+
+    for (i = 0; i < words; ++i)
+        d[i] ^= s[i];
+
+    for (i = words * sizeof(uint32_t); i < size; ++i)
+        dst[i] ^= src[i];
+}
+
+static void rewind_drop_oldest(void)
+{
+    struct rewind_snapshot *snapshot = list_first_entry(&l_rewind.snapshots, struct rewind_snapshot, list);
+
+    list_del(&snapshot->list);
+    l_rewind.used -= snapshot->size;
+    l_rewind.count--;
+    free(snapshot);
+}
+
+static void rewind_clear(void)
+{
+    while (!list_empty(&l_rewind.snapshots))
+        rewind_drop_oldest();
+}
+
+static size_t rewind_page_size(size_t page)
+{
+    size_t offset = page * REWIND_PAGE_SIZE;
+
+    return (l_rewind.state_size - offset < REWIND_PAGE_SIZE) ? l_rewind.state_size - offset : REWIND_PAGE_SIZE;
+}
+
+static int rewind_page_changed(const uint32_t *changed, size_t page)
+{
+    return (changed[page / 32] >> (page % 32)) & 1;
+}
+
+/* Worker: updates current with the staged pages and compresses the backward delta */
+static void rewind_encode_work(struct work_struct *work)
+{
+    struct rewind_snapshot *snapshot = NULL;
+    z_stream strm;
+    size_t page;
+    int ret;
+
+    savestates_update_m64p_mem(l_rewind.current, l_rewind.delta, l_rewind.staged, l_rewind.changed, l_rewind.state_size);
+
+    if (l_rewind.syncing) {
+        /* current is now the first state, there is no older one to go back to */
+        SDL_LockMutex(l_rewind.lock);
+        l_rewind.syncing = 0;
+        l_rewind.busy = 0;
+        SDL_UnlockMutex(l_rewind.lock);
+        return;
+    }
+
+    memset(&strm, 0, sizeof(strm));
+    ret = deflateInit(&strm, Z_BEST_SPEED);
+
+    if (ret == Z_OK) {
+        strm.next_out = l_rewind.scratch;
+        strm.avail_out = (uInt)l_rewind.scratch_size;
+
+        strm.next_in = (Bytef *)l_rewind.changed;
+        strm.avail_in = (uInt)l_rewind.bitmap_size;
+        ret = deflate(&strm, Z_NO_FLUSH);
+
+        for (page = 0; page < l_rewind.page_count && ret == Z_OK; ++page) {
+            if (!rewind_page_changed(l_rewind.changed, page))
+                continue;
+
+            strm.next_in = l_rewind.delta + page * REWIND_PAGE_SIZE;
+            strm.avail_in = (uInt)rewind_page_size(page);
+            ret = deflate(&strm, Z_NO_FLUSH);
+        }
+
+        if (ret == Z_OK)
+            ret = deflate(&strm, Z_FINISH);
+
+        if (ret == Z_STREAM_END) {
+            snapshot = malloc(sizeof(*snapshot) + strm.total_out);
+            if (snapshot != NULL) {
+                snapshot->size = strm.total_out;
+                memcpy(snapshot->data, l_rewind.scratch, strm.total_out);
+            }
+        }
+
+        deflateEnd(&strm);
+    }
+
+    SDL_LockMutex(l_rewind.lock);
+
+    if (snapshot == NULL) {
+        /* the delta chain is broken, restart from the new state */
+        DebugMessage(M64MSG_WARNING, "Failed to store rewind snapshot");
+        rewind_clear();
+    }
+    else {
+        list_add_tail(&snapshot->list, &l_rewind.snapshots);
+        l_rewind.used += snapshot->size;
+        l_rewind.count++;
+
+        while (l_rewind.used > l_rewind.budget && !list_empty(&l_rewind.snapshots))
+            rewind_drop_oldest();
+    }
+
+    l_rewind.busy = 0;
+
+    SDL_UnlockMutex(l_rewind.lock);
+}
+
+/* Worker: copies the bulk of the first state while the emulation goes on */
+static void rewind_copy_work(struct work_struct *work)
+{
+    savestates_copy_m64p_bulk(l_rewind.dev, l_rewind.current, l_rewind.state_size);
+
+    SDL_LockMutex(l_rewind.lock);
+    l_rewind.busy = 0;
+    SDL_UnlockMutex(l_rewind.lock);
+}
+
+/* Applies a snapshot to current, making it the previous state.
+ * Returns 0 if the snapshot is corrupted. */
+static int rewind_apply_snapshot(const struct rewind_snapshot *snapshot)
+{
+    uLongf size = (uLongf)l_rewind.scratch_size;
+    const uint32_t *changed = (const uint32_t *)l_rewind.scratch;
+    const unsigned char *src = l_rewind.scratch + l_rewind.bitmap_size;
+    size_t page, expected = l_rewind.bitmap_size;
+
+    if (uncompress(l_rewind.scratch, &size, snapshot->data, (uLong)snapshot->size) != Z_OK
+     || size < l_rewind.bitmap_size)
+        return 0;
+
+    for (page = 0; page < l_rewind.page_count; ++page) {
+        if (rewind_page_changed(changed, page))
+            expected += rewind_page_size(page);
+    }
+
+    if (size != expected)
+        return 0;
+
+    for (page = 0; page < l_rewind.page_count; ++page) {
+        if (!rewind_page_changed(changed, page))
+            continue;
+
+        rewind_xor(l_rewind.current + page * REWIND_PAGE_SIZE, src, rewind_page_size(page));
+        src += rewind_page_size(page);
+    }
+
+    return 1;
+}
+
+int rewind_init(struct device* dev, size_t budget, unsigned int interval)
+{
+    memset(&l_rewind, 0, sizeof(l_rewind));
+    l_rewind.dev = dev;
+    INIT_LIST_HEAD(&l_rewind.snapshots);
+    init_work(&l_rewind.work, rewind_encode_work);
+    init_work(&l_rewind.copy_work, rewind_copy_work);
+
+    if (budget == 0 || interval == 0)
+        return 0;
+
+    l_rewind.budget = budget;
+    l_rewind.interval = interval;
+    l_rewind.state_size = savestates_m64p_size();
+    l_rewind.page_count = (l_rewind.state_size + REWIND_PAGE_SIZE - 1) / REWIND_PAGE_SIZE;
+    l_rewind.bitmap_size = (l_rewind.page_count + 31) / 32 * sizeof(uint32_t);
+    l_rewind.scratch_size = compressBound((uLong)(l_rewind.bitmap_size + l_rewind.state_size));
+
+    l_rewind.lock = SDL_CreateMutex();
+    l_rewind.delta = malloc(l_rewind.state_size);
+    l_rewind.staged = malloc(l_rewind.bitmap_size);
+    l_rewind.changed = malloc(l_rewind.bitmap_size);
+    l_rewind.rdram_dirty = malloc(REWIND_RDRAM_DIRTY_SIZE);
+    l_rewind.scratch = malloc(l_rewind.scratch_size);
+
+    if (l_rewind.lock == NULL || l_rewind.delta == NULL || l_rewind.staged == NULL || l_rewind.changed == NULL
+     || l_rewind.rdram_dirty == NULL || l_rewind.scratch == NULL) {
+        DebugMessage(M64MSG_ERROR, "Could not allocate rewind buffers, rewind disabled");
+        rewind_deinit();
+        return -1;
+    }
+
+    /* have the system back the staging buffer now rather than during the first captures */
+    memset(l_rewind.delta, 0, l_rewind.state_size);
+
+    l_rewind.enabled = 1;
+    DebugMessage(M64MSG_INFO, "Rewind enabled: snapshot every %u VI, %u MB budget",
+                 interval, (unsigned int)(budget / (1024 * 1024)));
+
+    return 0;
+}
+
+void rewind_deinit(void)
+{
+    if (l_rewind.enabled) {
+        flush_work(&l_rewind.copy_work);
+        flush_work(&l_rewind.work);
+    }
+
+    if (l_rewind.watching)
+        osal_write_watch_stop();
+
+    rewind_clear();
+    free(l_rewind.current);
+    free(l_rewind.delta);
+    free(l_rewind.staged);
+    free(l_rewind.changed);
+    free(l_rewind.rdram_dirty);
+    free(l_rewind.scratch);
+
+    if (l_rewind.lock != NULL)
+        SDL_DestroyMutex(l_rewind.lock);
+
+    memset(&l_rewind, 0, sizeof(l_rewind));
+    INIT_LIST_HEAD(&l_rewind.snapshots);
+}
+
+void rewind_new_vi(void)
+{
+    if (!l_rewind.enabled)
+        return;
+
+    if (++l_rewind.vi_counter >= l_rewind.interval) {
+        l_rewind.vi_counter = 0;
+        l_rewind.capture_pending = 1;
+    }
+}
+
+int rewind_capture_pending(void)
+{
+    return l_rewind.capture_pending;
+}
+
+/* Takes the first state. When the RDRAM writes can be tracked, the bulk of it
+ * is copied by the worker and the next capture brings it up to date. */
+static void rewind_capture_first(void)
+{
+    unsigned char *state = malloc(l_rewind.state_size);
+    if (state == NULL) {
+        DebugMessage(M64MSG_ERROR, "Could not allocate rewind buffers, rewind disabled");
+        l_rewind.enabled = 0;
+        return;
+    }
+
+#if !defined(M64P_BIG_ENDIAN)
+    /* the image holds the bulk arrays as they are in memory */
+    l_rewind.watching = (osal_write_watch_start(l_rewind.dev->rdram.dram, RDRAM_MAX_SIZE) == 0);
+#endif
+    l_rewind.tlb_generation = l_rewind.dev->r4300.cp0.tlb.generation;
+
+    if (!l_rewind.watching) {
+        savestates_save_m64p_mem(l_rewind.dev, state, l_rewind.state_size);
+
+        SDL_LockMutex(l_rewind.lock);
+        l_rewind.current = state;
+        SDL_UnlockMutex(l_rewind.lock);
+        return;
+    }
+
+    SDL_LockMutex(l_rewind.lock);
+    l_rewind.current = state;
+    l_rewind.syncing = 1;
+    l_rewind.busy = 1;
+    SDL_UnlockMutex(l_rewind.lock);
+
+    queue_work(&l_rewind.copy_work);
+}
+
+void rewind_capture(void)
+{
+    const uint32_t *rdram_dirty = NULL;
+    int first;
+
+    SDL_LockMutex(l_rewind.lock);
+    if (l_rewind.busy) {
+        /* previous snapshot is still being encoded, try again later */
+        SDL_UnlockMutex(l_rewind.lock);
+        return;
+    }
+    first = (l_rewind.current == NULL);
+    SDL_UnlockMutex(l_rewind.lock);
+
+    l_rewind.capture_pending = 0;
+    l_rewind.restored = 0;
+
+    if (first) {
+        rewind_capture_first();
+        return;
+    }
+
+    if (l_rewind.watching) {
+        memset(l_rewind.rdram_dirty, 0, REWIND_RDRAM_DIRTY_SIZE);
+        osal_write_watch_collect(l_rewind.rdram_dirty, REWIND_PAGE_SIZE);
+        rdram_dirty = l_rewind.rdram_dirty;
+    }
+
+    /* only the memory which may have changed is copied on the emulation
+     * thread, the comparison and the compression are made by the worker */
+    savestates_stage_m64p_mem(l_rewind.dev, l_rewind.delta, l_rewind.staged,
+                              l_rewind.dev->r4300.cp0.tlb.generation != l_rewind.tlb_generation, rdram_dirty);
+    l_rewind.tlb_generation = l_rewind.dev->r4300.cp0.tlb.generation;
+
+    SDL_LockMutex(l_rewind.lock);
+    l_rewind.busy = 1;
+    SDL_UnlockMutex(l_rewind.lock);
+
+    queue_work(&l_rewind.work);
+}
+
+int rewind_restore_pending(void)
+{
+    return l_rewind.restore_steps > 0;
+}
+
+void rewind_restore(void)
+{
+    struct rewind_snapshot *snapshot;
+    int steps = l_rewind.restore_steps;
+    int deltas, i;
+
+    l_rewind.restore_steps = 0;
+
+    /* wait for the snapshot being encoded */
+    flush_work(&l_rewind.copy_work);
+    flush_work(&l_rewind.work);
+
+    if (l_rewind.current == NULL || l_rewind.syncing) {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "No rewind snapshot available");
+        return;
+    }
+
+    /* the newest state counts as the first step, unless we already went back to it */
+    deltas = l_rewind.restored ? steps : steps - 1;
+
+    SDL_LockMutex(l_rewind.lock);
+    for (i = 0; i < deltas && !list_empty(&l_rewind.snapshots); ++i) {
+        snapshot = list_entry(l_rewind.snapshots.prev, struct rewind_snapshot, list);
+
+        if (!rewind_apply_snapshot(snapshot)) {
+            DebugMessage(M64MSG_ERROR, "Corrupted rewind snapshot, discarding rewind history");
+            rewind_clear();
+            free(l_rewind.current);
+            l_rewind.current = NULL;
+            SDL_UnlockMutex(l_rewind.lock);
+            return;
+        }
+
+        list_del(&snapshot->list);
+        l_rewind.used -= snapshot->size;
+        l_rewind.count--;
+        free(snapshot);
+    }
+    SDL_UnlockMutex(l_rewind.lock);
+
+    /* don't take a fault on each page while loading, RDRAM is then the same as in current */
+    if (l_rewind.watching)
+        osal_write_watch_stop();
+
+    /* loading byte-swaps in place on big endian hosts, so work on a copy */
+    memcpy(l_rewind.delta, l_rewind.current, l_rewind.state_size);
+    if (savestates_load_m64p_mem(l_rewind.dev, l_rewind.delta, l_rewind.state_size)) {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State rewound (%u snapshots left)", l_rewind.count);
+    }
+
+    if (l_rewind.watching)
+        l_rewind.watching = (osal_write_watch_start(l_rewind.dev->rdram.dram, RDRAM_MAX_SIZE) == 0);
+
+    l_rewind.restored = 1;
+    l_rewind.vi_counter = 0;
+    l_rewind.capture_pending = 0;
+}
+
+m64p_error rewind_request(int steps)
+{
+    if (!l_rewind.enabled)
+        return M64ERR_INVALID_STATE;
+
+    if (steps < 1)
+        return M64ERR_INPUT_INVALID;
+
+    l_rewind.restore_steps = steps;
+
+    return M64ERR_SUCCESS;
+}
@@ -0,0 +1,56 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rewind.h                                                *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_REWIND_H
+#define M64P_MAIN_REWIND_H
+
+#include <stddef.h>
+
+#include "api/m64p_types.h"
+
+struct device;
+
+/* Rewind keeps the most recent state in memory along with a ring of
+ * compressed backward deltas (older state XOR newer state), bounded by
+ * a memory budget. A capture only copies the pages of the state which
+ * changed since the previous one, their compression runs on the workqueue.
+ * Where the host memory protection allows it, RDRAM writes are tracked so
+ * that only the written pages are compared, and the first state is copied
+ * on the workqueue.
+ */
+
+int rewind_init(struct device* dev, size_t budget, unsigned int interval);
+void rewind_deinit(void);
+
+/* called on each VI to schedule snapshot captures */
+void rewind_new_vi(void);
+
+/* capture / restore must be performed at a safe point of the interrupt handler */
+int rewind_capture_pending(void);
+void rewind_capture(void);
+int rewind_restore_pending(void);
+void rewind_restore(void);
+
+/* Request to step back by the given number of snapshots.
+ * The restore happens asynchronously at the next safe point. */
+m64p_error rewind_request(int steps);
+
+#endif /* M64P_MAIN_REWIND_H */
@@ -38,13 +38,20 @@
 #include "device/device.h"
 #include "main.h"
 #include "md5.h"
+#include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "rom.h"
+#include "rom_cache.h"
+#include "rom_index.h"
 #include "util.h"
 
 #define CHUNKSIZE 1024*128 /* Read files 128KB at a time. */
 
+/* Images are converted and hashed one chunk at a time,
+ * so that the hash reads data which is still in the cache. */
+enum { ROM_HASH_CHUNK_SIZE = 256 * 1024 };
+
 /* Number of cpu cycles per instruction */
 enum { DEFAULT_COUNT_PER_OP = 2 };
 /* by default, extra mem is enabled */
@@ -52,9 +59,10 @@ enum { DEFAULT_DISABLE_EXTRA_MEM = 0 };
 /* Default SI DMA duration */
 enum { DEFAULT_SI_DMA_DURATION = 0x900 };
 
-static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5);
+static romdatabase_entry* romdatabase_search_md5(md5_byte_t* md5);
 
 static _romdatabase g_romdatabase;
+static struct rom_index l_rom_index;
 
 /* Global loaded rom size. */
 int g_rom_size = 0;
@@ -80,62 +88,59 @@ static int is_valid_rom(const unsigned char *buffer)
         return 0;
 }
 
+/* Returns V64IMAGE, N64IMAGE or Z64IMAGE according to the signature of a
+ * valid Nintendo 64 ROM image. */
+static unsigned char rom_image_type(const void* src)
+{
+    if (memcmp(src, V64_SIGNATURE, sizeof(V64_SIGNATURE)) == 0)
+        return V64IMAGE;
+    else if (memcmp(src, N64_SIGNATURE, sizeof(N64_SIGNATURE)) == 0)
+        return N64IMAGE;
+    else
+        return Z64IMAGE;
+}
+
 /* Copies the source block of memory to the destination block of memory while
  * switching the endianness of .v64 and .n64 images to the .z64 format, which
  * is native to the Nintendo 64. The data extraction routines and MD5 hashing
  * function may only act on the .z64 big-endian format.
  *
- * IN: src: The source block of memory. This must be a valid Nintendo 64 ROM
- *          image of 'len' bytes.
+ * IN: src: The source block of memory, part of a Nintendo 64 ROM image of
+ *          type 'imagetype', starting at a multiple of 4 bytes in the image.
  *     len: The length of the source and destination, in bytes.
+ *     imagetype: V64IMAGE, N64IMAGE or Z64IMAGE, as given by rom_image_type.
  * OUT: dst: The destination block of memory. This must be a valid buffer for
  *           at least 'len' bytes.
- *      imagetype: A pointer to a byte that gets updated with the value of
- *                 V64IMAGE, N64IMAGE or Z64IMAGE according to the format of
- *                 the source block. The value is undefined if 'src' does not
- *                 represent a valid Nintendo 64 ROM image.
  */
-static void swap_copy_rom(void* dst, const void* src, size_t len, unsigned char* imagetype)
+static void swap_copy_rom(void* dst, const void* src, size_t len, unsigned char imagetype)
 {
-    if (memcmp(src, V64_SIGNATURE, sizeof(V64_SIGNATURE)) == 0)
+    if (imagetype == V64IMAGE)
     {
-        size_t i;
-        const uint16_t* src16 = (const uint16_t*) src;
-        uint16_t* dst16 = (uint16_t*) dst;
-
-        *imagetype = V64IMAGE;
         /* .v64 images have byte-swapped half-words (16-bit). */
-        for (i = 0; i < len; i += 2)
-        {
-            *dst16++ = m64p_swap16(*src16++);
-        }
+        swap_copy_buffer(dst, src, 2, len / 2);
     }
-    else if (memcmp(src, N64_SIGNATURE, sizeof(N64_SIGNATURE)) == 0)
+    else if (imagetype == N64IMAGE)
     {
-        size_t i;
-        const uint32_t* src32 = (const uint32_t*) src;
-        uint32_t* dst32 = (uint32_t*) dst;
-
-        *imagetype = N64IMAGE;
         /* .n64 images have byte-swapped words (32-bit). */
-        for (i = 0; i < len; i += 4)
-        {
-            *dst32++ = m64p_swap32(*src32++);
-        }
+        swap_copy_buffer(dst, src, 4, len / 4);
     }
     else {
-        *imagetype = Z64IMAGE;
         memcpy(dst, src, len);
     }
 }
 
-m64p_error open_rom(const unsigned char* romimage, unsigned int size)
+/* Loads the image in the cartridge memory and identifies it.
+ * If known_md5 isn't NULL, it is used instead of hashing the image.
+ * The MD5 of the image is stored in digest. */
+static m64p_error open_rom_image(const unsigned char* romimage, unsigned int size,
+                                 const md5_byte_t* known_md5, md5_byte_t digest[16])
 {
     md5_state_t state;
-    md5_byte_t digest[16];
     romdatabase_entry* entry;
     char buffer[256];
     unsigned char imagetype;
+    uint8_t* cart_rom = (uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM);
+    unsigned int offset;
     int i;
 
     /* check input requirements */
@@ -149,15 +154,30 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     g_RomWordsLittleEndian = 0;
     /* allocate new buffer for ROM and copy into this buffer */
     g_rom_size = size;
-    swap_copy_rom((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), romimage, size, &imagetype);
+    imagetype = rom_image_type(romimage);
+
+    if (known_md5 != NULL)
+    {
+        swap_copy_rom(cart_rom, romimage, size, imagetype);
+        if (known_md5 != digest)
+            memcpy(digest, known_md5, 16);
+    }
+    else
+    {
+        /* Calculate MD5 hash  */
+        md5_init(&state);
+        for (offset = 0; offset < size; offset += ROM_HASH_CHUNK_SIZE)
+        {
+            unsigned int len = (size - offset < ROM_HASH_CHUNK_SIZE) ? size - offset : ROM_HASH_CHUNK_SIZE;
+            swap_copy_rom(cart_rom + offset, romimage + offset, len, imagetype);
+            md5_append(&state, (const md5_byte_t*)(cart_rom + offset), len);
+        }
+        md5_finish(&state, digest);
+    }
     /* ROM is now in N64 native (big endian) byte order */
 
-    memcpy(&ROM_HEADER, (uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), sizeof(m64p_rom_header));
+    memcpy(&ROM_HEADER, cart_rom, sizeof(m64p_rom_header));
 
-    /* Calculate MD5 hash  */
-    md5_init(&state);
-    md5_append(&state, (const md5_byte_t*)((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM)), g_rom_size);
-    md5_finish(&state, digest);
     for ( i = 0; i < 16; ++i )
         sprintf(buffer+i*2, "%02X", digest[i]);
     buffer[32] = '\0';
@@ -175,7 +195,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     trim(ROM_PARAMS.headername); /* Remove trailing whitespace from ROM name. */
 
     /* Look up this ROM in the .ini file and fill in goodname, etc */
-    if ((entry=ini_search_by_md5(digest)) != NULL ||
+    if ((entry=rom_index_find_md5(&l_rom_index, digest)) != NULL ||
         (entry=ini_search_by_crc(tohl(ROM_HEADER.CRC1),tohl(ROM_HEADER.CRC2))) != NULL)
     {
         strncpy(ROM_SETTINGS.goodname, entry->goodname, 255);
@@ -232,6 +252,68 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     return M64ERR_SUCCESS;
 }
 
+m64p_error open_rom(const unsigned char* romimage, unsigned int size)
+{
+    md5_byte_t digest[16];
+
+    return open_rom_image(romimage, size, NULL, digest);
+}
+
+m64p_error open_rom_file(const char* filepath)
+{
+    const unsigned char* romimage;
+    size_t size;
+    int64_t mtime;
+    m64p_rom_header header;
+    struct rom_cache_key key;
+    char fullpath[PATH_MAX];
+    md5_byte_t digest[16];
+    int cached;
+    m64p_error rval;
+
+    /* The file is byte-swapped (if needed) straight from the page cache into
+     * the cartridge memory: this avoids reading the whole image in a temporary
+     * heap buffer first. */
+    romimage = (const unsigned char*)osal_file_map(filepath, &size, &mtime);
+    if (romimage == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "open_rom_file(): couldn't map ROM file '%s'", filepath);
+        return M64ERR_FILES;
+    }
+
+    if (size < 4096 || size > CART_ROM_MAX_SIZE || (size % 4) != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "open_rom_file(): invalid ROM size (%u bytes)", (unsigned int)size);
+        osal_file_unmap(romimage, size);
+        return M64ERR_INPUT_INVALID;
+    }
+
+    if (!is_valid_rom(romimage))
+    {
+        DebugMessage(M64MSG_ERROR, "open_rom_file(): not a valid ROM image");
+        osal_file_unmap(romimage, size);
+        return M64ERR_INPUT_INVALID;
+    }
+
+    /* Files already seen don't need to be hashed again */
+    swap_copy_rom(&header, romimage, sizeof(header), rom_image_type(romimage));
+    /* the same file must hit the cache whichever way it is named */
+    key.path = (osal_file_fullpath(filepath, fullpath) == 0) ? fullpath : filepath;
+    key.size = size;
+    key.mtime = mtime;
+    key.crc1 = tohl(header.CRC1);
+    key.crc2 = tohl(header.CRC2);
+    cached = rom_cache_lookup(&key, digest);
+
+    rval = open_rom_image(romimage, (unsigned int)size, cached ? digest : NULL, digest);
+    osal_file_unmap(romimage, size);
+
+    if (rval == M64ERR_SUCCESS && !cached)
+        rom_cache_store(&key, digest);
+
+    return rval;
+}
+
 m64p_error close_rom(void)
 {
     /* Clear Byte-swapped flag, since ROM is now deleted. */
@@ -281,7 +363,7 @@ static size_t romdatabase_resolve_round(void)
         if (!entry->entry.refmd5)
             continue;
 
-        ref = ini_search_by_md5(entry->entry.refmd5);
+        ref = romdatabase_search_md5(entry->entry.refmd5);
         if (!ref) {
             DebugMessage(M64MSG_WARNING, "ROM Database: Error solving RefMD5s");
             continue;
@@ -399,34 +481,42 @@ static void romdatabase_resolve(void)
 /********************************************************************************************/
 /* INI Rom database functions */
 
-void romdatabase_open(void)
+static void romdatabase_free_list(void)
+{
+    while (g_romdatabase.list != NULL)
+        {
+        romdatabase_search* search = g_romdatabase.list->next_entry;
+        if(g_romdatabase.list->entry.goodname)
+            free(g_romdatabase.list->entry.goodname);
+        if(g_romdatabase.list->entry.refmd5)
+            free(g_romdatabase.list->entry.refmd5);
+        free(g_romdatabase.list->entry.cheats);
+        free(g_romdatabase.list);
+        g_romdatabase.list = search;
+        }
+
+    memset(g_romdatabase.md5_lists, 0, sizeof(g_romdatabase.md5_lists));
+}
+
+static int romdatabase_parse(const char *pathname)
 {
     FILE *fPtr;
     char buffer[256];
     romdatabase_search* search = NULL;
     romdatabase_search** next_search;
 
-    int counter, value, lineno;
+    int value, lineno;
     unsigned char index;
-    const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
-
-    if(g_romdatabase.have_database)
-        return;
 
     /* Open romdatabase. */
-    if (pathname == NULL || (fPtr = fopen(pathname, "rb")) == NULL)
+    if ((fPtr = fopen(pathname, "rb")) == NULL)
     {
         DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
-        return;
+        return -1;
     }
 
-    g_romdatabase.have_database = 1;
-
     /* Clear premade indices. */
-    for(counter = 0; counter < 255; ++counter)
-        g_romdatabase.crc_lists[counter] = NULL;
-    for(counter = 0; counter < 255; ++counter)
-        g_romdatabase.md5_lists[counter] = NULL;
+    memset(g_romdatabase.md5_lists, 0, sizeof(g_romdatabase.md5_lists));
     g_romdatabase.list = NULL;
 
     next_search = &g_romdatabase.list;
@@ -473,7 +563,6 @@ void romdatabase_open(void)
             search->entry.set_flags = ROMDATABASE_ENTRY_NONE;
 
             search->next_entry = NULL;
-            search->next_crc = NULL;
             /* Index MD5s by first 8 bits. */
             index = search->entry.md5[0];
             search->next_md5 = g_romdatabase.md5_lists[index];
@@ -500,10 +589,6 @@ void romdatabase_open(void)
                 if (sscanf(l.value, "%X %X%c", &search->entry.crc1,
                     &search->entry.crc2, &garbage_sweeper) == 2)
                 {
-                    /* Index CRCs by first 8 bits. */
-                    index = search->entry.crc1 >> 24;
-                    search->next_crc = g_romdatabase.crc_lists[index];
-                    g_romdatabase.crc_lists[index] = search;
                     search->entry.set_flags |= ROMDATABASE_ENTRY_CRC;
                 }
                 else
@@ -677,7 +762,64 @@ void romdatabase_open(void)
     }
 
     fclose(fPtr);
+    return 0;
+}
+
+static const char* romdatabase_index_path(void)
+{
+    static char filepath[PATH_MAX];
+    const char* dir = osal_get_user_cachepath();
+
+    if (dir == NULL)
+        return NULL;
+
+    snprintf(filepath, sizeof(filepath), "%sromdatabase.bin", dir);
+    return filepath;
+}
+
+void romdatabase_open(void)
+{
+    const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
+    const char *indexpath;
+    uint64_t ini_size;
+    int64_t ini_mtime;
+    int rval;
+
+    if(g_romdatabase.have_database)
+        return;
+
+    if (pathname == NULL || osal_file_info(pathname, &ini_size, &ini_mtime) != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
+        return;
+    }
+
+    /* Use the compiled database, unless the ini file changed since it was built */
+    indexpath = romdatabase_index_path();
+    if (indexpath != NULL && rom_index_load(&l_rom_index, indexpath, ini_size, ini_mtime) == 0)
+    {
+        g_romdatabase.have_database = 1;
+        DebugMessage(M64MSG_VERBOSE, "ROM Database: loaded %u entries from '%s'", l_rom_index.count, indexpath);
+        return;
+    }
+
+    if (romdatabase_parse(pathname) != 0)
+        return;
+
     romdatabase_resolve();
+    rval = rom_index_build(&l_rom_index, g_romdatabase.list, ini_size, ini_mtime);
+    romdatabase_free_list();
+
+    if (rval != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "ROM Database: no usable entry in '%s'", pathname);
+        return;
+    }
+
+    g_romdatabase.have_database = 1;
+
+    if (indexpath != NULL && rom_index_save(&l_rom_index, indexpath) != 0)
+        DebugMessage(M64MSG_WARNING, "ROM Database: couldn't write '%s'", indexpath);
 }
 
 void romdatabase_close(void)
@@ -685,26 +827,15 @@ void romdatabase_close(void)
     if (!g_romdatabase.have_database)
         return;
 
-    while (g_romdatabase.list != NULL)
-        {
-        romdatabase_search* search = g_romdatabase.list->next_entry;
-        if(g_romdatabase.list->entry.goodname)
-            free(g_romdatabase.list->entry.goodname);
-        if(g_romdatabase.list->entry.refmd5)
-            free(g_romdatabase.list->entry.refmd5);
-        free(g_romdatabase.list->entry.cheats);
-        free(g_romdatabase.list);
-        g_romdatabase.list = search;
-        }
+    rom_index_free(&l_rom_index);
+    g_romdatabase.have_database = 0;
 }
 
-static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5)
+/* Only used while the database is parsed, to resolve RefMD5s */
+static romdatabase_entry* romdatabase_search_md5(md5_byte_t* md5)
 {
     romdatabase_search* search;
 
-    if(!g_romdatabase.have_database)
-        return NULL;
-
     search = g_romdatabase.md5_lists[md5[0]];
 
     while (search != NULL && memcmp(search->entry.md5, md5, 16) != 0)
@@ -718,20 +849,10 @@ static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5)
 
 romdatabase_entry* ini_search_by_crc(unsigned int crc1, unsigned int crc2)
 {
-    romdatabase_search* search;
-
-    if(!g_romdatabase.have_database) 
-        return NULL;
-
-    search = g_romdatabase.crc_lists[((crc1 >> 24) & 0xff)];
-
-    while (search != NULL && search->entry.crc1 != crc1 && search->entry.crc2 != crc2)
-        search = search->next_crc;
-
-    if(search == NULL) 
+    if(!g_romdatabase.have_database)
         return NULL;
 
-    return &(search->entry);
+    return rom_index_find_crc(&l_rom_index, crc1, crc2);
 }
 
 
@@ -39,6 +39,8 @@
 /* ROM Loading and Saving functions */
 
 m64p_error open_rom(const unsigned char* romimage, unsigned int size);
+/* Same as open_rom, reading the image directly from a memory-mapped file */
+m64p_error open_rom_file(const char* filepath);
 m64p_error close_rom(void);
 
 extern int g_rom_size;
@@ -149,14 +151,13 @@ typedef struct _romdatabase_search
 {
     romdatabase_entry entry;
     struct _romdatabase_search* next_entry;
-    struct _romdatabase_search* next_crc;
     struct _romdatabase_search* next_md5;
 } romdatabase_search;
 
 typedef struct
 {
     int have_database;
-    romdatabase_search* crc_lists[256];
+    /* only used while parsing the ini file, see rom_index.h */
     romdatabase_search* md5_lists[256];
     romdatabase_search* list;
 } _romdatabase;
@@ -0,0 +1,256 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rom_cache.c                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "rom_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "osal/files.h"
+#include "osal/preproc.h"
+
+/* least recently used entries are dropped past that */
+enum { ROM_CACHE_MAX_ENTRIES = 256 };
+
+struct rom_cache_entry
+{
+    char* path;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t crc1;
+    uint32_t crc2;
+    md5_byte_t md5[16];
+};
+
+struct rom_cache
+{
+    int loaded;
+    size_t count;
+    struct rom_cache_entry entries[ROM_CACHE_MAX_ENTRIES];
+};
+
+static struct rom_cache l_rom_cache;
+
+static const char* rom_cache_filepath(void)
+{
+    static char filepath[PATH_MAX];
+    const char* dir = osal_get_user_cachepath();
+
+    if (dir == NULL)
+        return NULL;
+
+    snprintf(filepath, sizeof(filepath), "%sromcache.txt", dir);
+    return filepath;
+}
+
+static int rom_cache_parse_md5(const char* hex, md5_byte_t md5[16])
+{
+    unsigned int byte;
+    int i;
+
+    for (i = 0; i < 16; ++i)
+    {
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1)
+            return 0;
+        md5[i] = (md5_byte_t)byte;
+    }
+
+    return 1;
+}
+
+static void rom_cache_drop(size_t index)
+{
+    free(l_rom_cache.entries[index].path);
+    memmove(&l_rom_cache.entries[index], &l_rom_cache.entries[index + 1],
+            (l_rom_cache.count - index - 1) * sizeof(l_rom_cache.entries[0]));
+    l_rom_cache.count--;
+}
+
+static void rom_cache_add(const struct rom_cache_key* key, const md5_byte_t md5[16])
+{
+    struct rom_cache_entry* entry;
+    char* path = strdup(key->path);
+
+    if (path == NULL)
+        return;
+
+    if (l_rom_cache.count == ROM_CACHE_MAX_ENTRIES)
+        rom_cache_drop(0);
+
+    entry = &l_rom_cache.entries[l_rom_cache.count++];
+    entry->path = path;
+    entry->size = key->size;
+    entry->mtime = key->mtime;
+    entry->crc1 = key->crc1;
+    entry->crc2 = key->crc2;
+    memcpy(entry->md5, md5, 16);
+}
+
+static void rom_cache_load(void)
+{
+    char line[64 + PATH_MAX];
+    char hex[33];
+    unsigned long long size;
+    long long mtime;
+    unsigned int crc1, crc2;
+    int pathpos;
+    const char* filepath;
+    FILE* f;
+
+    l_rom_cache.loaded = 1;
+
+    filepath = rom_cache_filepath();
+    if (filepath == NULL || (f = fopen(filepath, "r")) == NULL)
+        return;
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        struct rom_cache_key key;
+        md5_byte_t md5[16];
+        size_t len = strlen(line);
+
+        /* skip truncated and malformed lines */
+        if (len == 0 || line[len - 1] != '\n')
+            continue;
+        line[len - 1] = '\0';
+
+        if (sscanf(line, "%32s %llu %lld %8x %8x %n", hex, &size, &mtime, &crc1, &crc2, &pathpos) != 5
+         || strlen(hex) != 32 || !rom_cache_parse_md5(hex, md5) || line[pathpos] == '\0')
+            continue;
+
+        key.path = line + pathpos;
+        key.size = size;
+        key.mtime = mtime;
+        key.crc1 = crc1;
+        key.crc2 = crc2;
+        rom_cache_add(&key, md5);
+    }
+
+    fclose(f);
+}
+
+/* The cache is written to a temporary file first, so that a crash or
+ * another process never sees it half written. */
+static void rom_cache_save(void)
+{
+    const char* filepath = rom_cache_filepath();
+    char tmppath[PATH_MAX + 4];
+    FILE* f;
+    size_t i;
+    int j, failed;
+
+    if (filepath == NULL)
+        return;
+
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", filepath);
+    if ((f = fopen(tmppath, "w")) == NULL)
+    {
+        DebugMessage(M64MSG_WARNING, "Couldn't write ROM cache file");
+        return;
+    }
+
+    for (i = 0; i < l_rom_cache.count; ++i)
+    {
+        const struct rom_cache_entry* entry = &l_rom_cache.entries[i];
+
+        for (j = 0; j < 16; ++j)
+            fprintf(f, "%02X", entry->md5[j]);
+        fprintf(f, " %llu %lld %08X %08X %s\n", (unsigned long long)entry->size, (long long)entry->mtime,
+                (unsigned int)entry->crc1, (unsigned int)entry->crc2, entry->path);
+    }
+
+    failed = ferror(f);
+    if (fclose(f) != 0 || failed || osal_file_replace(tmppath, filepath) != 0)
+    {
+        DebugMessage(M64MSG_WARNING, "Couldn't write ROM cache file");
+        remove(tmppath);
+    }
+}
+
+static int rom_cache_find(const char* path)
+{
+    size_t i;
+
+    for (i = 0; i < l_rom_cache.count; ++i)
+    {
+        if (strcmp(l_rom_cache.entries[i].path, path) == 0)
+            return (int)i;
+    }
+
+    return -1;
+}
+
+int rom_cache_lookup(const struct rom_cache_key* key, md5_byte_t md5[16])
+{
+    struct rom_cache_entry entry;
+    int i;
+
+    /* paths containing a line break can't be stored */
+    if (strpbrk(key->path, "\r\n") != NULL)
+        return 0;
+
+    if (!l_rom_cache.loaded)
+        rom_cache_load();
+
+    i = rom_cache_find(key->path);
+    if (i < 0)
+        return 0;
+
+    entry = l_rom_cache.entries[i];
+    if (entry.size != key->size || entry.mtime != key->mtime
+     || entry.crc1 != key->crc1 || entry.crc2 != key->crc2)
+        return 0;
+
+    memcpy(md5, entry.md5, 16);
+
+    /* most recently used entries are the last to be dropped */
+    if ((size_t)i != l_rom_cache.count - 1)
+    {
+        memmove(&l_rom_cache.entries[i], &l_rom_cache.entries[i + 1],
+                (l_rom_cache.count - i - 1) * sizeof(l_rom_cache.entries[0]));
+        l_rom_cache.entries[l_rom_cache.count - 1] = entry;
+        rom_cache_save();
+    }
+
+    return 1;
+}
+
+void rom_cache_store(const struct rom_cache_key* key, const md5_byte_t md5[16])
+{
+    int i;
+
+    if (strpbrk(key->path, "\r\n") != NULL)
+        return;
+
+    if (!l_rom_cache.loaded)
+        rom_cache_load();
+
+    i = rom_cache_find(key->path);
+    if (i >= 0)
+        rom_cache_drop((size_t)i);
+
+    rom_cache_add(key, md5);
+    rom_cache_save();
+}
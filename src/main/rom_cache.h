@@ -0,0 +1,54 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rom_cache.h                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_ROM_CACHE_H
+#define M64P_MAIN_ROM_CACHE_H
+
+#include <md5.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Remembers the MD5 of ROM files, so that opening them again doesn't
+ * require hashing the whole image.
+ *
+ * Entries are keyed by file path, size and modification time, and also
+ * hold the header CRCs as a last check against files replaced in place.
+ * They are stored as text lines in "romcache.txt" in the user cache
+ * directory, most recently used last:
+ *   md5 size mtime crc1 crc2 path
+ */
+
+struct rom_cache_key
+{
+    const char* path;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t crc1;
+    uint32_t crc2;
+};
+
+/* Returns 1 and fills md5 if the file is known, 0 otherwise */
+int rom_cache_lookup(const struct rom_cache_key* key, md5_byte_t md5[16]);
+
+void rom_cache_store(const struct rom_cache_key* key, const md5_byte_t md5[16]);
+
+#endif /* M64P_MAIN_ROM_CACHE_H */
@@ -0,0 +1,384 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rom_index.c                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "rom_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "osal/files.h"
+
+static const char rom_index_magic[8] = { 'M', '6', '4', 'P', 'R', 'D', 'B', '\0' };
+
+enum { ROM_INDEX_VERSION = 1 };
+enum { ROM_INDEX_HEADER_SIZE = 8 + 4 * 4 + 2 * 8 };
+enum { ROM_INDEX_RECORD_SIZE = 16 + 6 * 4 + 12 };
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >>  0);
+    p[1] = (unsigned char)(v >>  8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+    return ((uint32_t)p[0] <<  0)
+         | ((uint32_t)p[1] <<  8)
+         | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+static void put_u64(unsigned char* p, uint64_t v)
+{
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t get_u64(const unsigned char* p)
+{
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static uint32_t rom_index_md5_hash(const md5_byte_t md5[16])
+{
+    /* MD5s are already well distributed */
+    return get_u32(md5);
+}
+
+static uint32_t rom_index_crc_hash(uint32_t crc1, uint32_t crc2)
+{
+    uint32_t h = crc1 ^ (crc2 * UINT32_C(0x9E3779B1));
+    h ^= h >> 16;
+    h *= UINT32_C(0x85EBCA6B);
+    h ^= h >> 13;
+    return h;
+}
+
+/* Later entries replace earlier ones with the same key, like the ini
+ * parser did. */
+static void rom_index_insert(uint32_t* table, uint32_t mask, uint32_t hash, uint32_t i,
+                             const romdatabase_entry* entries, int by_md5)
+{
+    uint32_t slot = hash & mask;
+
+    while (table[slot] != 0)
+    {
+        const romdatabase_entry* other = &entries[table[slot] - 1];
+        const romdatabase_entry* entry = &entries[i];
+
+        if (by_md5 ? memcmp(other->md5, entry->md5, 16) == 0
+                   : (other->crc1 == entry->crc1 && other->crc2 == entry->crc2))
+            break;
+
+        slot = (slot + 1) & mask;
+    }
+
+    table[slot] = i + 1;
+}
+
+static const char* rom_index_string(const unsigned char* strings, uint32_t strings_size, uint32_t ref, int* valid)
+{
+    if (ref == 0)
+        return NULL;
+
+    if (ref > strings_size)
+    {
+        *valid = 0;
+        return NULL;
+    }
+
+    return (const char*)strings + ref - 1;
+}
+
+/* Decodes the serialized index and builds the lookup tables.
+ * Takes ownership of data, even on failure. */
+static int rom_index_attach(struct rom_index* index, const unsigned char* data, size_t size, int mapped,
+                            uint64_t ini_size, int64_t ini_mtime)
+{
+    const unsigned char* records;
+    const unsigned char* strings;
+    uint32_t count, strings_size, table_size, i;
+    int valid = 1;
+
+    memset(index, 0, sizeof(*index));
+    index->data = data;
+    index->size = size;
+    index->mapped = mapped;
+
+    if (size < ROM_INDEX_HEADER_SIZE
+     || memcmp(data, rom_index_magic, sizeof(rom_index_magic)) != 0
+     || get_u32(data + 8) != ROM_INDEX_VERSION
+     || get_u64(data + 24) != ini_size
+     || (int64_t)get_u64(data + 32) != ini_mtime)
+        goto fail;
+
+    count = get_u32(data + 12);
+    strings_size = get_u32(data + 16);
+
+    /* the string table must end with a nul so that every string is terminated */
+    if (count == 0 || count > (size - ROM_INDEX_HEADER_SIZE) / ROM_INDEX_RECORD_SIZE
+     || (uint64_t)ROM_INDEX_HEADER_SIZE + (uint64_t)count * ROM_INDEX_RECORD_SIZE + strings_size != size
+     || strings_size == 0 || data[size - 1] != '\0')
+        goto fail;
+
+    records = data + ROM_INDEX_HEADER_SIZE;
+    strings = records + (size_t)count * ROM_INDEX_RECORD_SIZE;
+
+    for (table_size = 16; table_size < 2 * count; table_size *= 2)
+        ;
+
+    index->count = count;
+    index->table_mask = table_size - 1;
+    index->entries = calloc(count, sizeof(index->entries[0]));
+    index->md5_table = calloc(table_size, sizeof(index->md5_table[0]));
+    index->crc_table = calloc(table_size, sizeof(index->crc_table[0]));
+    if (index->entries == NULL || index->md5_table == NULL || index->crc_table == NULL)
+        goto fail;
+
+    for (i = 0; i < count; ++i)
+    {
+        const unsigned char* r = records + (size_t)i * ROM_INDEX_RECORD_SIZE;
+        romdatabase_entry* entry = &index->entries[i];
+
+        memcpy(entry->md5, r, 16);
+        entry->crc1 = get_u32(r + 16);
+        entry->crc2 = get_u32(r + 20);
+        /* strings are never modified, the mapping is read-only */
+        entry->goodname = (char*)rom_index_string(strings, strings_size, get_u32(r + 24), &valid);
+        entry->cheats = (char*)rom_index_string(strings, strings_size, get_u32(r + 28), &valid);
+        entry->sidmaduration = get_u32(r + 32);
+        entry->set_flags = get_u32(r + 36);
+        entry->status = r[40];
+        entry->savetype = r[41];
+        entry->players = r[42];
+        entry->rumble = r[43];
+        entry->countperop = r[44];
+        entry->disableextramem = r[45];
+        entry->transferpak = r[46];
+        entry->mempak = r[47];
+        entry->biopak = r[48];
+        entry->refmd5 = NULL;
+
+        rom_index_insert(index->md5_table, index->table_mask, rom_index_md5_hash(entry->md5), i, index->entries, 1);
+        if (isset_bitmask(entry->set_flags, ROMDATABASE_ENTRY_CRC))
+            rom_index_insert(index->crc_table, index->table_mask, rom_index_crc_hash(entry->crc1, entry->crc2),
+                             i, index->entries, 0);
+    }
+
+    if (!valid)
+        goto fail;
+
+    return 0;
+
+fail:
+    rom_index_free(index);
+    return -1;
+}
+
+static uint32_t rom_index_add_string(unsigned char* strings, uint32_t* used, const char* s)
+{
+    size_t len;
+    uint32_t ref;
+
+    if (s == NULL)
+        return 0;
+
+    len = strlen(s) + 1;
+    memcpy(strings + *used, s, len);
+    ref = *used + 1;
+    *used += (uint32_t)len;
+
+    return ref;
+}
+
+int rom_index_build(struct rom_index* index, const romdatabase_search* list, uint64_t ini_size, int64_t ini_mtime)
+{
+    const romdatabase_search* search;
+    unsigned char* data;
+    unsigned char* r;
+    unsigned char* strings;
+    size_t size, strings_size = 1, count = 0;
+    uint32_t used = 0;
+
+    for (search = list; search != NULL; search = search->next_entry)
+    {
+        count++;
+        if (search->entry.goodname != NULL)
+            strings_size += strlen(search->entry.goodname) + 1;
+        if (search->entry.cheats != NULL)
+            strings_size += strlen(search->entry.cheats) + 1;
+    }
+
+    if (count == 0 || strings_size > UINT32_MAX)
+    {
+        memset(index, 0, sizeof(*index));
+        return -1;
+    }
+
+    size = ROM_INDEX_HEADER_SIZE + count * ROM_INDEX_RECORD_SIZE + strings_size;
+    data = calloc(1, size);
+    if (data == NULL)
+    {
+        memset(index, 0, sizeof(*index));
+        return -1;
+    }
+
+    memcpy(data, rom_index_magic, sizeof(rom_index_magic));
+    put_u32(data + 8, ROM_INDEX_VERSION);
+    put_u32(data + 12, (uint32_t)count);
+    put_u32(data + 16, (uint32_t)strings_size);
+    put_u64(data + 24, ini_size);
+    put_u64(data + 32, (uint64_t)ini_mtime);
+
+    r = data + ROM_INDEX_HEADER_SIZE;
+    strings = r + count * ROM_INDEX_RECORD_SIZE;
+
+    for (search = list; search != NULL; search = search->next_entry, r += ROM_INDEX_RECORD_SIZE)
+    {
+        const romdatabase_entry* entry = &search->entry;
+
+        memcpy(r, entry->md5, 16);
+        put_u32(r + 16, entry->crc1);
+        put_u32(r + 20, entry->crc2);
+        put_u32(r + 24, rom_index_add_string(strings, &used, entry->goodname));
+        put_u32(r + 28, rom_index_add_string(strings, &used, entry->cheats));
+        put_u32(r + 32, entry->sidmaduration);
+        put_u32(r + 36, entry->set_flags);
+        r[40] = entry->status;
+        r[41] = entry->savetype;
+        r[42] = entry->players;
+        r[43] = entry->rumble;
+        r[44] = entry->countperop;
+        r[45] = entry->disableextramem;
+        r[46] = entry->transferpak;
+        r[47] = entry->mempak;
+        r[48] = entry->biopak;
+    }
+    /* last byte of the string table stays 0 */
+
+    return rom_index_attach(index, data, size, 0, ini_size, ini_mtime);
+}
+
+int rom_index_load(struct rom_index* index, const char* filepath, uint64_t ini_size, int64_t ini_mtime)
+{
+    size_t size;
+    const unsigned char* data = osal_file_map(filepath, &size, NULL);
+
+    if (data == NULL)
+    {
+        memset(index, 0, sizeof(*index));
+        return -1;
+    }
+
+    return rom_index_attach(index, data, size, 1, ini_size, ini_mtime);
+}
+
+int rom_index_save(const struct rom_index* index, const char* filepath)
+{
+    /* another process may have the index mapped, so never rewrite it in place:
+     * write a new file next to it and replace the old one with it */
+    char* tmppath = malloc(strlen(filepath) + 5);
+    FILE* f;
+    int ret = 0;
+
+    if (tmppath == NULL)
+        return -1;
+
+    strcpy(tmppath, filepath);
+    strcat(tmppath, ".tmp");
+
+    f = fopen(tmppath, "wb");
+    if (f == NULL)
+    {
+        free(tmppath);
+        return -1;
+    }
+
+    if (fwrite(index->data, 1, index->size, f) != index->size)
+        ret = -1;
+
+    if (fclose(f) != 0)
+        ret = -1;
+
+    if (ret == 0 && osal_file_replace(tmppath, filepath) != 0)
+        ret = -1;
+
+    if (ret != 0)
+        remove(tmppath);
+
+    free(tmppath);
+    return ret;
+}
+
+void rom_index_free(struct rom_index* index)
+{
+    if (index->mapped)
+        osal_file_unmap(index->data, index->size);
+    else
+        free((void*)index->data);
+
+    free(index->entries);
+    free(index->md5_table);
+    free(index->crc_table);
+    memset(index, 0, sizeof(*index));
+}
+
+romdatabase_entry* rom_index_find_md5(const struct rom_index* index, const md5_byte_t md5[16])
+{
+    uint32_t slot;
+
+    if (index->count == 0)
+        return NULL;
+
+    for (slot = rom_index_md5_hash(md5) & index->table_mask; index->md5_table[slot] != 0;
+         slot = (slot + 1) & index->table_mask)
+    {
+        romdatabase_entry* entry = &index->entries[index->md5_table[slot] - 1];
+        if (memcmp(entry->md5, md5, 16) == 0)
+            return entry;
+    }
+
+    return NULL;
+}
+
+romdatabase_entry* rom_index_find_crc(const struct rom_index* index, uint32_t crc1, uint32_t crc2)
+{
+    uint32_t slot;
+
+    if (index->count == 0)
+        return NULL;
+
+    for (slot = rom_index_crc_hash(crc1, crc2) & index->table_mask; index->crc_table[slot] != 0;
+         slot = (slot + 1) & index->table_mask)
+    {
+        romdatabase_entry* entry = &index->entries[index->crc_table[slot] - 1];
+        if (entry->crc1 == crc1 && entry->crc2 == crc2)
+            return entry;
+    }
+
+    return NULL;
+}
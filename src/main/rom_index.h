@@ -0,0 +1,80 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rom_index.h                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_ROM_INDEX_H
+#define M64P_MAIN_ROM_INDEX_H
+
+#include <md5.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rom.h"
+
+/* Compiled form of the ROM database, which is saved in the user cache
+ * directory so that mupen64plus.ini doesn't have to be parsed (and its
+ * RefMD5s resolved) on each start.
+ *
+ * File layout (all integers are little endian):
+ *   header: "M64PRDB\0" magic, u32 version, u32 entry count,
+ *           u32 string table size, u32 reserved,
+ *           u64 size and i64 modification time of the source ini file
+ *   one 52 bytes record per entry:
+ *       md5[16], u32 crc1, u32 crc2, u32 goodname, u32 cheats,
+ *       u32 sidmaduration, u32 set_flags, u8 status, savetype, players,
+ *       rumble, countperop, disableextramem, transferpak, mempak, biopak,
+ *       3 bytes padding
+ *   string table: nul-terminated strings. goodname and cheats are offsets
+ *   in that table plus one, 0 meaning no string.
+ *
+ * The file is used in place once mapped: entries point to its strings.
+ * Lookups by MD5 and by CRC pair go through open addressing hash tables.
+ */
+
+struct rom_index
+{
+    const unsigned char* data;
+    size_t size;
+    int mapped;                     /* data is a file mapping, otherwise a heap block */
+
+    romdatabase_entry* entries;
+    uint32_t count;
+
+    uint32_t* md5_table;            /* entry index + 1, 0 for empty slots */
+    uint32_t* crc_table;
+    uint32_t table_mask;
+};
+
+/* Compile a resolved database. Returns 0 on success. */
+int rom_index_build(struct rom_index* index, const romdatabase_search* list, uint64_t ini_size, int64_t ini_mtime);
+
+/* Load a compiled database, which must have been built from an ini file
+ * of the given size and modification time. Returns 0 on success. */
+int rom_index_load(struct rom_index* index, const char* filepath, uint64_t ini_size, int64_t ini_mtime);
+
+int rom_index_save(const struct rom_index* index, const char* filepath);
+
+void rom_index_free(struct rom_index* index);
+
+romdatabase_entry* rom_index_find_md5(const struct rom_index* index, const md5_byte_t md5[16]);
+romdatabase_entry* rom_index_find_crc(const struct rom_index* index, uint32_t crc1, uint32_t crc2);
+
+#endif /* M64P_MAIN_ROM_INDEX_H */
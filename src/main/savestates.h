@@ -25,6 +25,11 @@
 #ifndef __SAVESTAVES_H__
 #define __SAVESTAVES_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
+struct device;
+
 typedef enum _savestates_job
 {
     savestates_job_nothing,
@@ -48,6 +53,38 @@ void savestates_deinit(void);
 int savestates_load(void);
 int savestates_save(void);
 
+/* In-memory m64p savestates (used by rewind) */
+size_t savestates_m64p_size(void);
+int savestates_save_m64p_mem(const struct device* dev, void *data, size_t size);
+int savestates_load_m64p_mem(struct device* dev, void *data, size_t size);
+
+/* Copies the bulk memory of the state (RDRAM and the TLB lookup tables) at
+ * its place in data, leaving the rest of the image untouched. Unlike
+ * savestates_save_m64p_mem, it doesn't walk the device state and may run on
+ * another thread while the emulation goes on, as long as the image is then
+ * brought up to date, the RDRAM writes made since the copy started being
+ * given in rdram_dirty and tlb_changed being set if the TLB lookup tables
+ * changed meanwhile.
+ * Returns 0 if size is too small or on big endian hosts, where the image
+ * can't be built this way. */
+int savestates_copy_m64p_bulk(const struct device* dev, void *data, size_t size);
+
+/* Incremental update of an image, in two steps so that only copies are made
+ * on the emulation thread.
+ * savestates_stage_m64p_mem writes in staging (savestates_m64p_size() bytes)
+ * the current content of the 4KB pages of the image which may have changed,
+ * and marks them in staged: the small serialized parts, the TLB lookup tables
+ * if tlb_changed (see tlb.generation) and the RDRAM 4KB blocks marked in
+ * rdram_dirty (all of them if NULL).
+ * savestates_update_m64p_mem then brings data, an image of the previous state,
+ * up to date without accessing the device. Each staged page which differs is
+ * marked in changed, and its previous content XOR its new one is left at the
+ * same offset in staging (the other pages of staging are left undefined).
+ * Returns the number of modified pages, or -1 if size is too small. */
+void savestates_stage_m64p_mem(const struct device* dev, void *staging, uint32_t *staged, int tlb_changed,
+                               const uint32_t *rdram_dirty);
+int savestates_update_m64p_mem(void *data, void *staging, const uint32_t *staged, uint32_t *changed, size_t size);
+
 void savestates_select_slot(unsigned int s);
 unsigned int savestates_get_slot(void);
 void savestates_set_autoinc_slot(int b);
@@ -35,6 +35,7 @@
 #include "main/main.h"
 #include "main/rom.h"
 #include "main/util.h"
+#include "main/workqueue.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
@@ -128,9 +129,57 @@ static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, i
     return 0;
 }
 
+/* screenshot file names are numbered from 000 to 999 for each ROM */
+enum { SCREENSHOT_MAX_INDEX = 1000 };
+
 static int CurrentShotIndex;
 
-static char *GetNextScreenshotPath(void)
+/* captures waiting for the encoder, beyond that captures are dropped */
+enum { SCREENSHOT_MAX_PENDING = 8 };
+
+/* bottom-up RGB24 frame to encode */
+struct screenshot_job
+{
+    struct work_struct work;
+    char *filename;
+    int width;
+    int height;
+    unsigned char pixels[];
+};
+
+static struct
+{
+    /* updated by the emulation thread */
+    unsigned int captured;
+    unsigned int dropped;
+    unsigned int skipped;
+    char *path;     /* "...-###.png", once the existing files were scanned */
+    unsigned int burst_interval;
+    unsigned int burst_remaining;
+    unsigned int burst_counter;
+
+    /* updated by the workers */
+    SDL_atomic_t pending;
+    SDL_atomic_t written;
+    SDL_atomic_t failed;
+} l_Screenshots;
+
+static void ScreenshotEncodeWork(struct work_struct *work)
+{
+    struct screenshot_job *job = list_entry(work, struct screenshot_job, work);
+
+    if (SaveRGBBufferToFile(job->filename, job->pixels, job->width, job->height, job->width * 3) == 0)
+        SDL_AtomicAdd(&l_Screenshots.written, 1);
+    else
+        SDL_AtomicAdd(&l_Screenshots.failed, 1);
+
+    free(job->filename);
+    free(job);
+
+    SDL_AtomicAdd(&l_Screenshots.pending, -1);
+}
+
+static char *GetScreenshotPathTemplate(void)
 {
     char *ScreenshotPath;
     char ScreenshotFileName[60 + 8 + 1];
@@ -184,23 +233,47 @@ static char *GetNextScreenshotPath(void)
             return NULL;
     }
 
-    // patch the number part of the name (the '###' part) until we find a free spot
-    char *NumberPtr = ScreenshotPath + strlen(ScreenshotPath) - 7;
-    for (; CurrentShotIndex < 1000; CurrentShotIndex++)
+    return ScreenshotPath;
+}
+
+static char *GetNextScreenshotPath(void)
+{
+    char *ScreenshotPath;
+    char *NumberPtr;
+
+    // the folder is only scanned for the first screenshot, the index is kept in memory afterwards
+    if (l_Screenshots.path == NULL)
     {
-        sprintf(NumberPtr, "%03i.png", CurrentShotIndex);
-        FILE *pFile = fopen(ScreenshotPath, "r");
-        if (pFile == NULL)
-            break;
-        fclose(pFile);
+        l_Screenshots.path = GetScreenshotPathTemplate();
+        if (l_Screenshots.path == NULL)
+            return NULL;
+
+        // patch the number part of the name (the '###' part) until we find a free spot
+        NumberPtr = l_Screenshots.path + strlen(l_Screenshots.path) - 7;
+        for (; CurrentShotIndex < SCREENSHOT_MAX_INDEX; CurrentShotIndex++)
+        {
+            sprintf(NumberPtr, "%03i.png", CurrentShotIndex);
+            FILE *pFile = fopen(l_Screenshots.path, "r");
+            if (pFile == NULL)
+                break;
+            fclose(pFile);
+        }
     }
 
-    if (CurrentShotIndex >= 1000)
+    if (CurrentShotIndex >= SCREENSHOT_MAX_INDEX)
     {
-        DebugMessage(M64MSG_ERROR, "Can't save screenshot; folder already contains 1000 screenshots for this ROM");
-        free(ScreenshotPath);
+        if (l_Screenshots.skipped++ == 0)
+            DebugMessage(M64MSG_ERROR, "Can't save screenshot; folder already contains 1000 screenshots for this ROM");
         return NULL;
     }
+
+    ScreenshotPath = (char *) malloc(strlen(l_Screenshots.path) + 1);
+    if (ScreenshotPath == NULL)
+        return NULL;
+    strcpy(ScreenshotPath, l_Screenshots.path);
+
+    NumberPtr = ScreenshotPath + strlen(ScreenshotPath) - 7;
+    sprintf(NumberPtr, "%03i.png", CurrentShotIndex);
     CurrentShotIndex++;
 
     return ScreenshotPath;
@@ -213,39 +286,129 @@ static char *GetNextScreenshotPath(void)
 void ScreenshotRomOpen(void)
 {
     CurrentShotIndex = 0;
+    free(l_Screenshots.path);
+    l_Screenshots.path = NULL;
+    l_Screenshots.captured = 0;
+    l_Screenshots.dropped = 0;
+    l_Screenshots.skipped = 0;
+    l_Screenshots.burst_remaining = 0;
+    SDL_AtomicSet(&l_Screenshots.written, 0);
+    SDL_AtomicSet(&l_Screenshots.failed, 0);
 }
 
+/* Grab the frame on the emulation thread, encode it on a worker */
 void TakeScreenshot(int iFrameNumber)
 {
     char *filename;
+    struct screenshot_job *job;
+    int width = 640;
+    int height = 480;
+    int i;
+
+    if (SDL_AtomicGet(&l_Screenshots.pending) >= SCREENSHOT_MAX_PENDING)
+    {
+        // the disk can't keep up, don't stall the emulation
+        l_Screenshots.dropped++;
+        return;
+    }
+
+    // the frame decoded from RDRAM is top-down, the video plugin one bottom-up
+    unsigned int scanout_width, scanout_height;
+    const unsigned char *scanout = main_scanout_frame(&scanout_width, &scanout_height);
+    if (scanout != NULL)
+    {
+        width = (int)scanout_width;
+        height = (int)scanout_height;
+    }
+    else
+    {
+        gfx.readScreen(NULL, &width, &height, 0);
+    }
+
+    if (width <= 0 || height <= 0)
+        return;
 
     // look for an unused screenshot filename
     filename = GetNextScreenshotPath();
     if (filename == NULL)
         return;
 
-    // get the width and height
-    int width = 640;
-    int height = 480;
-    gfx.readScreen(NULL, &width, &height, 0);
-
-    // allocate memory for the image
-    unsigned char *pucFrame = (unsigned char *) malloc(width * height * 3);
-    if (pucFrame == NULL)
+    job = (struct screenshot_job *) malloc(sizeof(*job) + (size_t)width * height * 3);
+    if (job == NULL)
     {
         free(filename);
         return;
     }
 
-    // grab the back image from OpenGL by calling the video plugin
-    gfx.readScreen(pucFrame, &width, &height, 0);
+    if (scanout != NULL)
+    {
+        for (i = 0; i < height; i++)
+            memcpy(job->pixels + (size_t)i * width * 3, scanout + (size_t)(height - 1 - i) * width * 3, (size_t)width * 3);
+    }
+    else
+    {
+        // grab the back image from OpenGL by calling the video plugin
+        gfx.readScreen(job->pixels, &width, &height, 0);
+    }
+
+    init_work(&job->work, ScreenshotEncodeWork);
+    job->filename = filename;
+    job->width = width;
+    job->height = height;
+
+    l_Screenshots.captured++;
+    SDL_AtomicAdd(&l_Screenshots.pending, 1);
+    queue_work_prio(&job->work, WORK_PRIO_LOW);
 
-    // write the image to a PNG
-    SaveRGBBufferToFile(filename, pucFrame, width, height, width * 3);
-    // free the memory
-    free(pucFrame);
-    free(filename);
     // print message -- this allows developers to capture frames and use them in the regression test
-    main_message(M64MSG_INFO, OSD_BOTTOM_LEFT, "Captured screenshot for frame %i.", iFrameNumber);
+    if (l_Screenshots.burst_remaining == 0)
+        main_message(M64MSG_INFO, OSD_BOTTOM_LEFT, "Captured screenshot for frame %i.", iFrameNumber);
+}
+
+m64p_error ScreenshotBurst(const m64p_screenshot_burst *burst)
+{
+    if (burst == NULL)
+    {
+        l_Screenshots.burst_remaining = 0;
+        return M64ERR_SUCCESS;
+    }
+
+    if (burst->interval == 0 || burst->count == 0)
+        return M64ERR_INPUT_INVALID;
+
+    l_Screenshots.burst_interval = burst->interval;
+    l_Screenshots.burst_remaining = burst->count;
+    l_Screenshots.burst_counter = 0;
+
+    main_message(M64MSG_INFO, OSD_BOTTOM_LEFT, "Capturing %u screenshots, one every %u VIs.", burst->count, burst->interval);
+    return M64ERR_SUCCESS;
+}
+
+int ScreenshotBurstNewVI(void)
+{
+    if (l_Screenshots.burst_remaining == 0)
+        return 0;
+
+    if (l_Screenshots.burst_counter++ % l_Screenshots.burst_interval != 0)
+        return 0;
+
+    l_Screenshots.burst_remaining--;
+    return 1;
+}
+
+void ScreenshotFlush(void)
+{
+    if (SDL_AtomicGet(&l_Screenshots.pending) > 0)
+        flush_workqueue();
+}
+
+void ScreenshotGetStats(m64p_screenshot_stats *stats)
+{
+    stats->captured = l_Screenshots.captured;
+    stats->written = (unsigned int) SDL_AtomicGet(&l_Screenshots.written);
+    stats->dropped = l_Screenshots.dropped;
+    stats->skipped = l_Screenshots.skipped;
+    stats->failed = (unsigned int) SDL_AtomicGet(&l_Screenshots.failed);
+    stats->pending = (unsigned int) SDL_AtomicGet(&l_Screenshots.pending);
 }
 
@@ -22,7 +22,18 @@
 #ifndef M64P_MAIN_SCREENSHOT_H
 #define M64P_MAIN_SCREENSHOT_H
 
+#include "api/m64p_types.h"
+
 void ScreenshotRomOpen(void);
 void TakeScreenshot(int iFrameNumber);
 
+/* Take a screenshot every burst->interval VIs, burst->count times (NULL stops) */
+m64p_error ScreenshotBurst(const m64p_screenshot_burst *burst);
+/* Returns 1 when a burst screenshot is due */
+int ScreenshotBurstNewVI(void);
+
+/* Wait for the pending screenshots to be written */
+void ScreenshotFlush(void);
+void ScreenshotGetStats(m64p_screenshot_stats *stats);
+
 #endif
@@ -0,0 +1,284 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - state_container.c                                       *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "state_container.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+
+static const char state_container_magic[STATE_CONTAINER_MAGIC_SIZE] = { 'M', '6', '4', '+', 'C', 'H', 'N', 'K' };
+
+enum { STATE_CONTAINER_HEADER_SIZE = STATE_CONTAINER_MAGIC_SIZE + 2 * 4 };
+enum { STATE_SECTION_ENTRY_SIZE = 7 * 4 };
+
+/* don't trust TOC from corrupted files */
+enum { STATE_CONTAINER_MAX_SECTIONS = 256 };
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >>  0);
+    p[1] = (unsigned char)(v >>  8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+    return ((uint32_t)p[0] <<  0)
+         | ((uint32_t)p[1] <<  8)
+         | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+static void put_section_entry(unsigned char* p, const struct state_section* section)
+{
+    put_u32(p +  0, section->id);
+    put_u32(p +  4, section->version);
+    put_u32(p +  8, section->compression);
+    put_u32(p + 12, section->offset);
+    put_u32(p + 16, section->stored_size);
+    put_u32(p + 20, section->size);
+    put_u32(p + 24, section->crc);
+}
+
+static void get_section_entry(const unsigned char* p, struct state_section* section)
+{
+    section->id          = get_u32(p +  0);
+    section->version     = get_u32(p +  4);
+    section->compression = get_u32(p +  8);
+    section->offset      = get_u32(p + 12);
+    section->stored_size = get_u32(p + 16);
+    section->size        = get_u32(p + 20);
+    section->crc         = get_u32(p + 24);
+}
+
+int state_container_check_magic(const void* data, size_t size)
+{
+    return (size >= STATE_CONTAINER_MAGIC_SIZE)
+        && (memcmp(data, state_container_magic, STATE_CONTAINER_MAGIC_SIZE) == 0);
+}
+
+int state_container_write(const char* filepath, const struct state_section_data* sections, size_t count)
+{
+    FILE* f;
+    size_t i;
+    size_t toc_size = count * STATE_SECTION_ENTRY_SIZE;
+    unsigned char* toc = NULL;
+    unsigned char* scratch = NULL;
+    size_t scratch_size = 0;
+    uint32_t offset;
+    unsigned char header[STATE_CONTAINER_HEADER_SIZE];
+    int ret = -1;
+
+    f = fopen(filepath, "wb");
+    if (f == NULL)
+        return -1;
+
+    toc = calloc(1, toc_size);
+    if (toc == NULL)
+        goto cleanup;
+
+    memcpy(header, state_container_magic, STATE_CONTAINER_MAGIC_SIZE);
+    put_u32(header + STATE_CONTAINER_MAGIC_SIZE, STATE_CONTAINER_VERSION);
+    put_u32(header + STATE_CONTAINER_MAGIC_SIZE + 4, (uint32_t)count);
+
+    /* TOC is written again once the section offsets and sizes are known */
+    if (fwrite(header, 1, sizeof(header), f) != sizeof(header)
+     || fwrite(toc, 1, toc_size, f) != toc_size)
+        goto cleanup;
+
+    offset = (uint32_t)(sizeof(header) + toc_size);
+
+    for (i = 0; i < count; ++i) {
+        struct state_section section;
+        uLongf csize = compressBound((uLong)sections[i].size);
+        const void* payload;
+
+        if (csize > scratch_size) {
+            unsigned char* p = realloc(scratch, csize);
+            if (p == NULL)
+                goto cleanup;
+            scratch = p;
+            scratch_size = csize;
+        }
+
+        section.id = sections[i].id;
+        section.version = sections[i].version;
+        section.offset = offset;
+        section.size = (uint32_t)sections[i].size;
+        section.crc = (uint32_t)crc32(crc32(0L, Z_NULL, 0), sections[i].data, (uInt)sections[i].size);
+
+        if (compress2(scratch, &csize, sections[i].data, (uLong)sections[i].size, Z_DEFAULT_COMPRESSION) == Z_OK
+         && csize < sections[i].size) {
+            section.compression = STATE_COMPRESSION_ZLIB;
+            section.stored_size = (uint32_t)csize;
+            payload = scratch;
+        }
+        else {
+            section.compression = STATE_COMPRESSION_NONE;
+            section.stored_size = (uint32_t)sections[i].size;
+            payload = sections[i].data;
+        }
+
+        if (fwrite(payload, 1, section.stored_size, f) != section.stored_size)
+            goto cleanup;
+
+        put_section_entry(toc + i * STATE_SECTION_ENTRY_SIZE, &section);
+        offset += section.stored_size;
+    }
+
+    if (fseek(f, sizeof(header), SEEK_SET) != 0
+     || fwrite(toc, 1, toc_size, f) != toc_size)
+        goto cleanup;
+
+    ret = 0;
+
+cleanup:
+    if (fclose(f) != 0)
+        ret = -1;
+    free(scratch);
+    free(toc);
+    return ret;
+}
+
+int state_container_open(struct state_container* container, const char* filepath)
+{
+    unsigned char header[STATE_CONTAINER_HEADER_SIZE];
+    unsigned char* toc = NULL;
+    size_t toc_size;
+    uint32_t i;
+
+    memset(container, 0, sizeof(*container));
+
+    container->f = fopen(filepath, "rb");
+    if (container->f == NULL)
+        return -1;
+
+    if (fread(header, 1, sizeof(header), container->f) != sizeof(header)
+     || !state_container_check_magic(header, sizeof(header))) {
+        DebugMessage(M64MSG_ERROR, "%s is not a savestate container", filepath);
+        goto fail;
+    }
+
+    container->version = get_u32(header + STATE_CONTAINER_MAGIC_SIZE);
+    container->count = get_u32(header + STATE_CONTAINER_MAGIC_SIZE + 4);
+
+    if (container->version > STATE_CONTAINER_VERSION) {
+        DebugMessage(M64MSG_ERROR, "Savestate container version %u isn't supported", container->version);
+        goto fail;
+    }
+
+    if (container->count > STATE_CONTAINER_MAX_SECTIONS) {
+        DebugMessage(M64MSG_ERROR, "Corrupted savestate container table of contents");
+        goto fail;
+    }
+
+    toc_size = container->count * STATE_SECTION_ENTRY_SIZE;
+    toc = malloc(toc_size);
+    container->sections = malloc(container->count * sizeof(container->sections[0]));
+    if ((toc_size > 0 && toc == NULL) || (container->count > 0 && container->sections == NULL))
+        goto fail;
+
+    if (fread(toc, 1, toc_size, container->f) != toc_size) {
+        DebugMessage(M64MSG_ERROR, "Could not read savestate container table of contents");
+        goto fail;
+    }
+
+    for (i = 0; i < container->count; ++i) {
+        get_section_entry(toc + i * STATE_SECTION_ENTRY_SIZE, &container->sections[i]);
+    }
+
+    free(toc);
+    return 0;
+
+fail:
+    free(toc);
+    state_container_close(container);
+    return -1;
+}
+
+void state_container_close(struct state_container* container)
+{
+    if (container->f != NULL)
+        fclose(container->f);
+
+    free(container->sections);
+    memset(container, 0, sizeof(*container));
+}
+
+const struct state_section* state_container_find(const struct state_container* container, uint32_t id)
+{
+    uint32_t i;
+
+    for (i = 0; i < container->count; ++i) {
+        if (container->sections[i].id == id)
+            return &container->sections[i];
+    }
+
+    return NULL;
+}
+
+int state_container_read(struct state_container* container, const struct state_section* section, void* dst)
+{
+    unsigned char* stored;
+    uLongf size = section->size;
+    int ret = -1;
+
+    if (fseek(container->f, (long)section->offset, SEEK_SET) != 0)
+        return -1;
+
+    if (section->compression == STATE_COMPRESSION_NONE) {
+        if (section->stored_size != section->size
+         || fread(dst, 1, section->size, container->f) != section->size)
+            return -1;
+    }
+    else if (section->compression == STATE_COMPRESSION_ZLIB) {
+        stored = malloc(section->stored_size);
+        if (stored == NULL)
+            return -1;
+
+        if (fread(stored, 1, section->stored_size, container->f) == section->stored_size
+         && uncompress(dst, &size, stored, section->stored_size) == Z_OK
+         && size == section->size) {
+            ret = 0;
+        }
+
+        free(stored);
+        if (ret != 0)
+            return -1;
+    }
+    else {
+        return -1;
+    }
+
+    if ((uint32_t)crc32(crc32(0L, Z_NULL, 0), dst, section->size) != section->crc) {
+        DebugMessage(M64MSG_ERROR, "Savestate section %c%c%c%c has a bad checksum",
+                     (char)(section->id >> 0), (char)(section->id >> 8),
+                     (char)(section->id >> 16), (char)(section->id >> 24));
+        return -1;
+    }
+
+    return 0;
+}
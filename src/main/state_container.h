@@ -0,0 +1,95 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - state_container.h                                       *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_STATE_CONTAINER_H
+#define M64P_MAIN_STATE_CONTAINER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Chunked savestate container.
+ *
+ * File layout (all integers are little endian):
+ *   header: "M64+CHNK" magic, u32 container version, u32 section count
+ *   table of contents, one 28 bytes entry per section:
+ *       u32 id, u32 version, u32 compression, u32 offset, u32 stored size, u32 size, u32 crc32
+ *   section payloads
+ *
+ * Each section is compressed on its own and carries its own version and
+ * a crc32 of its uncompressed content, so that a single section can be
+ * read without decoding the whole file.
+ */
+
+enum { STATE_CONTAINER_VERSION = 1 };
+enum { STATE_CONTAINER_MAGIC_SIZE = 8 };
+
+#define STATE_SECTION_ID(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+enum state_section_compression
+{
+    STATE_COMPRESSION_NONE = 0,
+    STATE_COMPRESSION_ZLIB = 1
+};
+
+struct state_section
+{
+    uint32_t id;
+    uint32_t version;
+    uint32_t compression;
+    uint32_t offset;
+    uint32_t stored_size;
+    uint32_t size;
+    uint32_t crc;
+};
+
+/* section content to write */
+struct state_section_data
+{
+    uint32_t id;
+    uint32_t version;
+    const void* data;
+    size_t size;
+};
+
+struct state_container
+{
+    FILE* f;
+    uint32_t version;
+    uint32_t count;
+    struct state_section* sections;
+};
+
+int state_container_check_magic(const void* data, size_t size);
+
+int state_container_write(const char* filepath, const struct state_section_data* sections, size_t count);
+
+int state_container_open(struct state_container* container, const char* filepath);
+void state_container_close(struct state_container* container);
+
+const struct state_section* state_container_find(const struct state_container* container, uint32_t id);
+
+/* Decompress a section into dst (which must hold section->size bytes)
+ * and verify its checksum. */
+int state_container_read(struct state_container* container, const struct state_section* section, void* dst);
+
+#endif /* M64P_MAIN_STATE_CONTAINER_H */
@@ -43,6 +43,25 @@
 #include "rom.h"
 #include "util.h"
 
+/* SSE2 is part of x86-64, SSSE3 and AVX2 kernels are picked at runtime */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SWAP_SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SWAP_TARGET(isa) __attribute__((target(isa)))
+#define SWAP_X86_DISPATCH
+#elif defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#define SWAP_TARGET(isa)
+#define SWAP_X86_DISPATCH
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SWAP_NEON
+#endif
+
 /**********************
      File utilities
  **********************/
@@ -184,29 +203,209 @@ close_file:
 /**********************
    Byte swap utilities
  **********************/
-void swap_buffer(void *buffer, size_t length, size_t count)
+/* The vector kernels swap as many whole vectors as possible and return
+ * the number of bytes done, the scalar loop takes care of the remainder.
+ * src and dst may be the same buffer, but must not partially overlap. */
+typedef size_t (*swap_kernel)(void *dst, const void *src, size_t size, size_t length);
+
+#if defined(SWAP_SSE2)
+static size_t swap_sse2(void *dst, const void *src, size_t size, size_t length)
+{
+    size_t i;
+    const __m128i *s = (const __m128i *) src;
+    __m128i *d = (__m128i *) dst;
+
+    for (i = 0; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(s++);
+
+        /* reverse the half-words of each element, then the bytes of each half-word */
+        if (length == 8)
+            v = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+        if (length >= 4)
+        {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+        _mm_storeu_si128(d++, v);
+    }
+
+    return i;
+}
+#endif
+
+#if defined(SWAP_X86_DISPATCH)
+static const uint8_t swap_masks[3][16] = {
+    { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+    { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+    { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 }
+};
+
+static const uint8_t *swap_mask(size_t length)
+{
+    return swap_masks[(length == 2) ? 0 : (length == 4) ? 1 : 2];
+}
+
+SWAP_TARGET("ssse3")
+static size_t swap_ssse3(void *dst, const void *src, size_t size, size_t length)
+{
+    size_t i;
+    const __m128i *s = (const __m128i *) src;
+    __m128i *d = (__m128i *) dst;
+    const __m128i mask = _mm_loadu_si128((const __m128i *) swap_mask(length));
+
+    for (i = 0; i + 16 <= size; i += 16)
+        _mm_storeu_si128(d++, _mm_shuffle_epi8(_mm_loadu_si128(s++), mask));
+
+    return i;
+}
+
+SWAP_TARGET("avx2")
+static size_t swap_avx2(void *dst, const void *src, size_t size, size_t length)
+{
+    size_t i;
+    const __m256i *s = (const __m256i *) src;
+    __m256i *d = (__m256i *) dst;
+    /* the shuffle works within each 128-bit lane */
+    const __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) swap_mask(length)));
+
+    for (i = 0; i + 64 <= size; i += 64)
+    {
+        __m256i v0 = _mm256_loadu_si256(s++);
+        __m256i v1 = _mm256_loadu_si256(s++);
+        _mm256_storeu_si256(d++, _mm256_shuffle_epi8(v0, mask));
+        _mm256_storeu_si256(d++, _mm256_shuffle_epi8(v1, mask));
+    }
+
+    return i + swap_ssse3((uint8_t *) dst + i, (const uint8_t *) src + i, size - i, length);
+}
+
+static int swap_has_ssse3(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+static int swap_has_avx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+    /* the OS must also save the YMM registers */
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+        return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#if defined(SWAP_NEON)
+static size_t swap_neon(void *dst, const void *src, size_t size, size_t length)
 {
     size_t i;
+    const uint8_t *s = (const uint8_t *) src;
+    uint8_t *d = (uint8_t *) dst;
+
+    for (i = 0; i + 16 <= size; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(s + i);
+        if (length == 2)
+            v = vrev16q_u8(v);
+        else if (length == 4)
+            v = vrev32q_u8(v);
+        else
+            v = vrev64q_u8(v);
+        vst1q_u8(d + i, v);
+    }
+
+    return i;
+}
+#endif
+
+#if !defined(SWAP_SSE2) && !defined(SWAP_NEON)
+static size_t swap_none(void *dst, const void *src, size_t size, size_t length)
+{
+    return 0;
+}
+#endif
+
+#if defined(SWAP_SSE2)
+#define SWAP_BASELINE_KERNEL swap_sse2
+#elif defined(SWAP_NEON)
+#define SWAP_BASELINE_KERNEL swap_neon
+#else
+#define SWAP_BASELINE_KERNEL swap_none
+#endif
+
+/* only written by swap_init(), before other threads use it */
+static swap_kernel l_swap_kernel = SWAP_BASELINE_KERNEL;
+
+static swap_kernel swap_select_kernel(void)
+{
+#if defined(SWAP_X86_DISPATCH)
+    if (swap_has_avx2())
+        return swap_avx2;
+    if (swap_has_ssse3())
+        return swap_ssse3;
+#endif
+    return SWAP_BASELINE_KERNEL;
+}
+
+void swap_init(void)
+{
+    l_swap_kernel = swap_select_kernel();
+}
+
+void swap_copy_buffer(void *dst, const void *src, size_t length, size_t count)
+{
+    size_t i, done;
+
+    if (length != 2 && length != 4 && length != 8)
+        return;
+
+    done = l_swap_kernel(dst, src, length * count, length) / length;
+
     if (length == 2)
     {
-        uint16_t *pun = (uint16_t *) buffer;
-        for (i = 0; i < count; i++)
-            pun[i] = m64p_swap16(pun[i]);
+        const uint16_t *s = (const uint16_t *) src;
+        uint16_t *d = (uint16_t *) dst;
+        for (i = done; i < count; i++)
+            d[i] = m64p_swap16(s[i]);
     }
     else if (length == 4)
     {
-        uint32_t *pun = (uint32_t *) buffer;
-        for (i = 0; i < count; i++)
-            pun[i] = m64p_swap32(pun[i]);
+        const uint32_t *s = (const uint32_t *) src;
+        uint32_t *d = (uint32_t *) dst;
+        for (i = done; i < count; i++)
+            d[i] = m64p_swap32(s[i]);
     }
-    else if (length == 8)
+    else
     {
-        uint64_t *pun = (uint64_t *) buffer;
-        for (i = 0; i < count; i++)
-            pun[i] = m64p_swap64(pun[i]);
+        const uint64_t *s = (const uint64_t *) src;
+        uint64_t *d = (uint64_t *) dst;
+        for (i = done; i < count; i++)
+            d[i] = m64p_swap64(s[i]);
     }
 }
 
+void swap_buffer(void *buffer, size_t length, size_t count)
+{
+    swap_copy_buffer(buffer, buffer, length, count);
+}
+
 void to_little_endian_buffer(void *buffer, size_t length, size_t count)
 {
 #if defined(M64P_BIG_ENDIAN)
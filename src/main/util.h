@@ -36,6 +36,8 @@
 #define ATTR_FMT(fmtpos, attrpos)
 #endif
 
+#define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
+
 /**********************
      File utilities
  **********************/
@@ -138,9 +140,15 @@ static osal_inline unsigned long long int m64p_swap64(unsigned long long int x)
 #define little64(x) (x)
 #endif
 
+/* Picks the byte swap kernels for the host CPU. Called once at core startup,
+ * before other threads use the functions below. */
+void swap_init(void);
 /* Byte swaps, converts to little endian or converts to big endian a buffer,
  * containing 'count' elements, each of size 'length'. */
 void swap_buffer(void *buffer, size_t length, size_t count);
+/* Same as swap_buffer, writing the swapped elements to dst.
+ * dst may be src, but the buffers must not otherwise overlap. */
+void swap_copy_buffer(void *dst, const void *src, size_t length, size_t count);
 void to_little_endian_buffer(void *buffer, size_t length, size_t count);
 void to_big_endian_buffer(void *buffer, size_t length, size_t count);
 
@@ -27,8 +27,8 @@
 #define MUPEN_CORE_NAME "Mupen64Plus Core"
 #define MUPEN_CORE_VERSION 0x020509
 
-#define FRONTEND_API_VERSION 0x020103
-#define CONFIG_API_VERSION   0x020301
+#define FRONTEND_API_VERSION 0x020111
+#define CONFIG_API_VERSION   0x020400
 #define DEBUG_API_VERSION    0x020001
 #define VIDEXT_API_VERSION   0x030200
 #define NETPLAY_API_VERSION  0x010000
@@ -1,5 +1,5 @@
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- *   Mupen64plus - util.h                                                  *
+ *   Mupen64plus - workqueue.c                                             *
  *   Mupen64Plus homepage: https://mupen64plus.org/                        *
  *   Copyright (C) 2012 Mupen64plus development team                       *
  *                                                                         *
@@ -31,51 +31,122 @@
 #include "api/m64p_types.h"
 #include "main/list.h"
 
-#define WORKQUEUE_THREADS 1
+#define WORKQUEUE_MAX_THREADS 8
 
-struct workqueue_mgmt_globals {
-    struct list_head work_queue;
-    struct list_head thread_queue;
-    struct list_head thread_list;
+/* Each worker owns one deque per priority level. Submitters push at the tail,
+ * the owner pops from the head and idle workers steal from the tail of the
+ * other workers deques.
+ *
+ * Lock ordering: workqueue_thread.lock, then workqueue_mgmt.lock
+ */
+struct workqueue_thread {
+    SDL_Thread *thread;
+    unsigned long id;
     SDL_mutex *lock;
+    struct list_head deque[WORK_PRIO_COUNT];
+    struct work_struct *current;
 };
 
-struct workqueue_thread {
-    SDL_Thread *thread;
+struct workqueue_mgmt_globals {
+    struct workqueue_thread *threads;
+    size_t thread_count;
+    size_t next_thread;
+    unsigned int pending;
+    int shutdown;
+    SDL_mutex *lock;
     SDL_cond *work_avail;
-    struct list_head list;
-    struct list_head list_mgmt;
+    SDL_cond *work_done;
 };
 
 static struct workqueue_mgmt_globals workqueue_mgmt;
 
-static void workqueue_dismiss(struct work_struct *work)
+static size_t workqueue_thread_count(void)
+{
+    int cpus = 1;
+
+#if SDL_VERSION_ATLEAST(2,0,0)
+    cpus = SDL_GetCPUCount();
+#endif
+
+    /* leave one core for the emulation thread */
+    --cpus;
+
+    if (cpus < 1)
+        cpus = 1;
+    if (cpus > WORKQUEUE_MAX_THREADS)
+        cpus = WORKQUEUE_MAX_THREADS;
+
+    return (size_t)cpus;
+}
+
+/* must be called with workqueue_mgmt.lock held */
+static struct workqueue_thread *workqueue_current_thread(void)
 {
+    size_t i;
+    unsigned long id = (unsigned long)SDL_ThreadID();
+
+    for (i = 0; i < workqueue_mgmt.thread_count; i++) {
+        if (workqueue_mgmt.threads[i].thread != NULL && workqueue_mgmt.threads[i].id == id)
+            return &workqueue_mgmt.threads[i];
+    }
+
+    return NULL;
+}
+
+/* Takes work of the given priority from the deque of victim.
+ * Owner takes the oldest work, thieves the most recent one. */
+static struct work_struct *workqueue_take_work(struct workqueue_thread *self, struct workqueue_thread *victim, size_t prio)
+{
+    struct list_head *deque = &victim->deque[prio];
+    struct work_struct *work = NULL;
+
+    SDL_LockMutex(victim->lock);
+    if (!list_empty(deque)) {
+        work = (self == victim)
+            ? list_entry(deque->next, struct work_struct, list)
+            : list_entry(deque->prev, struct work_struct, list);
+        list_del_init(&work->list);
+
+        SDL_LockMutex(workqueue_mgmt.lock);
+        work->queue = NULL;
+        workqueue_mgmt.pending--;
+        self->current = work;
+        SDL_UnlockMutex(workqueue_mgmt.lock);
+    }
+    SDL_UnlockMutex(victim->lock);
+
+    return work;
 }
 
 static struct work_struct *workqueue_get_work(struct workqueue_thread *thread)
 {
-    int found = 0;
+    size_t i, idx, prio;
     struct work_struct *work;
 
+    idx = (size_t)(thread - workqueue_mgmt.threads);
+
     for (;;) {
+        /* one priority level at a time: own work first, then steal from the
+         * others, before looking at the lower levels */
+        for (prio = 0; prio < WORK_PRIO_COUNT; prio++) {
+            for (i = 0; i < workqueue_mgmt.thread_count; i++) {
+                work = workqueue_take_work(thread, &workqueue_mgmt.threads[(idx + i) % workqueue_mgmt.thread_count], prio);
+                if (work != NULL)
+                    return work;
+            }
+        }
+
+        /* nothing to do, sleep until some work gets queued */
         SDL_LockMutex(workqueue_mgmt.lock);
-        list_del_init(&thread->list);
-        if (!list_empty(&workqueue_mgmt.work_queue)) {
-            found = 1;
-            work = list_first_entry(&workqueue_mgmt.work_queue, struct work_struct, list);
-            list_del_init(&work->list);
-        } else {
-            list_add(&thread->list, &workqueue_mgmt.thread_queue);
-	        SDL_CondWait(thread->work_avail, workqueue_mgmt.lock);
+        while (workqueue_mgmt.pending == 0 && !workqueue_mgmt.shutdown)
+            SDL_CondWait(workqueue_mgmt.work_avail, workqueue_mgmt.lock);
+
+        if (workqueue_mgmt.pending == 0 && workqueue_mgmt.shutdown) {
+            SDL_UnlockMutex(workqueue_mgmt.lock);
+            return NULL;
         }
         SDL_UnlockMutex(workqueue_mgmt.lock);
-
-        if (found)
-            break;
     }
-
-    return work;
 }
 
 static int workqueue_thread_handler(void *data)
@@ -83,53 +154,74 @@ static int workqueue_thread_handler(void *data)
     struct workqueue_thread *thread = data;
     struct work_struct *work;
 
-    for (;;) {
-        work = workqueue_get_work(thread);
-        if (work->func == workqueue_dismiss) {
-            free(work);
-            break;
-        }
+    SDL_LockMutex(workqueue_mgmt.lock);
+    thread->id = (unsigned long)SDL_ThreadID();
+    SDL_UnlockMutex(workqueue_mgmt.lock);
 
+    while ((work = workqueue_get_work(thread)) != NULL) {
+        /* work may be freed by its function, don't touch it afterwards */
         work->func(work);
+
+        SDL_LockMutex(workqueue_mgmt.lock);
+        thread->current = NULL;
+        SDL_CondBroadcast(workqueue_mgmt.work_done);
+        SDL_UnlockMutex(workqueue_mgmt.lock);
     }
 
     return 0;
 }
 
-int workqueue_init(void)
+static int workqueue_is_running(const struct work_struct *work)
 {
     size_t i;
+
+    for (i = 0; i < workqueue_mgmt.thread_count; i++) {
+        if (workqueue_mgmt.threads[i].current == work)
+            return 1;
+    }
+
+    return 0;
+}
+
+int workqueue_init(void)
+{
+    size_t i, prio;
     struct workqueue_thread *thread;
 
     memset(&workqueue_mgmt, 0, sizeof(workqueue_mgmt));
-    INIT_LIST_HEAD(&workqueue_mgmt.work_queue);
-    INIT_LIST_HEAD(&workqueue_mgmt.thread_queue);
-    INIT_LIST_HEAD(&workqueue_mgmt.thread_list);
 
     workqueue_mgmt.lock = SDL_CreateMutex();
-    if (!workqueue_mgmt.lock) {
+    workqueue_mgmt.work_avail = SDL_CreateCond();
+    workqueue_mgmt.work_done = SDL_CreateCond();
+    if (!workqueue_mgmt.lock || !workqueue_mgmt.work_avail || !workqueue_mgmt.work_done) {
         DebugMessage(M64MSG_ERROR, "Could not create workqueue management");
         return -1;
     }
 
-    SDL_LockMutex(workqueue_mgmt.lock);
-    for (i = 0; i < WORKQUEUE_THREADS; i++) {
-        thread = malloc(sizeof(*thread));
-        if (!thread) {
-            DebugMessage(M64MSG_ERROR, "Could not create workqueue thread management data");
-            SDL_UnlockMutex(workqueue_mgmt.lock);
-            return -1;
-        }
+    workqueue_mgmt.thread_count = workqueue_thread_count();
+    workqueue_mgmt.threads = calloc(workqueue_mgmt.thread_count, sizeof(*workqueue_mgmt.threads));
+    if (!workqueue_mgmt.threads) {
+        DebugMessage(M64MSG_ERROR, "Could not create workqueue thread management data");
+        workqueue_mgmt.thread_count = 0;
+        return -1;
+    }
 
-        memset(thread, 0, sizeof(*thread));
-        list_add(&thread->list_mgmt, &workqueue_mgmt.thread_list);
-        INIT_LIST_HEAD(&thread->list);
-        thread->work_avail = SDL_CreateCond();
-        if (!thread->work_avail) {
-            DebugMessage(M64MSG_ERROR, "Could not create workqueue thread work_avail condition");
-            SDL_UnlockMutex(workqueue_mgmt.lock);
+    for (i = 0; i < workqueue_mgmt.thread_count; i++) {
+        thread = &workqueue_mgmt.threads[i];
+
+        for (prio = 0; prio < WORK_PRIO_COUNT; prio++)
+            INIT_LIST_HEAD(&thread->deque[prio]);
+
+        thread->lock = SDL_CreateMutex();
+        if (!thread->lock) {
+            DebugMessage(M64MSG_ERROR, "Could not create workqueue thread lock");
             return -1;
         }
+    }
+
+    /* start workers only once every deque is ready to be stolen from */
+    for (i = 0; i < workqueue_mgmt.thread_count; i++) {
+        thread = &workqueue_mgmt.threads[i];
 
 #if SDL_VERSION_ATLEAST(2,0,0)
         thread->thread = SDL_CreateThread(workqueue_thread_handler, "m64pwq", thread);
@@ -138,11 +230,11 @@ int workqueue_init(void)
 #endif
         if (!thread->thread) {
             DebugMessage(M64MSG_ERROR, "Could not create workqueue thread handler");
-            SDL_UnlockMutex(workqueue_mgmt.lock);
             return -1;
         }
     }
-    SDL_UnlockMutex(workqueue_mgmt.lock);
+
+    DebugMessage(M64MSG_VERBOSE, "Workqueue started with %u threads", (unsigned int)workqueue_mgmt.thread_count);
 
     return 0;
 }
@@ -151,41 +243,135 @@ void workqueue_shutdown(void)
 {
     size_t i;
     int status;
-    struct work_struct *work;
-    struct workqueue_thread *thread, *safe;
 
-    for (i = 0; i < WORKQUEUE_THREADS; i++) {
-        work = malloc(sizeof(*work));
-        init_work(work, workqueue_dismiss);
-        queue_work(work);
-    }
+    if (workqueue_mgmt.threads == NULL)
+        return;
+
+    /* workers exit once all pending work has been executed */
+    SDL_LockMutex(workqueue_mgmt.lock);
+    workqueue_mgmt.shutdown = 1;
+    SDL_CondBroadcast(workqueue_mgmt.work_avail);
+    SDL_UnlockMutex(workqueue_mgmt.lock);
 
-    list_for_each_entry_safe_t(thread, safe, &workqueue_mgmt.thread_list, struct workqueue_thread, list_mgmt) {
-        list_del(&thread->list_mgmt);
-        SDL_WaitThread(thread->thread, &status);
-        SDL_DestroyCond(thread->work_avail);
-        free(thread);
+    for (i = 0; i < workqueue_mgmt.thread_count; i++) {
+        if (workqueue_mgmt.threads[i].thread != NULL)
+            SDL_WaitThread(workqueue_mgmt.threads[i].thread, &status);
     }
 
-    if (!list_empty(&workqueue_mgmt.work_queue))
+    if (workqueue_mgmt.pending != 0)
         DebugMessage(M64MSG_WARNING, "Stopped workqueue with work still pending");
 
+    for (i = 0; i < workqueue_mgmt.thread_count; i++) {
+        if (workqueue_mgmt.threads[i].lock != NULL)
+            SDL_DestroyMutex(workqueue_mgmt.threads[i].lock);
+    }
+
+    free(workqueue_mgmt.threads);
+    SDL_DestroyCond(workqueue_mgmt.work_done);
+    SDL_DestroyCond(workqueue_mgmt.work_avail);
     SDL_DestroyMutex(workqueue_mgmt.lock);
+    memset(&workqueue_mgmt, 0, sizeof(workqueue_mgmt));
+}
+
+int queue_work_prio(struct work_struct *work, enum work_priority prio)
+{
+    struct workqueue_thread *thread;
+
+    if (workqueue_mgmt.thread_count == 0) {
+        work->func(work);
+        return 0;
+    }
+
+    if ((unsigned int)prio >= WORK_PRIO_COUNT)
+        prio = WORK_PRIO_NORMAL;
+
+    /* work queued from a worker stays local, the other workers will steal it if idle */
+    SDL_LockMutex(workqueue_mgmt.lock);
+    thread = workqueue_current_thread();
+    if (thread == NULL) {
+        thread = &workqueue_mgmt.threads[workqueue_mgmt.next_thread];
+        workqueue_mgmt.next_thread = (workqueue_mgmt.next_thread + 1) % workqueue_mgmt.thread_count;
+    }
+    SDL_UnlockMutex(workqueue_mgmt.lock);
+
+    SDL_LockMutex(thread->lock);
+    list_add_tail(&work->list, &thread->deque[prio]);
+
+    SDL_LockMutex(workqueue_mgmt.lock);
+    work->queue = thread;
+    workqueue_mgmt.pending++;
+    SDL_CondSignal(workqueue_mgmt.work_avail);
+    SDL_UnlockMutex(workqueue_mgmt.lock);
+    SDL_UnlockMutex(thread->lock);
+
+    return 0;
 }
 
 int queue_work(struct work_struct *work)
+{
+    return queue_work_prio(work, WORK_PRIO_NORMAL);
+}
+
+int cancel_work(struct work_struct *work)
 {
     struct workqueue_thread *thread;
 
+    for (;;) {
+        SDL_LockMutex(workqueue_mgmt.lock);
+        thread = work->queue;
+        SDL_UnlockMutex(workqueue_mgmt.lock);
+
+        if (thread == NULL)
+            return 0;
+
+        SDL_LockMutex(thread->lock);
+        SDL_LockMutex(workqueue_mgmt.lock);
+        /* work may have been taken meanwhile */
+        if (work->queue == thread) {
+            list_del_init(&work->list);
+            work->queue = NULL;
+            workqueue_mgmt.pending--;
+            SDL_CondBroadcast(workqueue_mgmt.work_done);
+            SDL_UnlockMutex(workqueue_mgmt.lock);
+            SDL_UnlockMutex(thread->lock);
+            return 1;
+        }
+        SDL_UnlockMutex(workqueue_mgmt.lock);
+        SDL_UnlockMutex(thread->lock);
+    }
+}
+
+void flush_work(struct work_struct *work)
+{
+    SDL_LockMutex(workqueue_mgmt.lock);
+    while (work->queue != NULL || workqueue_is_running(work))
+        SDL_CondWait(workqueue_mgmt.work_done, workqueue_mgmt.lock);
+    SDL_UnlockMutex(workqueue_mgmt.lock);
+}
+
+void flush_workqueue(void)
+{
+    size_t i;
+    int busy;
+
     SDL_LockMutex(workqueue_mgmt.lock);
-    list_add_tail(&work->list, &workqueue_mgmt.work_queue);
-    if (!list_empty(&workqueue_mgmt.thread_queue)) {
-        thread = list_first_entry(&workqueue_mgmt.thread_queue, struct workqueue_thread, list);
-        list_del_init(&thread->list);
+    for (;;) {
+        busy = (workqueue_mgmt.pending != 0);
+        for (i = 0; i < workqueue_mgmt.thread_count; i++)
+            busy |= (workqueue_mgmt.threads[i].current != NULL);
+
+        if (!busy)
+            break;
 
-        SDL_CondSignal(thread->work_avail);
+        SDL_CondWait(workqueue_mgmt.work_done, workqueue_mgmt.lock);
     }
     SDL_UnlockMutex(workqueue_mgmt.lock);
+}
 
-    return 0;
+void workqueue_fork_child(void)
+{
+    /* the locks and conditions of the parent are leaked on purpose,
+     * their state in the child is undefined */
+    free(workqueue_mgmt.threads);
+    memset(&workqueue_mgmt, 0, sizeof(workqueue_mgmt));
 }
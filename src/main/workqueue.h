@@ -1,5 +1,5 @@
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- *   Mupen64plus - util.h                                                  *
+ *   Mupen64plus - workqueue.h                                             *
  *   Mupen64Plus homepage: https://mupen64plus.org/                        *
  *   Copyright (C) 2012 Mupen64plus development team                       *
  *                                                                         *
@@ -26,17 +26,30 @@
 #include "osal/preproc.h"
 
 struct work_struct;
+struct workqueue_thread;
+
+/* Work items queued with a higher priority are picked up before any work of
+ * a lower priority, whichever worker they were queued on. */
+enum work_priority {
+    WORK_PRIO_HIGH,
+    WORK_PRIO_NORMAL,
+    WORK_PRIO_LOW,
+    WORK_PRIO_COUNT
+};
 
 typedef void (*work_func_t)(struct work_struct *work);
 struct work_struct {
     work_func_t func;
     struct list_head list;
+    /* worker deque the work is currently queued on (NULL if not queued) */
+    struct workqueue_thread *queue;
 };
 
 static osal_inline void init_work(struct work_struct *work, work_func_t func)
 {
     INIT_LIST_HEAD(&work->list);
     work->func = func;
+    work->queue = NULL;
 }
 
 #ifdef M64P_PARALLEL
@@ -44,6 +57,22 @@ static osal_inline void init_work(struct work_struct *work, work_func_t func)
 int workqueue_init(void);
 void workqueue_shutdown(void);
 int queue_work(struct work_struct *work);
+int queue_work_prio(struct work_struct *work, enum work_priority prio);
+
+/* Removes a queued work before it gets executed.
+ * Returns 1 if the work was removed, 0 if it was not queued (anymore). */
+int cancel_work(struct work_struct *work);
+
+/* Waits until the work is neither queued nor running.
+ * The work must not free itself and this must not be called from a work function. */
+void flush_work(struct work_struct *work);
+
+/* Waits until every queued work has been executed. */
+void flush_workqueue(void);
+
+/* To be called in a forked child process, where the worker threads don't exist.
+ * Work is then executed synchronously. The workqueue must be flushed before forking. */
+void workqueue_fork_child(void);
 
 #else
 
@@ -62,6 +91,29 @@ static osal_inline int queue_work(struct work_struct *work)
     return 0;
 }
 
+static osal_inline int queue_work_prio(struct work_struct *work, enum work_priority prio)
+{
+    work->func(work);
+    return 0;
+}
+
+static osal_inline int cancel_work(struct work_struct *work)
+{
+    return 0;
+}
+
+static osal_inline void flush_work(struct work_struct *work)
+{
+}
+
+static osal_inline void flush_workqueue(void)
+{
+}
+
+static osal_inline void workqueue_fork_child(void)
+{
+}
+
 #endif
 
 #endif
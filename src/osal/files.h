@@ -26,6 +26,9 @@
 #if !defined (OSAL_FILES_H)
 #define OSAL_FILES_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /* some file-related preprocessor definitions */
 #if defined(WIN32) && !defined(__MINGW32__)
   #include <io.h> // For _unlink()
@@ -57,5 +60,31 @@ extern const char * osal_get_user_configpath(void);
 extern const char * osal_get_user_datapath(void);
 extern const char * osal_get_user_cachepath(void);
 
+/* Map a whole file read-only in memory.
+ * Returns NULL on failure, otherwise the file size is stored in *size
+ * and, if mtime isn't NULL, its modification time in *mtime.
+ * The mapping must be released with osal_file_unmap().
+ */
+extern const void * osal_file_map(const char *filepath, size_t *size, int64_t *mtime);
+extern void osal_file_unmap(const void *data, size_t size);
+
+/* Get the size and modification time of a regular file, using the same time
+ * base as osal_file_map(). Returns zero on success, nonzero on failure.
+ * Modification times have the finest resolution the system provides
+ * (nanoseconds on POSIX systems, 100 nanoseconds on Windows).
+ */
+extern int osal_file_info(const char *filepath, uint64_t *size, int64_t *mtime);
+
+/* Replace dstpath by srcpath, which must be in the same directory, so that
+ * readers see either the old or the new file. Returns zero on success.
+ */
+extern int osal_file_replace(const char *srcpath, const char *dstpath);
+
+/* Store the absolute, canonical form of filepath in fullpath, which must hold
+ * PATH_MAX characters, so that one file is always named the same way.
+ * Returns zero on success, nonzero on failure.
+ */
+extern int osal_file_fullpath(const char *filepath, char *fullpath);
+
 #endif /* OSAL_FILES_H */
 
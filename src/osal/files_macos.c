@@ -29,6 +29,8 @@
 #include <sysdir.h>
 #include <pwd.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -223,3 +225,63 @@ const char * osal_get_user_cachepath(void)
     return osal_get_user_configpath();
 }
 
+/* modification time in nanoseconds */
+static int64_t stat_mtime(const struct stat *fileinfo)
+{
+    return (int64_t)fileinfo->st_mtimespec.tv_sec * 1000000000 + fileinfo->st_mtimespec.tv_nsec;
+}
+
+const void * osal_file_map(const char *filepath, size_t *size, int64_t *mtime)
+{
+    struct stat fileinfo;
+    void *data;
+    int fd;
+
+    fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &fileinfo) != 0 || !S_ISREG(fileinfo.st_mode) || fileinfo.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    /* the mapping stays valid after the descriptor is closed */
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+#if defined(MADV_SEQUENTIAL)
+    madvise(data, (size_t)fileinfo.st_size, MADV_SEQUENTIAL);
+#endif
+
+    *size = (size_t)fileinfo.st_size;
+    if (mtime != NULL)
+        *mtime = stat_mtime(&fileinfo);
+    return data;
+}
+
+void osal_file_unmap(const void *data, size_t size)
+{
+    if (data != NULL)
+        munmap((void *)data, size);
+}
+
+int osal_file_info(const char *filepath, uint64_t *size, int64_t *mtime)
+{
+    struct stat fileinfo;
+
+    if (stat(filepath, &fileinfo) != 0 || !S_ISREG(fileinfo.st_mode))
+        return 1;
+
+    *size = (uint64_t)fileinfo.st_size;
+    *mtime = stat_mtime(&fileinfo);
+    return 0;
+}
+
+int osal_file_replace(const char *srcpath, const char *dstpath)
+{
+    return rename(srcpath, dstpath);
+}
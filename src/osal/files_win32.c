@@ -204,4 +204,70 @@ const char * osal_get_user_cachepath(void)
     return osal_get_user_configpath();
 }
 
+const void * osal_file_map(const char *filepath, size_t *size, int64_t *mtime)
+{
+    HANDLE file, mapping;
+    LARGE_INTEGER filesize;
+    FILETIME filetime;
+    void *data;
+
+    file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (!GetFileSizeEx(file, &filesize) || filesize.QuadPart <= 0 || (ULONGLONG)filesize.QuadPart > (SIZE_T)-1
+     || !GetFileTime(file, NULL, NULL, &filetime))
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return NULL;
+
+    /* the view keeps the mapping object alive */
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL)
+        return NULL;
+
+    *size = (size_t)filesize.QuadPart;
+    if (mtime != NULL)
+        *mtime = (int64_t)(((uint64_t)filetime.dwHighDateTime << 32) | filetime.dwLowDateTime);
+    return data;
+}
+
+void osal_file_unmap(const void *data, size_t size)
+{
+    (void)size;
+
+    if (data != NULL)
+        UnmapViewOfFile(data);
+}
 
+int osal_file_info(const char *filepath, uint64_t *size, int64_t *mtime)
+{
+    WIN32_FILE_ATTRIBUTE_DATA fileinfo;
+
+    if (!GetFileAttributesExA(filepath, GetFileExInfoStandard, &fileinfo)
+     || (fileinfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return 1;
+
+    *size = ((uint64_t)fileinfo.nFileSizeHigh << 32) | fileinfo.nFileSizeLow;
+    *mtime = (int64_t)(((uint64_t)fileinfo.ftLastWriteTime.dwHighDateTime << 32) | fileinfo.ftLastWriteTime.dwLowDateTime);
+    return 0;
+}
+
+int osal_file_replace(const char *srcpath, const char *dstpath)
+{
+    /* unlike rename(), this replaces an existing file */
+    return MoveFileExA(srcpath, dstpath, MOVEFILE_REPLACE_EXISTING) ? 0 : 1;
+}
+
+int osal_file_fullpath(const char *filepath, char *fullpath)
+{
+    return (_fullpath(fullpath, filepath, PATH_MAX) != NULL) ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-core - osal/write_watch.h                                 *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* This file contains the declarations of the OS-dependent tracking of the
+ * writes to a memory region, based on the host memory protection.
+ */
+
+#if !defined (OSAL_WRITE_WATCH_H)
+#define OSAL_WRITE_WATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Starts tracking the writes to [base, base + size), every page of the region
+ * being clean. Only one region can be watched at a time. The first write to a
+ * clean page is caught by a fault handler, which marks the page as written and
+ * lets the write go on. Writes performed by the kernel on behalf of the process
+ * (e.g. read() into the region) fail instead of being tracked.
+ * Returns zero on success, nonzero if unsupported or on failure.
+ */
+extern int osal_write_watch_start(void *base, size_t size);
+
+/* Stops tracking, leaving the whole region writable. */
+extern void osal_write_watch_stop(void);
+
+/* Sets in bitmap (one bit per block of block_size bytes from the start of the
+ * region, block_size being a power of two) the blocks written since the
+ * previous call or since the start, then makes every page clean again.
+ * The partial pages at both ends of the region can't be protected and are
+ * always reported as written. bitmap may be NULL to only reset the pages.
+ */
+extern void osal_write_watch_collect(uint32_t *bitmap, size_t block_size);
+
+#endif /* #define OSAL_WRITE_WATCH_H */
+
@@ -0,0 +1,176 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-core - osal/write_watch_unix.c                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* This file contains the definitions of the write tracking for unix-like
+ * systems, using mprotect() and a SIGSEGV/SIGBUS handler.
+ */
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "write_watch.h"
+
+static struct
+{
+    int active;
+    uintptr_t base;         /* first protected byte, page aligned */
+    uintptr_t end;          /* past the last protected byte, page aligned */
+    size_t offset;          /* of base in the watched region */
+    size_t size;            /* of the watched region */
+    size_t page_size;
+    uint32_t *written;      /* one bit per protected page */
+    struct sigaction old_segv;
+    struct sigaction old_bus;
+} l_watch;
+
+static void write_watch_chain(int sig, siginfo_t *info, void *context)
+{
+    const struct sigaction *old = (sig == SIGBUS) ? &l_watch.old_bus : &l_watch.old_segv;
+
+    if (old->sa_flags & SA_SIGINFO) {
+        old->sa_sigaction(sig, info, context);
+    }
+    else if (old->sa_handler != SIG_DFL && old->sa_handler != SIG_IGN) {
+        old->sa_handler(sig);
+    }
+    else {
+        /* the faulting instruction runs again with the default action */
+        signal(sig, SIG_DFL);
+    }
+}
+
+static void write_watch_handler(int sig, siginfo_t *info, void *context)
+{
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    size_t page;
+
+    if (!l_watch.active || addr < l_watch.base || addr >= l_watch.end) {
+        write_watch_chain(sig, info, context);
+        return;
+    }
+
+    page = (addr - l_watch.base) / l_watch.page_size;
+    __sync_fetch_and_or(&l_watch.written[page / 32], UINT32_C(1) << (page % 32));
+    mprotect((void *)(l_watch.base + page * l_watch.page_size), l_watch.page_size, PROT_READ | PROT_WRITE);
+}
+
+int osal_write_watch_start(void *base, size_t size)
+{
+    struct sigaction sa;
+    long page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)base;
+    size_t pages;
+
+    if (l_watch.active || page_size <= 0)
+        return -1;
+
+    memset(&l_watch, 0, sizeof(l_watch));
+    l_watch.page_size = (size_t)page_size;
+    l_watch.base = (start + l_watch.page_size - 1) & ~(uintptr_t)(l_watch.page_size - 1);
+    l_watch.end = (start + size) & ~(uintptr_t)(l_watch.page_size - 1);
+    if (l_watch.end <= l_watch.base)
+        return -1;
+
+    l_watch.offset = (size_t)(l_watch.base - start);
+    l_watch.size = size;
+    pages = (l_watch.end - l_watch.base) / l_watch.page_size;
+    l_watch.written = calloc((pages + 31) / 32, sizeof(uint32_t));
+    if (l_watch.written == NULL)
+        return -1;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = write_watch_handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+
+    /* some systems raise SIGBUS for protected pages */
+    if (sigaction(SIGSEGV, &sa, &l_watch.old_segv) != 0) {
+        free(l_watch.written);
+        return -1;
+    }
+    if (sigaction(SIGBUS, &sa, &l_watch.old_bus) != 0) {
+        sigaction(SIGSEGV, &l_watch.old_segv, NULL);
+        free(l_watch.written);
+        return -1;
+    }
+
+    l_watch.active = 1;
+    if (mprotect((void *)l_watch.base, l_watch.end - l_watch.base, PROT_READ) != 0) {
+        osal_write_watch_stop();
+        return -1;
+    }
+
+    return 0;
+}
+
+void osal_write_watch_stop(void)
+{
+    if (!l_watch.active)
+        return;
+
+    mprotect((void *)l_watch.base, l_watch.end - l_watch.base, PROT_READ | PROT_WRITE);
+    l_watch.active = 0;
+    sigaction(SIGBUS, &l_watch.old_bus, NULL);
+    sigaction(SIGSEGV, &l_watch.old_segv, NULL);
+    free(l_watch.written);
+    l_watch.written = NULL;
+}
+
+/* Marks the blocks overlapping [start, end) of the region */
+static void write_watch_mark(uint32_t *bitmap, size_t block_size, size_t start, size_t end)
+{
+    size_t block;
+
+    for (block = start / block_size; block * block_size < end; ++block)
+        bitmap[block / 32] |= UINT32_C(1) << (block % 32);
+}
+
+void osal_write_watch_collect(uint32_t *bitmap, size_t block_size)
+{
+    size_t page, pages, end;
+    uint32_t written;
+
+    if (!l_watch.active)
+        return;
+
+    /* the pages are cleared before being protected again: a write in between
+     * from another thread is not tracked, like any write racing with the reader */
+    pages = (l_watch.end - l_watch.base) / l_watch.page_size;
+    for (page = 0; page < pages; page += 32) {
+        written = __sync_fetch_and_and(&l_watch.written[page / 32], 0);
+
+        for (; written != 0 && bitmap != NULL; written &= written - 1) {
+            size_t start = l_watch.offset + (page + (size_t)__builtin_ctz(written)) * l_watch.page_size;
+            write_watch_mark(bitmap, block_size, start, start + l_watch.page_size);
+        }
+    }
+
+    mprotect((void *)l_watch.base, l_watch.end - l_watch.base, PROT_READ);
+
+    if (bitmap != NULL) {
+        end = l_watch.offset + (l_watch.end - l_watch.base);
+        write_watch_mark(bitmap, block_size, 0, l_watch.offset);
+        write_watch_mark(bitmap, block_size, end, l_watch.size);
+    }
+}
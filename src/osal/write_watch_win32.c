@@ -0,0 +1,166 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-core - osal/write_watch_win32.c                           *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* This file contains the definitions of the write tracking for Windows,
+ * using VirtualProtect() and a vectored exception handler.
+ */
+
+#include <windows.h>
+#include <intrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "write_watch.h"
+
+static struct
+{
+    volatile LONG active;
+    uintptr_t base;         /* first protected byte, page aligned */
+    uintptr_t end;          /* past the last protected byte, page aligned */
+    size_t offset;          /* of base in the watched region */
+    size_t size;            /* of the watched region */
+    size_t page_size;
+    volatile LONG *written; /* one bit per protected page */
+    PVOID handler;
+} l_watch;
+
+static LONG CALLBACK write_watch_handler(PEXCEPTION_POINTERS info)
+{
+    const EXCEPTION_RECORD *record = info->ExceptionRecord;
+    uintptr_t addr;
+    size_t page;
+    DWORD old;
+
+    /* ExceptionInformation[0] is 1 for a write access */
+    if (!l_watch.active
+     || record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION
+     || record->NumberParameters < 2
+     || record->ExceptionInformation[0] != 1)
+        return EXCEPTION_CONTINUE_SEARCH;
+
+    addr = (uintptr_t)record->ExceptionInformation[1];
+    if (addr < l_watch.base || addr >= l_watch.end)
+        return EXCEPTION_CONTINUE_SEARCH;
+
+    page = (addr - l_watch.base) / l_watch.page_size;
+    _InterlockedOr(&l_watch.written[page / 32], (LONG)(1u << (page % 32)));
+    VirtualProtect((void *)(l_watch.base + page * l_watch.page_size), l_watch.page_size, PAGE_READWRITE, &old);
+
+    return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+int osal_write_watch_start(void *base, size_t size)
+{
+    SYSTEM_INFO si;
+    uintptr_t start = (uintptr_t)base;
+    size_t pages;
+    DWORD old;
+
+    if (l_watch.active)
+        return -1;
+
+    GetSystemInfo(&si);
+
+    memset((void *)&l_watch, 0, sizeof(l_watch));
+    l_watch.page_size = (size_t)si.dwPageSize;
+    l_watch.base = (start + l_watch.page_size - 1) & ~(uintptr_t)(l_watch.page_size - 1);
+    l_watch.end = (start + size) & ~(uintptr_t)(l_watch.page_size - 1);
+    if (l_watch.end <= l_watch.base)
+        return -1;
+
+    l_watch.offset = (size_t)(l_watch.base - start);
+    l_watch.size = size;
+    pages = (l_watch.end - l_watch.base) / l_watch.page_size;
+    l_watch.written = calloc((pages + 31) / 32, sizeof(LONG));
+    if (l_watch.written == NULL)
+        return -1;
+
+    l_watch.handler = AddVectoredExceptionHandler(1, write_watch_handler);
+    if (l_watch.handler == NULL) {
+        free((void *)l_watch.written);
+        return -1;
+    }
+
+    l_watch.active = 1;
+    if (!VirtualProtect((void *)l_watch.base, l_watch.end - l_watch.base, PAGE_READONLY, &old)) {
+        osal_write_watch_stop();
+        return -1;
+    }
+
+    return 0;
+}
+
+void osal_write_watch_stop(void)
+{
+    DWORD old;
+
+    if (!l_watch.active)
+        return;
+
+    VirtualProtect((void *)l_watch.base, l_watch.end - l_watch.base, PAGE_READWRITE, &old);
+    l_watch.active = 0;
+    RemoveVectoredExceptionHandler(l_watch.handler);
+    free((void *)l_watch.written);
+    l_watch.written = NULL;
+}
+
+/* Marks the blocks overlapping [start, end) of the region */
+static void write_watch_mark(uint32_t *bitmap, size_t block_size, size_t start, size_t end)
+{
+    size_t block;
+
+    for (block = start / block_size; block * block_size < end; ++block)
+        bitmap[block / 32] |= UINT32_C(1) << (block % 32);
+}
+
+void osal_write_watch_collect(uint32_t *bitmap, size_t block_size)
+{
+    size_t page, pages, end;
+    uint32_t written;
+    unsigned long bit;
+    DWORD old;
+
+    if (!l_watch.active)
+        return;
+
+    /* the pages are cleared before being protected again: a write in between
+     * from another thread is not tracked, like any write racing with the reader */
+    pages = (l_watch.end - l_watch.base) / l_watch.page_size;
+    for (page = 0; page < pages; page += 32) {
+        written = (uint32_t)_InterlockedExchange(&l_watch.written[page / 32], 0);
+
+        for (; written != 0 && bitmap != NULL; written &= written - 1) {
+            size_t start;
+
+            _BitScanForward(&bit, written);
+            start = l_watch.offset + (page + bit) * l_watch.page_size;
+            write_watch_mark(bitmap, block_size, start, start + l_watch.page_size);
+        }
+    }
+
+    VirtualProtect((void *)l_watch.base, l_watch.end - l_watch.base, PAGE_READONLY, &old);
+
+    if (bitmap != NULL) {
+        end = l_watch.offset + (l_watch.end - l_watch.base);
+        write_watch_mark(bitmap, block_size, 0, l_watch.offset);
+        write_watch_mark(bitmap, block_size, end, l_watch.size);
+    }
+}
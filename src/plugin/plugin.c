@@ -24,10 +24,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define M64P_CORE_PROTOTYPES 1
 #include "api/callbacks.h"
+#include "api/config.h"
 #include "api/m64p_common.h"
+#include "api/m64p_config.h"
 #include "api/m64p_plugin.h"
 #include "api/m64p_types.h"
+#include "backends/plugins_compat/plugins_compat.h"
 #include "device/memory/memory.h"
 #include "device/rcp/ai/ai_controller.h"
 #include "device/rcp/mi/mi_controller.h"
@@ -332,6 +336,10 @@ static m64p_error plugin_connect_audio(m64p_dynlib_handle plugin_handle)
             return M64ERR_INCOMPATIBLE;
         }
 
+        /* set function pointers for optional functions */
+        if (APIVersion >= 0x20100)
+            audio.aiGetQueuedBytes = (ptr_AiGetQueuedBytes)osal_dynlib_getproc(plugin_handle, "AiGetQueuedBytes");
+
         l_AudioAttached = 1;
     }
     else
@@ -355,6 +363,21 @@ static m64p_error plugin_start_audio(void)
     audio_info.AI_BITRATE_REG = &(g_dev.ai.regs[AI_BITRATE_REG]);
     audio_info.CheckInterrupts = EmptyFunc;
 
+    /* samples are pushed from the audio thread or resampled by the core,
+     * give the plugin its own registers and memory */
+    g_audio_plugin_shadow.enabled = ConfigGetParamBool(g_CoreConfig, "AudioThread")
+                                 || ConfigGetParamInt(g_CoreConfig, "AudioResampleRate") > 0;
+    if (g_audio_plugin_shadow.enabled)
+    {
+        g_audio_plugin_shadow.regs[AI_CONTROL_REG] = 1; /* DMA enabled */
+        audio_info.RDRAM = g_audio_plugin_shadow.ram;
+        audio_info.AI_DRAM_ADDR_REG = &(g_audio_plugin_shadow.regs[AI_DRAM_ADDR_REG]);
+        audio_info.AI_LEN_REG = &(g_audio_plugin_shadow.regs[AI_LEN_REG]);
+        audio_info.AI_CONTROL_REG = &(g_audio_plugin_shadow.regs[AI_CONTROL_REG]);
+        audio_info.AI_DACRATE_REG = &(g_audio_plugin_shadow.regs[AI_DACRATE_REG]);
+        audio_info.AI_BITRATE_REG = &(g_audio_plugin_shadow.regs[AI_BITRATE_REG]);
+    }
+
     /* call the audio plugin */
     if (!audio.initiateAudio(audio_info))
         return M64ERR_PLUGIN_FAIL;
@@ -574,3 +597,20 @@ m64p_error plugin_check(void)
     return M64ERR_SUCCESS;
 }
 
+int plugin_attached(m64p_plugin_type type)
+{
+    switch (type)
+    {
+        case M64PLUGIN_GFX:
+            return l_GfxAttached;
+        case M64PLUGIN_AUDIO:
+            return l_AudioAttached;
+        case M64PLUGIN_INPUT:
+            return l_InputAttached;
+        case M64PLUGIN_RSP:
+            return l_RspAttached;
+        default:
+            return 0;
+    }
+}
+
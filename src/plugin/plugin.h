@@ -30,6 +30,7 @@
 extern m64p_error plugin_connect(m64p_plugin_type, m64p_dynlib_handle plugin_handle);
 extern m64p_error plugin_start(m64p_plugin_type);
 extern m64p_error plugin_check(void);
+extern int plugin_attached(m64p_plugin_type type);
 
 enum { NUM_CONTROLLER = 4 };
 extern CONTROL Controls[NUM_CONTROLLER];
@@ -37,7 +38,7 @@ extern CONTROL Controls[NUM_CONTROLLER];
 /*** Version requirement information ***/
 #define RSP_API_VERSION   0x20000
 #define GFX_API_VERSION   0x20200
-#define AUDIO_API_VERSION 0x20000
+#define AUDIO_API_VERSION 0x20100
 #define INPUT_API_VERSION 0x20100
 
 /* video plugin function pointers */
@@ -84,6 +85,7 @@ typedef struct _audio_plugin_functions
 	ptr_VolumeSetLevel    volumeSetLevel;
 	ptr_VolumeMute        volumeMute;
 	ptr_VolumeGetString   volumeGetString;
+	ptr_AiGetQueuedBytes  aiGetQueuedBytes; /* optional */
 } audio_plugin_functions;
 
 extern audio_plugin_functions audio;
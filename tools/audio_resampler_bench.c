@@ -0,0 +1,194 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - audio_resampler_bench.c                                    *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/* Throughput benchmark of the core audio resampler. Also checks that the
+ * SIMD float to int16 conversion gives the same samples as the scalar one.
+ *
+ * From the root of the source tree:
+ *   gcc -O2 -Isrc -o audio_resampler_bench tools/audio_resampler_bench.c -lm
+ *   ./audio_resampler_bench [input rate] [output rate] [seconds of audio]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* the conversion kernels are static */
+#include "backends/audio_out_resampler.c"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* typical AI DMA: 1/60th of a second of 32kHz audio */
+#define CHUNK_FRAMES 533
+
+static void null_set_format(void* aout, unsigned int frequency, unsigned int bits) { }
+static void null_push_samples(void* aout, const void* samples, size_t size) { }
+static int null_get_queued_duration(void* aout, uint64_t* duration) { return 0; }
+
+static const struct audio_out_backend_interface null_backend =
+{
+    null_set_format,
+    null_push_samples,
+    null_get_queued_duration
+};
+
+static const char* quality_names[] = { "linear", "sinc-16", "sinc-64" };
+
+/* Returns the number of values converted differently by the two kernels */
+static unsigned int check_conversion(void)
+{
+    enum { COUNT = 4 * 65536 + 16 };
+    static const float limits[16] = {
+        32766.5f, 32767.0f, 32767.49f, 32767.5f, 32768.0f, 40000.0f, 3e9f, 1e30f,
+        -32767.5f, -32768.0f, -32768.49f, -32768.5f, -32769.0f, -40000.0f, -3e9f, -1e30f
+    };
+    float* in = malloc(COUNT * sizeof(float));
+    int16_t* simd = malloc(COUNT * sizeof(int16_t));
+    int16_t* scalar = malloc(COUNT * sizeof(int16_t));
+    unsigned int errors = 0;
+    size_t i;
+
+    if (in == NULL || simd == NULL || scalar == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    /* every half and quarter step of the int16 range, then the clamping limits */
+    for (i = 0; i < COUNT - 16; ++i)
+        in[i] = (float)((int)i - 2 * 65536) * 0.25f;
+    for (i = 0; i < 16; ++i)
+        in[COUNT - 16 + i] = limits[i];
+
+    to_samples_simd(in, simd, COUNT);
+    to_samples_scalar(in, scalar, COUNT);
+
+    for (i = 0; i < COUNT; ++i) {
+        if (simd[i] != scalar[i])
+            errors++;
+    }
+
+    free(in);
+    free(simd);
+    free(scalar);
+
+    return errors;
+}
+
+static double run(int16_t* input, size_t frames, unsigned int in_rate, unsigned int out_rate,
+                  int quality, int scalar, int16_t* output, size_t* output_frames)
+{
+    struct audio_out_resampler resampler;
+    clock_t start;
+    size_t i, n, total = 0;
+
+    if (audio_out_resampler_init(&resampler, out_rate, quality, NULL, &null_backend) != 0) {
+        fprintf(stderr, "Could not create resampler\n");
+        exit(1);
+    }
+    resampler.scalar = scalar;
+    g_iaudio_out_backend_resampler.set_format(&resampler, in_rate, 16);
+
+    start = clock();
+    for (i = 0; i < frames; i += CHUNK_FRAMES) {
+        size_t count = (frames - i < CHUNK_FRAMES) ? frames - i : CHUNK_FRAMES;
+
+        n = audio_out_resampler_process(&resampler, input + 2 * i, count);
+        memcpy(output + 2 * total, resampler.out_samples, n * 4);
+        total += n;
+    }
+
+    *output_frames = total;
+    audio_out_resampler_release(&resampler);
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int in_rate = (argc > 1) ? (unsigned int)atoi(argv[1]) : 32000;
+    unsigned int out_rate = (argc > 2) ? (unsigned int)atoi(argv[2]) : 48000;
+    unsigned int seconds = (argc > 3) ? (unsigned int)atoi(argv[3]) : 60;
+    size_t frames, out_frames, i;
+    int16_t* input;
+    int16_t* simd_output;
+    int16_t* scalar_output;
+    int quality;
+    unsigned int conversion_errors;
+
+    if (in_rate == 0 || out_rate == 0 || seconds == 0) {
+        fprintf(stderr, "usage: %s [input rate] [output rate] [seconds of audio]\n", argv[0]);
+        return 1;
+    }
+
+    frames = (size_t)in_rate * seconds;
+    out_frames = (size_t)((double)frames * out_rate / in_rate) + 2 * CHUNK_FRAMES;
+    input = malloc(frames * 4);
+    simd_output = malloc(out_frames * 4);
+    scalar_output = malloc(out_frames * 4);
+    if (input == NULL || simd_output == NULL || scalar_output == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    /* logarithmic sweep from 20Hz to the input Nyquist frequency */
+    for (i = 0; i < frames; ++i) {
+        double t = (double)i / in_rate;
+        double f = 20.0 * pow(in_rate / 40.0, t / seconds);
+        input[2 * i + 0] = (int16_t)(16000.0 * sin(2.0 * M_PI * f * t));
+        input[2 * i + 1] = (int16_t)(16000.0 * cos(2.0 * M_PI * f * t));
+    }
+
+    printf("%u Hz -> %u Hz, %u s of audio, SIMD kernel: %s\n",
+           in_rate, out_rate, seconds, audio_out_resampler_kernel_name());
+
+    conversion_errors = check_conversion();
+    printf("float to int16 conversion: %s\n", (conversion_errors == 0) ? "SIMD matches scalar" : "MISMATCH");
+
+    for (quality = AUDIO_RESAMPLER_LINEAR; quality <= AUDIO_RESAMPLER_SINC_BEST; ++quality) {
+        size_t simd_frames, scalar_frames;
+        double simd_time = run(input, frames, in_rate, out_rate, quality, 0, simd_output, &simd_frames);
+        double scalar_time = run(input, frames, in_rate, out_rate, quality, 1, scalar_output, &scalar_frames);
+        int max_diff = 0;
+
+        for (i = 0; i < 2 * simd_frames && i < 2 * scalar_frames; ++i) {
+            int diff = abs(simd_output[i] - scalar_output[i]);
+            if (diff > max_diff)
+                max_diff = diff;
+        }
+
+        printf("%-8s  SIMD %8.1f Mframes/s (%6.0fx realtime)  scalar %8.1f Mframes/s (%6.0fx realtime)  max diff %d\n",
+               quality_names[quality],
+               frames / 1e6 / simd_time, seconds / simd_time,
+               frames / 1e6 / scalar_time, seconds / scalar_time,
+               max_diff);
+    }
+
+    free(input);
+    free(simd_output);
+    free(scalar_output);
+
+    return (conversion_errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - swap_bench.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/* Correctness check and throughput benchmark of the byte swap kernels.
+ * Every kernel available on the host is checked against a scalar reference
+ * for 2/4/8-byte elements, at every alignment and for many counts, in place
+ * and into another buffer, then timed swapping a large buffer in place.
+ *
+ * From the root of the source tree:
+ *   gcc -O3 -Isrc -Isubprojects/md5 -o swap_bench tools/swap_bench.c
+ *   ./swap_bench [buffer size in MB] [repetitions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* the kernels are static */
+#include "main/util.c"
+
+/* no vector part, everything is left to the scalar loop */
+static size_t swap_scalar(void *dst, const void *src, size_t size, size_t length)
+{
+    return 0;
+}
+
+struct bench_kernel
+{
+    const char *name;
+    swap_kernel kernel;
+};
+
+static size_t get_kernels(struct bench_kernel *kernels)
+{
+    size_t n = 0;
+
+    kernels[n].name = "scalar";
+    kernels[n++].kernel = swap_scalar;
+#if defined(SWAP_SSE2)
+    kernels[n].name = "sse2";
+    kernels[n++].kernel = swap_sse2;
+#endif
+#if defined(SWAP_X86_DISPATCH)
+    if (swap_has_ssse3()) {
+        kernels[n].name = "ssse3";
+        kernels[n++].kernel = swap_ssse3;
+    }
+    if (swap_has_avx2()) {
+        kernels[n].name = "avx2";
+        kernels[n++].kernel = swap_avx2;
+    }
+#endif
+#if defined(SWAP_NEON)
+    kernels[n].name = "neon";
+    kernels[n++].kernel = swap_neon;
+#endif
+
+    return n;
+}
+
+static void reference_swap(unsigned char *dst, const unsigned char *src, size_t length, size_t count)
+{
+    size_t i, j;
+
+    for (i = 0; i < count; ++i)
+        for (j = 0; j < length; ++j)
+            dst[i * length + j] = src[i * length + length - 1 - j];
+}
+
+/* Returns the number of mismatching cases */
+static unsigned int check(swap_kernel kernel)
+{
+    enum { MAX_COUNT = 300 };
+    unsigned char src[MAX_COUNT * 8 + 64], dst[MAX_COUNT * 8 + 64], ref[MAX_COUNT * 8 + 64];
+    unsigned int errors = 0;
+    size_t length, align, count, i;
+
+    for (i = 0; i < sizeof(src); ++i)
+        src[i] = (unsigned char)(i * 7 + 3);
+
+    l_swap_kernel = kernel;
+
+    for (length = 2; length <= 8; length *= 2) {
+        for (align = 0; align < 32; ++align) {
+            for (count = 0; count <= MAX_COUNT; ++count) {
+                size_t size = length * count;
+
+                reference_swap(ref, src + align, length, count);
+
+                /* into another buffer, which must be left untouched past the end */
+                memset(dst, 0xAA, sizeof(dst));
+                swap_copy_buffer(dst + align, src + align, length, count);
+                if (memcmp(dst + align, ref, size) != 0 || dst[align + size] != 0xAA)
+                    errors++;
+
+                /* in place */
+                memcpy(dst + align, src + align, size);
+                swap_buffer(dst + align, length, count);
+                if (memcmp(dst + align, ref, size) != 0)
+                    errors++;
+            }
+        }
+    }
+
+    return errors;
+}
+
+static double run(swap_kernel kernel, unsigned char *buffer, size_t size, size_t length, unsigned int repetitions)
+{
+    clock_t start;
+    unsigned int i;
+
+    l_swap_kernel = kernel;
+
+    start = clock();
+    for (i = 0; i < repetitions; ++i)
+        swap_buffer(buffer, length, size / length);
+
+    return (double)(clock() - start) / CLOCKS_PER_SEC / repetitions;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int megabytes = (argc > 1) ? (unsigned int)atoi(argv[1]) : 64;
+    unsigned int repetitions = (argc > 2) ? (unsigned int)atoi(argv[2]) : 20;
+    struct bench_kernel kernels[8];
+    size_t kernel_count, k, length, size, i;
+    unsigned char *buffer;
+    unsigned int errors = 0;
+
+    if (megabytes == 0 || repetitions == 0) {
+        fprintf(stderr, "usage: %s [buffer size in MB] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    size = (size_t)megabytes << 20;
+    buffer = malloc(size);
+    if (buffer == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (i = 0; i < size; ++i)
+        buffer[i] = (unsigned char)i;
+
+    kernel_count = get_kernels(kernels);
+
+    for (k = 0; k < kernel_count; ++k) {
+        unsigned int kernel_errors = check(kernels[k].kernel);
+
+        printf("%-6s %s%s", kernels[k].name, (kernel_errors == 0) ? "matches the reference" : "MISMATCH",
+               (kernels[k].kernel == swap_select_kernel()) ? " (selected)\n" : "\n");
+        errors += kernel_errors;
+    }
+
+    printf("\nin-place swap of %u MB, average of %u runs\n", megabytes, repetitions);
+    for (length = 2; length <= 8; length *= 2) {
+        printf("%2u-bit:", (unsigned int)(length * 8));
+        for (k = 0; k < kernel_count; ++k)
+            printf("  %s %6.2f ms", kernels[k].name, 1000.0 * run(kernels[k].kernel, buffer, size, length, repetitions));
+        printf("\n");
+    }
+
+    free(buffer);
+
+    return (errors == 0) ? 0 : 1;
+}